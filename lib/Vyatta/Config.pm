@@ -422,6 +422,50 @@ sub listNodeStatus {
   return %{$ref};
 }
 
+## listSubtreeStatus("level")
+# return a hash of status of the node at specified level and all nodes
+# below it. the path relative to the level (space-separated) is the hash
+# key ("" for the node itself). the hash value is a comma-separated list
+# of "added", "deleted", "changed", "effective", and "deactivated", or
+# "static" if none applies.
+sub listSubtreeStatus {
+  my ($self, $path, $include_deactivated) = @_;
+  die $DIE_DEACT_MSG if (defined($include_deactivated));
+  my $ref = $self->{_cstore}->cfgPathGetSubtreeStatus(
+                                          $self->get_path_comps($path));
+  return %{$ref};
+}
+
+## getSubtree("level")
+# return the whole working config subtree at specified level in a single
+# call. a leaf node is represented by its value (or an array ref of its
+# values if it is a multi-value node), and any other node by a hash ref
+# keyed by its child nodes (tag values for a tag node). return undef if the
+# level does not exist.
+sub getSubtree {
+  my ($self, $path) = @_;
+  return $self->{_cstore}->cfgPathGetSubtree($self->get_path_comps($path),
+                                             undef);
+}
+
+## getOrigSubtree("level")
+# same as getSubtree() but for the active config.
+sub getOrigSubtree {
+  my ($self, $path) = @_;
+  return $self->{_cstore}->cfgPathGetSubtree($self->get_path_comps($path),
+                                             1);
+}
+
+## getSubtreeWithStatus("level")
+# return a hash ref with the active ("active") and working ("working")
+# subtrees at specified level (see getSubtree()) and their status
+# ("status", same as listSubtreeStatus()) from a single call.
+sub getSubtreeWithStatus {
+  my ($self, $path) = @_;
+  return $self->{_cstore}->cfgPathGetSubtreeWithStatus(
+                                          $self->get_path_comps($path));
+}
+
 ## getTmplChildren("level")
 # return list of child nodes in the template hierarchy at specified level.
 sub getTmplChildren {
@@ -27,6 +27,7 @@
 #include <string>
 
 #include <cstore/cstore.hpp>
+#include <cnode/cnode.hpp>
 
 using namespace cstore;
 
@@ -34,6 +35,38 @@ typedef SV STRVEC;
 typedef SV CPATH;
 typedef SV STRSTRMAP;
 
+/* convert a subtree into nested perl data in one pass. a leaf node becomes
+ * its value (or an array ref of values for a multi-value node), and any
+ * other node becomes a hash ref keyed by the child node names (tag values
+ * for the children of a tag node).
+ */
+static SV *
+_subtree_to_sv(const cnode::CfgNode& node)
+{
+  if (node.isLeaf()) {
+    if (!node.isMulti()) {
+      const string& val = node.getValue();
+      return newSVpvn(val.data(), val.size());
+    }
+    const vector<string>& vals = node.getValues();
+    AV *av = newAV();
+    av_extend(av, vals.size());
+    for (size_t i = 0; i < vals.size(); i++) {
+      av_push(av, newSVpvn(vals[i].data(), vals[i].size()));
+    }
+    return newRV_noinc((SV *) av);
+  }
+  HV *hv = newHV();
+  const vector<cnode::CfgNode *>& cnodes = node.getChildNodes();
+  for (size_t i = 0; i < cnodes.size(); i++) {
+    const cnode::CfgNode& c = *(cnodes[i]);
+    const string& key = ((c.isValue() && !c.isLeaf())
+                         ? c.getValue() : c.getName());
+    hv_store(hv, key.data(), key.size(), _subtree_to_sv(c), 0);
+  }
+  return newRV_noinc((SV *) hv);
+}
+
 MODULE = Cstore		PACKAGE = Cstore		
 
 
@@ -218,6 +251,61 @@ OUTPUT:
   RETVAL
 
 
+STRSTRMAP *
+Cstore::cfgPathGetSubtreeStatus(CPATH *pref)
+PREINIT:
+  Cpath arg_cpath;
+CODE:
+  MapT<string, string> ret_strstrmap;
+  THIS->cfgPathGetSubtreeStatus(arg_cpath, ret_strstrmap);
+OUTPUT:
+  RETVAL
+
+
+SV *
+Cstore::cfgPathGetSubtree(CPATH *pref, bool active_cfg)
+PREINIT:
+  Cpath arg_cpath;
+CODE:
+  tr1::shared_ptr<const cnode::CfgNode> root
+    = THIS->cfgPathGetSubtree(arg_cpath, active_cfg);
+  if (!root.get()) {
+    XSRETURN_UNDEF;
+  }
+  RETVAL = _subtree_to_sv(*root);
+OUTPUT:
+  RETVAL
+
+
+SV *
+Cstore::cfgPathGetSubtreeWithStatus(CPATH *pref)
+PREINIT:
+  Cpath arg_cpath;
+CODE:
+  HV *href = newHV();
+  tr1::shared_ptr<const cnode::CfgNode> aroot, wroot;
+  vector<Cpath> paths;
+  vector<unsigned int> status;
+  THIS->cfgPathGetSubtreesWithStatus(arg_cpath, aroot, wroot, paths, status);
+  if (aroot.get()) {
+    hv_store(href, "active", 6, _subtree_to_sv(*aroot), 0);
+  }
+  if (wroot.get()) {
+    hv_store(href, "working", 7, _subtree_to_sv(*wroot), 0);
+  }
+  HV *shref = newHV();
+  for (size_t i = 0; i < paths.size(); i++) {
+    string key = paths[i].to_string();
+    string val = Cstore::pathStatusToString(status[i]);
+    hv_store(shref, key.data(), key.size(),
+             newSVpvn(val.data(), val.size()), 0);
+  }
+  hv_store(href, "status", 6, newRV_noinc((SV *) shref), 0);
+  RETVAL = newRV_noinc((SV *) href);
+OUTPUT:
+  RETVAL
+
+
 STRVEC *
 Cstore::cfgPathGetValuesDA(CPATH *pref, bool active_cfg)
 PREINIT:
@@ -26,7 +26,6 @@
 use strict;
 use lib "/opt/vyatta/share/perl5";
 use Vyatta::ConfigOutput;
-use File::Sync qw(fsync sync);
 use Vyatta::Misc qw(get_short_config_path);
 
 my $bootpath = '/config';
@@ -80,7 +79,6 @@ if ($mode eq 'local' and !($save_file =~ /^\//)) {
   $save_file = "$bootpath/$save_file";
 }
 
-my $version_str = `/opt/vyatta/sbin/vyatta_current_conf_ver.pl`;
 # when presenting to users, show shortened /config path
 my $shortened_save_file = get_short_config_path($save_file);
 if ($shortened_save_file eq '/config/config.boot') {
@@ -89,7 +87,6 @@ if ($shortened_save_file eq '/config/config.boot') {
     print "Warning: saving configuration to non-default location '$shortened_save_file'...\n";
 }
 
-my $tmpsave;
 if ($mode eq 'local') {
     # first check if this file exists, and if so ensure this is a config file.
     if (-e $save_file) {
@@ -103,33 +100,23 @@ if ($mode eq 'local') {
     die "Package [curl] not installed\n" unless ( -f '/usr/bin/curl');
 }
 
-open $tmpsave, '>', $tmp_file
-        or die "Cannot open file '$tmp_file': $!\n";
-
-select $tmpsave;
-my $show_cmd = 'cli-shell-api showConfig --show-active-only --show-ignore-edit';
+# the config is rendered, written, fsync()ed, and atomically renamed by
+# cli-shell-api in one go. a local save is skipped if nothing has changed
+# since the last save to the same file.
+my $save_cmd = 'cli-shell-api';
 if ($show_default) {
-  $show_cmd .= ' --show-show-defaults';
-}
-open(my $show_fd, '-|', $show_cmd) or die 'Cannot execute config output';
-while (<$show_fd>) {
-  print;
+  $save_cmd .= ' --show-show-defaults';
 }
-close($show_fd);
-print $version_str;
-select STDOUT;
-
-$tmpsave->flush;
-fsync $tmpsave;
-close $tmpsave;
-sync();
 
 my $rc;
 if ($mode eq 'local') {
-  $rc = system("mv $tmp_file $save_file");
+  $rc = system("$save_cmd --save-skip-unchanged saveConfig '$save_file'");
 }
 elsif ($mode eq 'url') {
-  $rc = system("curl -k -# -T $tmp_file $save_file");
+  $rc = system("$save_cmd saveConfig '$tmp_file'");
+  if (!$rc) {
+    $rc = system("curl -k -# -T $tmp_file $save_file");
+  }
   system("rm -f $tmp_file");
 }
 if ($rc) {
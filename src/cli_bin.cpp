@@ -19,6 +19,7 @@
 #include <cstring>
 #include <vector>
 #include <string>
+#include <cctype>
 #include <libgen.h>
 
 #include <cli_cstore.h>
@@ -99,113 +100,128 @@ static const bool op_use_edit_level[] = {
 #define OP_need_cfg_node_args op_need_cfg_node_args[op_idx]
 #define OP_use_edit_level op_use_edit_level[op_idx]
 
-static void
+/* the op functions return NULL on success or the failure message
+ * otherwise. in the single-command mode the failure message is passed to
+ * bye(), and in the batch mode it is reported for the line.
+ */
+static const char *
 doSet(Cstore& cstore, const Cpath& path_comps)
 {
   if (!cstore.validateSetPath(path_comps)) {
-    bye("invalid set path\n");
+    return "invalid set path";
   }
   if (!cstore.setCfgPath(path_comps)) {
-    bye("set cfg path failed\n");
+    return "set cfg path failed";
   }
+  return NULL;
 }
 
-static void
+static const char *
 doDelete(Cstore& cstore, const Cpath& path_comps)
 {
   if (!cstore.deleteCfgPath(path_comps)) {
-    bye("delete failed\n");
+    return "delete failed";
   }
+  return NULL;
 }
 
-static void
+static const char *
 doActivate(Cstore& cstore, const Cpath& path_comps)
 {
   if (!cstore.validateActivatePath(path_comps)) {
-    bye("%s validate failed", OP_str);
+    return "activate validate failed";
   }
   if (!cstore.unmarkCfgPathDeactivated(path_comps)) {
-    bye("%s failed", OP_str);
+    return "activate failed";
   }
+  return NULL;
 }
 
-static void
+static const char *
 doDeactivate(Cstore& cstore, const Cpath& path_comps)
 {
   if (!cstore.validateDeactivatePath(path_comps)) {
-    bye("%s validate failed", OP_str);
+    return "deactivate validate failed";
   }
   if (!cstore.markCfgPathDeactivated(path_comps)) {
-    bye("%s failed", OP_str);
+    return "deactivate failed";
   }
+  return NULL;
 }
 
-static void
+static const char *
 doRename(Cstore& cstore, const Cpath& path_comps)
 {
   if (!cstore.validateRenameArgs(path_comps)) {
-    bye("invalid rename args\n");
+    return "invalid rename args";
   }
   if (!cstore.renameCfgPath(path_comps)) {
-    bye("rename cfg path failed\n");
+    return "rename cfg path failed";
   }
+  return NULL;
 }
 
-static void
+static const char *
 doCopy(Cstore& cstore, const Cpath& path_comps)
 {
   if (!cstore.validateCopyArgs(path_comps)) {
-    bye("invalid copy args\n");
+    return "invalid copy args";
   }
   if (!cstore.copyCfgPath(path_comps)) {
-    bye("copy cfg path failed\n");
+    return "copy cfg path failed";
   }
+  return NULL;
 }
 
-static void
+static const char *
 doComment(Cstore& cstore, const Cpath& path_comps)
 {
   if (!cstore.commentCfgPath(path_comps)) {
-    bye("comment cfg path failed\n");
+    return "comment cfg path failed";
   }
+  return NULL;
 }
 
-static void
+static const char *
 doDiscard(Cstore& cstore, const Cpath& args)
 {
   if (args.size() > 0) {
     OUTPUT_USER("Invalid discard command\n");
-    bye("invalid discard command\n");
+    return "invalid discard command";
   }
   if (!cstore.discardChanges()) {
-    bye("discard failed\n");
+    return "discard failed";
   }
+  return NULL;
 }
 
-static void
+static const char *
 doMove(Cstore& cstore, const Cpath& path_comps)
 {
   if (!cstore.validateMoveArgs(path_comps)) {
-    bye("invalid move args\n");
+    return "invalid move args";
   }
   if (!cstore.moveCfgPath(path_comps)) {
-    bye("move cfg path failed\n");
+    return "move cfg path failed";
   }
+  return NULL;
 }
 
-static void
+static const char *
 doCommit(Cstore& cstore, const Cpath& path_comps)
 {
   Cpath dummy;
+  cstore.preloadTemplatesIfEnabled();
   cnode::CfgNode aroot(cstore, dummy, true, true);
   cnode::CfgNode wroot(cstore, aroot);
   if (!commit::doCommit(cstore, aroot, wroot)) {
     exit(1);
   }
+  return NULL;
 }
 
-typedef void (*OpFuncT)(Cstore& cstore,
-                        const Cpath& path_comps);
+typedef const char *(*OpFuncT)(Cstore& cstore,
+                               const Cpath& path_comps);
 OpFuncT OpFunc[] = {
   &doSet,
   &doDelete,
@@ -220,9 +236,149 @@ OpFuncT OpFunc[] = {
   NULL
 };
 
+/* split a batch line into words. words are separated by whitespace and
+ * can be quoted with single or double quotes, and a backslash escapes the
+ * next character outside single quotes, i.e., the same as the arguments
+ * of the individual commands in a shell.
+ * return false if the line has an unterminated quote.
+ */
+static bool
+split_batch_line(const string& line, vector<string>& words)
+{
+  words.clear();
+  size_t i = 0;
+  while (i < line.size()) {
+    while (i < line.size() && isspace((unsigned char) line[i])) {
+      ++i;
+    }
+    if (i == line.size() || line[i] == '#') {
+      break;
+    }
+    string w;
+    char quote = 0;
+    for (; i < line.size(); i++) {
+      char c = line[i];
+      if (quote == '\'') {
+        if (c == '\'') {
+          quote = 0;
+        } else {
+          w += c;
+        }
+      } else if (c == '\\' && i + 1 < line.size()) {
+        w += line[++i];
+      } else if (quote == '"') {
+        if (c == '"') {
+          quote = 0;
+        } else {
+          w += c;
+        }
+      } else if (c == '\'' || c == '"') {
+        quote = c;
+      } else if (isspace((unsigned char) c)) {
+        break;
+      } else {
+        w += c;
+      }
+    }
+    if (quote) {
+      return false;
+    }
+    words.push_back(w);
+  }
+  return true;
+}
+
+/* batch mode: run the commands in "file" ("-" for stdin), one per line,
+ * e.g.,
+ *   set interfaces ethernet eth0 address 10.0.0.1/24
+ *   delete service ssh
+ * in a single process with a single Cstore, so that the session setup and
+ * the templates are shared by all the commands. blank lines and lines
+ * starting with "#" are skipped. "commit" is not allowed in a batch.
+ * each failed command is reported with its line number. if stop_on_error
+ * is set, the batch stops at the first failure.
+ * return the number of failed commands.
+ */
+static unsigned int
+doBatch(const char *file, bool stop_on_error)
+{
+  FILE *fin = (strcmp(file, "-") == 0 ? stdin : fopen(file, "r"));
+  if (!fin) {
+    OUTPUT_USER("Cannot open batch file [%s]\n", file);
+    bye("failed to open %s\n", file);
+  }
+
+  Cstore *cstore = Cstore::createCstore(true);
+  unsigned int lnum = 0, nfail = 0;
+  char *lbuf = NULL;
+  size_t lsize = 0;
+  ssize_t len;
+  vector<string> words;
+  while ((len = getline(&lbuf, &lsize, fin)) >= 0) {
+    ++lnum;
+    const char *err = NULL;
+    op_idx = -1;
+    if (!split_batch_line(string(lbuf, len), words)) {
+      err = "unterminated quote";
+    } else if (words.empty()) {
+      continue;
+    } else {
+      for (int i = 0; op_str[i]; i++) {
+        if (words[0] == op_str[i]) {
+          op_idx = i;
+          break;
+        }
+      }
+      if (op_idx == -1 || OpFunc[op_idx] == &doCommit) {
+        err = "invalid command";
+      } else {
+        Cpath path_comps;
+        for (size_t i = 1; i < words.size(); i++) {
+          path_comps.push(words[i]);
+        }
+        if (OP_need_cfg_node_args && path_comps.size() == 0) {
+          OUTPUT_USER("Need to specify the config node to %s\n", OP_str);
+          err = "nothing to do";
+        } else {
+          err = OpFunc[op_idx](*cstore, path_comps);
+        }
+      }
+    }
+    if (err) {
+      ++nfail;
+      OUTPUT_USER("Line %u: %s failed: %s\n", lnum,
+                  (op_idx >= 0 ? OP_Str : "Command"), err);
+      if (stop_on_error) {
+        break;
+      }
+    }
+  }
+  free(lbuf);
+  if (fin != stdin) {
+    fclose(fin);
+  }
+  delete cstore;
+  return nfail;
+}
+
 int
 main(int argc, char **argv)
 {
+  if (argc > 1 && strcmp(argv[1], "--batch") == 0) {
+    // my_cli_bin --batch [--stop-on-error] <file|->
+    bool stop_on_error = (argc > 2
+                          && strcmp(argv[2], "--stop-on-error") == 0);
+    int fidx = (stop_on_error ? 3 : 2);
+    if (initialize_output("Batch") == -1) {
+      bye("can't initialize output\n");
+    }
+    if (argc != fidx + 1) {
+      fprintf(out_stream, "Need to specify the batch file\n");
+      bye("no batch file\n");
+    }
+    exit(doBatch(argv[fidx], stop_on_error) > 0 ? 1 : 0);
+  }
+
   int i = 0;
   while (op_bin_name[i]) {
     if (strcmp(basename(argv[0]), op_bin_name[i]) == 0) {
@@ -248,7 +404,10 @@ main(int argc, char **argv)
   Cpath path_comps(const_cast<const char **>(argv + 1), argc - 1);
 
   // call the op function
-  OpFunc[op_idx](*cstore, path_comps);
+  const char *err = OpFunc[op_idx](*cstore, path_comps);
+  if (err) {
+    bye("%s\n", err);
+  }
   delete cstore;
   exit(0);
 }
@@ -41,6 +41,9 @@ typedef enum {
   PRIORITY_TYPE
 } vtw_type_e;
 
+/* max number of parts in the binary form of a value (ipv6net) */
+#define CLI_VAL_MAX_PARTS 9
+
 typedef struct {
   vtw_type_e val_type;
   char      *val;
@@ -48,6 +51,10 @@ typedef struct {
   char     **vals; /* We might union with val */
   vtw_type_e *val_types; /* used with vals and multitypes */
   boolean    free_me;
+  /* binary form of val (single value only) for comparisons, valid if
+     bin_len > 0. see cli_val_parts(). */
+  int        bin_len;
+  unsigned int bin[CLI_VAL_MAX_PARTS];
 } valstruct;
 
 typedef enum {
@@ -104,6 +111,7 @@ typedef struct {
   char      *def_comp_help;
   char      *def_allowed;
   char      *def_val_help;
+  char      *def_depends;
   unsigned int def_tag;
   unsigned int def_multi;
   boolean    tag;
@@ -131,7 +139,10 @@ const valstruct *get_syntax_self_in_valstruct(const vtw_node *vnode);
 int get_shell_command_output(const char *cmd, char *buf,
                              unsigned int buf_size);
 int parse_def(vtw_def *defp, const char *path, boolean type_only);
+int parse_def_buf(vtw_def *defp, const char *path, const char *buf,
+                  size_t len, boolean type_only);
 boolean validate_value(const vtw_def *def, char *value);
+int validate_values(const vtw_def *def, char **values, int num);
 boolean execute_list(vtw_node *cur, const vtw_def *def, const char *outbuf);
 const char *type_to_name(vtw_type_e type);
 int initialize_output(const char *op);
@@ -67,9 +67,6 @@ static int cond_format_lens[DOMAIN_TYPE] =
      6  /* MACADDR_TYPE */
   };
 
-static int cli_val_len;
-static char *cli_val_ptr;
-
 static char *exe_string;
 static int exe_string_len;
 static int node_cnt;
@@ -78,10 +75,21 @@ static boolean in_validate_val;
 static valstruct validate_value_val;  /* value being validated 
 					 to be used as $(@) */
 
+/* batch being validated by validate_values() */
+typedef struct {
+  vtw_node *node;
+  boolean   ret;
+} batch_exec_t;
+static boolean in_validate_batch;
+static char *validate_batch_str;  /* all values, appended to $VAR(@@) */
+static batch_exec_t *validate_batch_execs;  /* exec results for the batch */
+static int validate_batch_nexecs;
+
 /* Local function declarations: */
 
 static void touch(void);
 static int check_comp(vtw_node *cur);
+static boolean check_disallowed_chars(const char *cp);
 static boolean check_syn(vtw_node *cur, const char *prepend_msg);
 static void copy_path(vtw_path *to, vtw_path *from);
 static int eval_va(valstruct *res, vtw_node *node);
@@ -101,14 +109,6 @@ static int set_reference_environment(const char* var_reference,
 				     clind_path_ref *n_cmd_path,
 				     int active);
 
-#define CACHE_SIZE 32
-typedef struct {
-  char *key;
-  char *item;
-  int  from_active;
-} varref_cache_item_t;
-static varref_cache_item_t varref_cache[CACHE_SIZE];
-
 /*************************************************
      GLOBAL FUNCTIONS
 ***************************************************/
@@ -178,61 +178,6 @@ touch_dir(const char *dp)
   }
 }
 
-/**********************************************************
- cache helpers:
-   stores values for var ref variables
-   is used fin case def file contains multiple references to
-   the same variable
-***********************************************************/
-static void clean_varref_cache()
-{
-  int i;
-  /* clean cache */
-  for (i = 0; i < CACHE_SIZE && varref_cache[i].key; i ++) {
-    free(varref_cache[i].key);
-    varref_cache[i].key = 0;
-    free(varref_cache[i].item);
-    varref_cache[i].item = 0;
-    varref_cache[i].from_active = 0;
-  }
-}
-
-static void push_varref_cache(const char* key, const int from_active,
-                              const char* value)
-{
-  int i;
-
-  if (!key || !value) {
-    return;
-  }
-
-  for (i = 0; i < CACHE_SIZE; i ++) {
-    if (!varref_cache[i].key) {
-      varref_cache[i].key = strdup(key);
-      varref_cache[i].from_active = from_active;
-      varref_cache[i].item = strdup(value);
-      break;
-    }
-  }
-}
-
-static char* get_varref_cache(const char* key, const int from_active)
-{
-  int i;
-
-  if (!key) {
-    return NULL;
-  }
-
-  for (i = 0; i < CACHE_SIZE && varref_cache[i].key; i ++) {
-    if (varref_cache[i].from_active == from_active &&
-        !strcmp(varref_cache[i].key, key)) {
-      return strdup(varref_cache[i].item);
-    }
-  }
-  return NULL;
-}
-
 /*****************************************************
   add_val:
     verify that the types are the same;
@@ -255,6 +200,7 @@ void add_val(valstruct *first, valstruct *second)
       first->val_types[0] = first->val_type;
       first->cnt = 1;
       first->val = NULL;
+      first->bin_len = 0;
     }
   }
   second->free_me = FALSE; /* we took its string */
@@ -617,16 +563,29 @@ int char2val(const vtw_def *def, char *value, valstruct *valp)
   }
 }
 
+/* skip whitespace in a value string. backslash-newline is whitespace too */
+static const char *
+skip_val_space(const char *p)
+{
+  for (;;) {
+    if (*p == ' ' || *p == '\t')
+      ++p;
+    else if (p[0] == '\\' && p[1] == '\n')
+      p += 2;
+    else
+      return p;
+  }
+}
+
 //non-text type processing block
 
 int char2val_notext(const vtw_def *def, int my_type, int my_type2,
                     char *value, valstruct **valpp, char *err_buf)
 {
   valstruct *valp = *valpp;
-  int token;
+  valstruct cur;
   boolean first = TRUE;
-  cli_val_len = strlen(value);
-  cli_val_ptr = value;
+  const char *p = value;
 
   char type_buf[256];
   if (my_type2 != ERROR_TYPE) {
@@ -637,10 +596,30 @@ int char2val_notext(const vtw_def *def, int my_type, int my_type2,
   }
 
   while(1) {
-    token = yy_cli_val_lex();
+    const char *tok;
+    vtw_type_e type = ERROR_TYPE;
+    boolean garbage;
+
+    /* one value per line */
+    tok = p = skip_val_space(p);
+    while (*p && *p != ' ' && *p != '\t' && *p != '\n'
+           && !(p[0] == '\\' && p[1] == '\n'))
+      ++p;
+    memset(&cur, 0, sizeof(cur));
+    garbage = FALSE;
+    if (p > tok) {
+      type = cli_val_scan(tok, p - tok, cur.bin, &cur.bin_len);
+      if (type == ERROR_TYPE) {
+        /* a value followed by garbage is badly formed (checked after
+           the type as before), not the wrong type */
+        if (cli_val_scan_prefix(tok, p - tok, &type, cur.bin,
+                                &cur.bin_len) > 0 && type != ERROR_TYPE)
+          garbage = TRUE;
+      }
+    }
 
-    if (token != VALUE) {
-      if (first || token){
+    if (type == ERROR_TYPE) {
+      if (first || p > tok || *p){
 	
 	if (def->def_type_help){
 	  set_at_string(value);
@@ -650,8 +629,6 @@ int char2val_notext(const vtw_def *def, int my_type, int my_type2,
 	  printf("Wrong type of value in %s, need %s\n",
                  m_path.path_buf + m_path.print_offset, type_buf);
 
-	  token = yy_cli_val_lex();
-
 	  sprintf(err_buf, "\"%s\" is not a valid value of type \"%s\"\n",
 		  value, type_buf);
 	}
@@ -660,8 +637,8 @@ int char2val_notext(const vtw_def *def, int my_type, int my_type2,
       }
       return 0;
     }
-    if (my_type != get_cli_value_ptr()->val_type &&
-	(my_type2 != ERROR_TYPE && my_type2 != get_cli_value_ptr()->val_type)) {
+    if (my_type != type &&
+	(my_type2 != ERROR_TYPE && my_type2 != type)) {
       if (def->def_type_help){
 	set_at_string(value);
 	(void)expand_string(def->def_type_help);
@@ -670,44 +647,45 @@ int char2val_notext(const vtw_def *def, int my_type, int my_type2,
 	printf("Wrong type of value in %s, need %s\n",
                m_path.path_buf + m_path.print_offset, type_buf);
 
-	token = yy_cli_val_lex();
-
 	sprintf(err_buf, "\"%s\" is not a valid value of type \"%s\"\n",
 		value, type_buf);
       }
-      my_free(get_cli_value_ptr()->val);
       if (first) {
 	return -1;
       }
       return 0;
     }
+    if (garbage) {
+      sprintf(err_buf, "\"%s\" is not a valid value\n", value);
+      printf("Badly formed value in %s\n", m_path.path + m_path.print_offset);
+      return -1;
+    }
+    cur.free_me = TRUE;
+    cur.val_type = type;
+    cur.val = my_malloc(p - tok + 1, "char2val_notext");
+    memcpy(cur.val, tok, p - tok);
+    cur.val[p - tok] = 0;
     if (first) {
-      *valp = *get_cli_value_ptr();
-      get_cli_value_ptr()->free_me = FALSE;
+      *valp = cur;
       first = FALSE;
     } else {
       if (def->multi)
-	add_val(valp, get_cli_value_ptr());
+	add_val(valp, &cur);
       else {
 	printf("Unexpected multivalue in %s\n", m_path.path);
-	free_val(get_cli_value_ptr());
+	free_val(&cur);
       }
     }
-    token = yy_cli_val_lex();
-    if (!token) {
+    p = skip_val_space(p);
+    if (!*p) {
       return 0;
     }
-    if (token != EOL) {
-
-      token = yy_cli_val_lex();
-
+    if (*p != '\n') {
       sprintf(err_buf, "\"%s\" is not a valid value\n", value);
       printf("Badly formed value in %s\n", m_path.path + m_path.print_offset);
-      if (token == VALUE) {
-	my_free(get_cli_value_ptr()->val);
-      }
       return -1;
     }
+    ++p;
   }
   return 0;
 }
@@ -768,6 +746,35 @@ int char2val_text(const vtw_def *def, char *value, valstruct **valpp)
 }
 
 
+/****************************************************
+  val_parts:
+    get the binary form of a value as the specified
+    type. use the form stored in the valstruct if
+    there is one, otherwise parse the string. values
+    that are not well-formed are handled the same
+    way as before (sscanf/scan_ipv6) so that the
+    results of the comparison do not change.
+****************************************************/
+static void
+val_parts(const valstruct *v, const char *str, vtw_type_e type,
+          unsigned int *parts)
+{
+  if (!v->cnt && v->bin_len > 0 && v->val_type == type) {
+    memcpy(parts, v->bin, v->bin_len * sizeof(parts[0]));
+    return;
+  }
+  if (cli_val_parts(type, str, strlen(str), parts) > 0) {
+    return;
+  }
+  memset(parts, 0, CLI_VAL_MAX_PARTS * sizeof(parts[0]));
+  if (type == IPV6_TYPE || type == IPV6NET_TYPE) {
+    scan_ipv6((char *) str, parts);
+  } else {
+    (void) sscanf(str, cond_formats[type], parts, parts+1, parts+2,
+                  parts+3, parts+4, parts+5);
+  }
+}
+
 /****************************************************
   val_comp:
     compare two values per cond
@@ -776,10 +783,9 @@ int char2val_text(const vtw_def *def, char *value, valstruct **valpp)
 static boolean
 val_cmp(const valstruct *left, const valstruct *right, vtw_cond_e cond)
 {
-  unsigned int left_parts[9], right_parts[9];
-  vtw_type_e val_type;
+  unsigned int left_parts[CLI_VAL_MAX_PARTS], right_parts[CLI_VAL_MAX_PARTS];
+  vtw_type_e val_type, rtype;
   int parts_num, lstop, rstop, lcur, rcur;
-  char const *format;
   char *lval, *rval;
   int ret=0, step=0, res=0;
 
@@ -821,27 +827,22 @@ val_cmp(const valstruct *left, const valstruct *right, vtw_cond_e cond)
       case IPV6NET_TYPE:
 	parts_num = 9;
       ipv6_common:
-	scan_ipv6(lval,left_parts);
-	scan_ipv6(rval,right_parts);
+	val_parts(left, lval, val_type, left_parts);
+	val_parts(right, rval, val_type, right_parts);
 	break;
       case IPV4_TYPE:
       case IPV4NET_TYPE:
       case MACADDR_TYPE:
       case INT_TYPE:
-	format = cond_formats[val_type];
 	parts_num = cond_format_lens[val_type];
-	(void) sscanf(lval, format, left_parts, left_parts+1, 
-		      left_parts+2, left_parts+3, left_parts+4,
-		      left_parts+5); 
-
+	val_parts(left, lval, val_type, left_parts);
+	rtype = val_type;
 	if ((rcur || right->cnt) 
 	    && right->val_types != NULL
 	    && right->val_types[rcur] != ERROR_TYPE) {
-	  format = cond_formats[right->val_types[rcur]];
+	  rtype = right->val_types[rcur];
 	}
-	(void) sscanf(rval, format, right_parts, right_parts+1, 
-		      right_parts+2, right_parts+3, right_parts+4,
-		      right_parts+5); 
+	val_parts(right, rval, rtype, right_parts);
 	break;
       case TEXT_TYPE:
       case BOOL_TYPE:
@@ -984,7 +985,6 @@ static int change_var_value(const char* var_reference,const char* value, int act
       /* handle is set => we are in cstore operation.  */
       if (cstore_set_var_ref(var_ref_handle, var_reference, value,
                              active_dir)) {
-        clean_varref_cache();
         ret = 0;
       }
     } else {
@@ -1029,6 +1029,221 @@ static int change_var_value(const char* var_reference,const char* value, int act
 
 static int system_out(char *command, const char *prepend_msg);
 
+/****************************************************
+ pattern cache:
+   compiled "pattern" expressions, keyed by the
+   pattern string, live for the whole process.
+   anchored single character-class patterns such as
+   "^[0-9]+$" or "^[-_a-zA-Z0-9.]{1,32}$" are matched
+   against a byte set instead of going through regexec.
+   note: ranges are taken as byte ranges, which is what
+   regcomp does in the C locale.
+****************************************************/
+#define PATTERN_CACHE_BUCKETS 256
+typedef struct pattern_cache_s {
+  struct pattern_cache_s *next;
+  char *pattern;
+  boolean simple;
+  unsigned char cset[32];  /* simple: bytes allowed */
+  unsigned int min, max;   /* simple: repeat bounds, max 0 = unbounded */
+  regex_t reg;             /* !simple: compiled regex */
+} pattern_cache_t;
+static pattern_cache_t *pattern_cache[PATTERN_CACHE_BUCKETS];
+
+static void
+cset_add(unsigned char *cset, int c)
+{
+  cset[c >> 3] |= (1 << (c & 7));
+}
+
+static boolean
+cset_add_class(unsigned char *cset, const char *name, size_t len)
+{
+  static const struct {
+    const char *name;
+    int (*fn)(int);
+  } classes[] = {
+    { "alnum", isalnum }, { "alpha", isalpha }, { "digit", isdigit },
+    { "lower", islower }, { "upper", isupper }, { "space", isspace },
+    { "xdigit", isxdigit }, { "punct", ispunct }, { "print", isprint },
+    { "graph", isgraph }, { "blank", isblank }, { "cntrl", iscntrl },
+    { NULL, NULL }
+  };
+  int i, c;
+
+  for (i = 0; classes[i].name; i++) {
+    if (strlen(classes[i].name) == len
+        && strncmp(classes[i].name, name, len) == 0) {
+      for (c = 1; c < 128; c++) {
+        if (classes[i].fn(c))
+          cset_add(cset, c);
+      }
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+/* parse "^[class]Q$" where Q is one of + * ? {n} {n,} {n,m}.
+ * returns FALSE for anything else.
+ */
+static boolean
+parse_simple_pattern(const char *p, pattern_cache_t *pc)
+{
+  boolean negate = FALSE;
+  int i;
+
+  memset(pc->cset, 0, sizeof(pc->cset));
+  if (*p++ != '^' || *p++ != '[')
+    return FALSE;
+  if (*p == '^') {
+    negate = TRUE;
+    p++;
+  }
+  if (*p == ']') {
+    /* leading ']' is a literal */
+    cset_add(pc->cset, ']');
+    p++;
+  }
+  while (*p != ']') {
+    unsigned char c = (unsigned char) *p;
+    if (!c)
+      return FALSE;
+    if (c == '[') {
+      const char *e;
+      if (p[1] != ':') {
+        /* collating elements, equivalence classes and ranges starting
+           at '[' are left to regcomp */
+        if (p[1] == '.' || p[1] == '=' || p[1] == '-')
+          return FALSE;
+        cset_add(pc->cset, c);
+        p++;
+        continue;
+      }
+      e = strstr(p + 2, ":]");
+      if (!e || !cset_add_class(pc->cset, p + 2, e - (p + 2)))
+        return FALSE;
+      p = e + 2;
+      continue;
+    }
+    if (p[1] == '-' && p[2] && p[2] != ']') {
+      unsigned char hi = (unsigned char) p[2];
+      int r;
+      if (hi < c || hi == '[')
+        return FALSE;
+      for (r = c; r <= hi; r++)
+        cset_add(pc->cset, r);
+      p += 3;
+      continue;
+    }
+    cset_add(pc->cset, c);
+    p++;
+  }
+  p++;
+  if (negate) {
+    for (i = 0; i < 32; i++)
+      pc->cset[i] = ~pc->cset[i];
+    /* NUL never shows up in a value */
+    pc->cset[0] &= ~1;
+  }
+
+  switch (*p) {
+  case '+':
+    pc->min = 1;
+    pc->max = 0;
+    p++;
+    break;
+  case '*':
+    pc->min = 0;
+    pc->max = 0;
+    p++;
+    break;
+  case '?':
+    pc->min = 0;
+    pc->max = 1;
+    p++;
+    break;
+  case '{':
+    {
+      char *e;
+      unsigned long n = strtoul(p + 1, &e, 10);
+      if (e == p + 1 || n > INT_MAX)
+        return FALSE;
+      pc->min = n;
+      pc->max = n;
+      if (*e == ',') {
+        const char *s = e + 1;
+        n = strtoul(s, &e, 10);
+        if (e == s) {
+          pc->max = 0;
+        } else if (n < pc->min || n > INT_MAX || n == 0) {
+          return FALSE;
+        } else {
+          pc->max = n;
+        }
+      }
+      if (*e != '}' || (pc->min == 0 && pc->max == 0 && *(e - 1) != ','))
+        return FALSE;
+      p = e + 1;
+    }
+    break;
+  default:
+    /* exactly one character */
+    pc->min = 1;
+    pc->max = 1;
+    break;
+  }
+  return (p[0] == '$' && p[1] == 0);
+}
+
+static pattern_cache_t *
+get_pattern(const char *pattern)
+{
+  unsigned int h = 5381;
+  const char *c;
+  pattern_cache_t *pc;
+  int status;
+
+  for (c = pattern; *c; c++)
+    h = h * 33 + (unsigned char) *c;
+  h %= PATTERN_CACHE_BUCKETS;
+  for (pc = pattern_cache[h]; pc; pc = pc->next) {
+    if (strcmp(pc->pattern, pattern) == 0)
+      return pc;
+  }
+
+  pc = my_malloc(sizeof(*pc), "get_pattern");
+  memset(pc, 0, sizeof(*pc));
+  pc->simple = parse_simple_pattern(pattern, pc);
+  if (!pc->simple) {
+    status = regcomp(&pc->reg, pattern, REG_EXTENDED);
+    if (status)
+      bye("Can not compile regex |%s|, result %d\n", pattern, status);
+  }
+  pc->pattern = my_strdup(pattern, "get_pattern");
+  pc->next = pattern_cache[h];
+  pattern_cache[h] = pc;
+  return pc;
+}
+
+/* returns 0 on match like regexec() */
+static int
+match_pattern(const pattern_cache_t *pc, const char *val)
+{
+  const unsigned char *v;
+  unsigned int n = 0;
+
+  if (!pc->simple)
+    return regexec(&pc->reg, val, 0, 0, 0);
+  for (v = (const unsigned char *) val; *v; v++, n++) {
+    if (!(pc->cset[*v >> 3] & (1 << (*v & 7))))
+      return REG_NOMATCH;
+    if (pc->max && n >= pc->max)
+      return REG_NOMATCH;
+  }
+  return (n >= pc->min ? 0 : REG_NOMATCH);
+}
+
 /****************************************************
  check_syn:
    evaluate syntax tree;
@@ -1107,6 +1322,30 @@ check_syn(vtw_node *cur, const char *prepend_msg)
     return TRUE;
 
   case EXEC_OP:
+    if (in_validate_val && in_validate_batch
+        && !strstr(cur->vtw_node_left->vtw_node_string, "$VAR(@)")) {
+      /* doesn't depend on the value itself. run it once per batch */
+      for (ii = 0; ii < validate_batch_nexecs; ii++) {
+        if (validate_batch_execs[ii].node == cur) {
+          return validate_batch_execs[ii].ret;
+        }
+      }
+      status = expand_string(cur->vtw_node_left->vtw_node_string);
+      if (status != VTWERR_OK) {
+        return FALSE;
+      }
+      ret = !system_out(exe_string, prepend_msg);
+      if (validate_batch_nexecs % MULTI_ALLOC == 0) {
+        validate_batch_execs
+          = my_realloc(validate_batch_execs,
+                       (validate_batch_nexecs + MULTI_ALLOC)
+                       * sizeof(batch_exec_t), "check_syn batch");
+      }
+      validate_batch_execs[validate_batch_nexecs].node = cur;
+      validate_batch_execs[validate_batch_nexecs].ret = ret;
+      ++validate_batch_nexecs;
+      return ret;
+    }
     /* for every value */
     if (in_validate_val) {
       char *save_at = get_at_string();
@@ -1139,7 +1378,7 @@ check_syn(vtw_node *cur, const char *prepend_msg)
   case PATTERN_OP:  /* left to var, right to pattern */
     {
       valstruct left;
-      regex_t myreg;
+      pattern_cache_t *pc;
       boolean ret;
       int ii;
 
@@ -1149,17 +1388,11 @@ check_syn(vtw_node *cur, const char *prepend_msg)
 	ret = FALSE;
 	goto free_and_return;
       }
-      status = regcomp(&myreg, cur->vtw_node_right->vtw_node_string,
-                       REG_EXTENDED);
-      if (status)
-	bye("Can not compile regex |%s|, result %d\n", 
-	    cur->vtw_node_right->vtw_node_string, status);
-	/* for every value */
-	for(ii = 0; ii < left.cnt || ii == 0; ++ii) {
-	status = regexec(&myreg, left.cnt?
-			 left.vals[ii]:left.val,
-			 0, 0, 0);
-	regfree(&myreg);
+      pc = get_pattern(cur->vtw_node_right->vtw_node_string);
+      /* for every value */
+      for(ii = 0; ii < left.cnt || ii == 0; ++ii) {
+	status = match_pattern(pc, left.cnt?
+			       left.vals[ii]:left.val);
 	if(status) {
 	  ret = FALSE;
 	  break;
@@ -1379,8 +1612,6 @@ static int expand_string(char *stringp)
   int my_len;
   int len;
 
-  clean_varref_cache();
-
   scanp = stringp; /* save stringp for printf */
 
   do{
@@ -1439,14 +1670,22 @@ static int expand_string(char *stringp)
 
         if (var_ref_handle) {
           /* handle is set => we are in cstore operation. */
+          /* the cstore caches resolved refs during commit */
           vtw_type_e vtype;
-          char *vptr = get_varref_cache(scanp, is_in_delete_action());
-          if (vptr) {
-            cp = vptr;
-          } else if (cstore_get_var_ref(var_ref_handle, scanp, &vtype, &vptr,
-                                        is_in_delete_action()) && vptr) {
+          char *vptr = NULL;
+          if (cstore_get_var_ref(var_ref_handle, scanp, &vtype, &vptr,
+                                 is_in_delete_action()) && vptr) {
             cp = vptr;
-            push_varref_cache(scanp, is_in_delete_action(), cp);
+          }
+          if (in_validate_batch && strcmp(scanp, "@@") == 0) {
+            /* all values of the node also include the batch */
+            char *all = my_malloc((cp ? strlen(cp) + 1 : 0)
+                                  + strlen(validate_batch_str) + 1,
+                                  "expand_string batch");
+            sprintf(all, "%s%s%s", (cp ? cp : ""), ((cp && *cp) ? " " : ""),
+                    validate_batch_str);
+            free(cp);
+            cp = all;
           }
         } else {
           /* legacy usage */
@@ -1908,6 +2147,31 @@ void switch_path(first_seg *segp)
   m_path.path = m_path.path_buf + segp->f_segoff;
 }
 
+/*************************************************
+  check_disallowed_chars:
+    check that value doesn't contain any of the
+    characters that are not allowed in a value
+   return TRUE if OK, FALSE otherwise
+**************************************************/
+static boolean check_disallowed_chars(const char *cp)
+{
+  static const char *disallowed[256] = {
+    ['\''] = "single quote (')",
+    ['\n'] = "newline",
+    ['"'] = "double quote (\")",
+  };
+  const unsigned char *p;
+
+  for (p = (const unsigned char *) cp; *p; ++p) {
+    if (disallowed[*p]) {
+      OUTPUT_USER("Cannot use the %s character in a value string\n",
+                  disallowed[*p]);
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
 /*************************************************
   validate_value:
     validates value against type and syntax 
@@ -1919,24 +2183,8 @@ boolean validate_value(const vtw_def *def, char *cp)
   boolean    ret=TRUE;
 
   /* certain characters are not allowed */
-  {
-    int i = 0;
-    static const char *disallowed[] = {
-      "'", "single quote (')",
-      "\n", "newline",
-      "\"", "double quote (\")",
-      NULL, NULL
-    };
-    for (i = 0; i < strlen(cp); i++) {
-      int j = 0;
-      for (j = 0; disallowed[j]; j += 2) {
-        if (cp[i] == disallowed[j][0]) {
-          OUTPUT_USER("Cannot use the %s character in a value string\n",
-                      disallowed[j + 1]);
-          return FALSE;
-        }
-      }
-    }
+  if (!check_disallowed_chars(cp)) {
+    return FALSE;
   }
 
   /* prepare cur_value */
@@ -1970,20 +2218,48 @@ boolean validate_value(const vtw_def *def, char *cp)
   return ret;
 }
 
-int cli_val_read(char *buf, int max_size)
+/*************************************************
+  validate_values:
+    validates a batch of values for the same node,
+    in order, stopping at the first invalid one.
+    same as validate_value() on each value, except
+    that "exec" syntax checks that don't use $VAR(@)
+    are run only once for the whole batch, with all
+    the values of the batch included in $VAR(@@).
+    helpers that can check many values at once
+    should therefore take $VAR(@@).
+   return number of valid values before the first
+   invalid one, i.e., num if all are valid
+**************************************************/
+int validate_values(const vtw_def *def, char **values, int num)
 {
-  int len;
-  
-  if (cli_val_len > max_size)
-    len = max_size;
-  else
-    len = cli_val_len;
-  if (len) {
-    (void)memcpy(buf, cli_val_ptr, len);
-    cli_val_len -= len;
-    cli_val_ptr += len;
+  int i, len = 0;
+
+  for (i = 0; i < num; i++) {
+    len += strlen(values[i]) + 1;
+  }
+  validate_batch_str = my_malloc(len + 1, "validate_values");
+  validate_batch_str[0] = 0;
+  for (i = 0, len = 0; i < num; i++) {
+    len += sprintf(validate_batch_str + len, "%s%s", (i ? " " : ""),
+                   values[i]);
   }
-  return len;
+  validate_batch_nexecs = 0;
+  in_validate_batch = TRUE;
+
+  for (i = 0; i < num; i++) {
+    if (!validate_value(def, values[i])) {
+      break;
+    }
+  }
+
+  in_validate_batch = FALSE;
+  my_free(validate_batch_str);
+  validate_batch_str = NULL;
+  my_free(validate_batch_execs);
+  validate_batch_execs = NULL;
+  validate_batch_nexecs = 0;
+  return i;
 }
 
 static void
@@ -37,6 +37,7 @@ static  void cli_deferror(const char *);
 %token CHELP
 %token ALLOWED
 %token VHELP
+%token DEPENDS
 %token PATTERN
 %token EXEC
 %token SYNTAX
@@ -156,6 +157,7 @@ cause:		help_cause
                 | chelp_stmt
                 | allowed_stmt
                 | vhelp_stmt
+                | depends_stmt
 		| syntax_cause
                 | ACTION action { append(parse_defp->actions + $1, $2, 0);}
                 | dummy_stmt
@@ -212,6 +214,11 @@ allowed_stmt: ALLOWED STRING
                 parse_defp->def_allowed = $2;
               }
 
+depends_stmt: DEPENDS STRING
+              {
+                parse_defp->def_depends = $2;
+              }
+
 vhelp_stmt: VHELP STRING
             {
               if (!(parse_defp->def_val_help)) {
@@ -307,6 +314,29 @@ int parse_def(vtw_def *defp, const char *path, boolean type_only)
    fclose(yy_cli_def_in);
    return status;
 }
+
+/* same as parse_def() but parse the template from the len bytes at buf
+   (the contents of the file at path, which is only used for messages) */
+int parse_def_buf(vtw_def *defp, const char *path, const char *buf,
+                  size_t len, boolean type_only)
+{
+   int status;
+   if (len == 0)
+     /* fmemopen() does not take an empty buffer */
+     return parse_def(defp, path, type_only);
+   memset(defp, 0, sizeof(vtw_def));
+   yy_cli_def_lineno = 1;
+   parse_status = 0;
+   parse_defp = defp;
+   cli_def_type_only = type_only;
+   yy_cli_def_in = fmemopen((void *) buf, len, "r");
+   if (!yy_cli_def_in)
+     return -5;
+   parse_path = path;
+   status = yy_cli_parse_parse(); /* 0 is OK */
+   fclose(yy_cli_def_in);
+   return status;
+}
 static void
 cli_deferror(const char *s)
 {
@@ -65,6 +65,9 @@ int op_show_commands = 0;
 int op_show_ignore_edit = 0;
 char *op_show_cfg1 = NULL;
 char *op_show_cfg2 = NULL;
+char *op_show_format = NULL;
+// saveConfig options
+int op_save_skip_unchanged = 0;
 
 typedef void (*OpFuncT)(Cstore& cstore, const Cpath& args);
 
@@ -244,6 +247,32 @@ modified(Cstore& cstore, const Cpath& args)
   exit(0);
 }
 
+/* outputs the status of the specified node and every node below it, one
+ * node per line: the comma-separated status list ("added", "deleted",
+ * "changed", "effective", "deactivated", or "static") followed by the
+ * path relative to the specified one, e.g.,
+ *
+ *   changed,effective 'ethernet' 'eth0'
+ *   added,changed 'ethernet' 'eth0' 'description'
+ *
+ * this replaces separate exists/changed/existsEffective calls for each
+ * node of a subtree.
+ */
+static void
+listSubtreeStatus(Cstore& cstore, const Cpath& args)
+{
+  vector<Cpath> paths;
+  vector<unsigned int> status;
+  cstore.cfgPathGetSubtreeStatus(args, paths, status);
+  for (size_t i = 0; i < paths.size(); i++) {
+    printf("%s", Cstore::pathStatusToString(status[i]).c_str());
+    for (size_t j = 0; j < paths[i].size(); j++) {
+      printf(" '%s'", paths[i][j]);
+    }
+    printf("\n");
+  }
+}
+
 /* isMulti */
 static void
 isMulti(Cstore& cstore, const Cpath& args)
@@ -527,6 +556,9 @@ showCfg(Cstore& cstore, const Cpath& args)
  *       show output in "commands"
  *   --show-ignore-edit
  *       don't use the edit level in environment
+ *   --show-format <format>
+ *       output format: "text" (default) or "json". json output shows
+ *       the second config only (no diff).
  *
  * note that when neither cfg1 nor cfg2 specifies a config file, the "args"
  * argument specifies the root path for the show output, and the "edit level"
@@ -552,9 +584,20 @@ showConfig(Cstore& cstore, const Cpath& args)
     // default
   }
 
+  bool show_json = false;
+  if (op_show_format) {
+    if (strcmp(op_show_format, "json") == 0) {
+      show_json = true;
+    } else if (strcmp(op_show_format, "text") != 0) {
+      fprintf(stderr, "Invalid output format [%s]\n", op_show_format);
+      exit(1);
+    }
+  }
+
   cnode::showConfig(cfg1, cfg2, args, op_show_show_defaults,
                     op_show_hide_secrets, op_show_context_diff,
-                    op_show_commands, op_show_ignore_edit);
+                    op_show_commands, op_show_ignore_edit, stdout,
+                    show_json);
 }
 
 static void
@@ -566,6 +609,20 @@ loadFile(Cstore& cstore, const Cpath& args)
   }
 }
 
+/* save the active config to the specified file. the config is written
+ * with the defaults only if "--show-show-defaults" is given.
+ * "--save-skip-unchanged" skips the write if nothing has changed since the
+ * last save to the file.
+ */
+static void
+saveConfig(Cstore& cstore, const Cpath& args)
+{
+  if (!cstore.saveConfig(args[0], op_show_show_defaults,
+                         op_save_skip_unchanged)) {
+    exit(1);
+  }
+}
+
 static cnode::CfgNode *
 _cf_process_args(Cstore& cstore, const Cpath& args, Cpath& path)
 {
@@ -675,6 +732,7 @@ static OpT ops[] = {
   OP(listNodes, -1, NULL, -1, NULL, false),
   OP(listActiveNodes, -1, NULL, -1, NULL, false),
   OP(listEffectiveNodes, -1, NULL, 1, "Must specify config path", false),
+  OP(listSubtreeStatus, -1, NULL, -1, NULL, false),
 
   OP(isMulti, -1, NULL, 1, "Must specify config path", false),
   OP(isTag,  -1, NULL, 1, "Must specify config path", false),
@@ -696,6 +754,7 @@ static OpT ops[] = {
   OP(showCfg, -1, NULL, -1, NULL, true),
   OP(showConfig, -1, NULL, -1, NULL, true),
   OP(loadFile, 1, "Must specify config file", -1, NULL, false),
+  OP(saveConfig, 1, "Must specify config file", -1, NULL, false),
 
   OP(getPreCommitHookDir, 0, "No argument expected", -1, NULL, false),
   OP(getPostCommitHookDir, 0, "No argument expected", -1, NULL, false),
@@ -715,7 +774,8 @@ static OpT ops[] = {
 
 enum {
   SHOW_CFG1 = 1,
-  SHOW_CFG2
+  SHOW_CFG2,
+  SHOW_FORMAT
 };
 
 struct option options[] = {
@@ -728,6 +788,8 @@ struct option options[] = {
   {"show-ignore-edit", no_argument, &op_show_ignore_edit, 1},
   {"show-cfg1", required_argument, NULL, SHOW_CFG1},
   {"show-cfg2", required_argument, NULL, SHOW_CFG2},
+  {"show-format", required_argument, NULL, SHOW_FORMAT},
+  {"save-skip-unchanged", no_argument, &op_save_skip_unchanged, 1},
   {NULL, 0, NULL, 0}
 };
 
@@ -744,6 +806,9 @@ main(int argc, char **argv)
       case SHOW_CFG2:
         op_show_cfg2 = strdup(optarg);
         break;
+      case SHOW_FORMAT:
+        op_show_format = strdup(optarg);
+        break;
       default:
         break;
     }
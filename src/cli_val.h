@@ -68,7 +68,6 @@ extern vtw_node *make_var_node(char *str);
 extern vtw_node *make_str_node0(char *str, vtw_oper_e op);
 extern void append(vtw_list *l, vtw_node *n, int aux);
 
-extern int yy_cli_val_lex(void);
 extern void init_path(vtw_path *path, const char *root);
 extern void pop_path(vtw_path *path);
 extern void push_path(vtw_path *path, const char *segm);
@@ -81,7 +80,13 @@ extern vtw_path m_path, t_path;
      GLOBAL FUNCTIONS
 ***************************************************/
 extern void add_val(valstruct *first, valstruct *second);
-extern int cli_val_read(char *buf, int max_size);
+extern vtw_type_e cli_val_scan(const char *s, size_t len,
+                               unsigned int *parts, int *nparts);
+extern int cli_val_parts(vtw_type_e type, const char *s, size_t len,
+                         unsigned int *parts);
+extern size_t cli_val_scan_prefix(const char *s, size_t len,
+                                  vtw_type_e *type, unsigned int *parts,
+                                  int *nparts);
 extern vtw_node *make_val_node(valstruct *val);
 extern valstruct str2val(char *cp);
 extern void switch_path(first_seg *seg);
@@ -0,0 +1,319 @@
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "cli_val.h"
+
+/*
+ * Typed value scanner. These replace the flex scanner that used to
+ * classify values (cli_val.l). Each function works directly on the
+ * string without allocating and produces the binary form used for
+ * comparisons, so that a value only needs to be parsed once.
+ *
+ * The accepted syntax is the same as the original lexer:
+ *
+ *  ipv4      dec-octet "." dec-octet "." dec-octet "." dec-octet
+ *            where dec-octet is 25[0-5]|2[0-4][0-9]|[01][0-9][0-9]|[0-9]{1,2}
+ *  ipv4net   ipv4 "/" (3[012]|[12][0-9]|[0-9])
+ *  ipv6      RFC-3986 IPv6address, i.e., up to 8 groups of 1-4 hex digits
+ *            with at most one "::" and an optional trailing ipv4
+ *  ipv6net   ipv6 "/" (12[0-8]|1[01][0-9]|[0-9][0-9]?)
+ *  macaddr   [a-fA-F0-9]{1,2}(:[a-fA-F0-9]{1,2}){5}
+ *  u32       [0-9]+ not exceeding UINT_MAX
+ *  bool      "true" or "false"
+ *
+ * Binary forms (one unsigned int per part, compared part by part):
+ *  u32       the number
+ *  ipv4      4 bytes (+ prefix length for ipv4net)
+ *  ipv6      8 16-bit groups (+ prefix length for ipv6net)
+ *  macaddr   6 bytes
+ */
+
+static int
+hex_digit(char c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+/* parse 1 to max_digits decimal digits at s (not beyond end). return the
+   number of digits consumed (0 if none) */
+static int
+scan_dec(const char *s, const char *end, int max_digits, unsigned int *num)
+{
+  int n = 0;
+  *num = 0;
+  while (s + n < end && n < max_digits && s[n] >= '0' && s[n] <= '9') {
+    *num = *num * 10 + (s[n] - '0');
+    ++n;
+  }
+  return n;
+}
+
+/* dec-octet. must be followed by end or a non-digit */
+static const char *
+scan_ipv4_byte(const char *s, const char *end, unsigned int *byte)
+{
+  int n = scan_dec(s, end, 3, byte);
+  if (n == 0 || (s + n < end && s[n] >= '0' && s[n] <= '9'))
+    return NULL;
+  if (n == 3 && (s[0] > '2' || *byte > 255))
+    /* 3 digits must be [01][0-9][0-9], 2[0-4][0-9], or 25[0-5] */
+    return NULL;
+  return s + n;
+}
+
+static const char *
+scan_ipv4(const char *s, const char *end, unsigned int *parts)
+{
+  int i;
+  for (i = 0; i < 4; i++) {
+    if (i > 0) {
+      if (s >= end || *s != '.')
+        return NULL;
+      ++s;
+    }
+    if (!(s = scan_ipv4_byte(s, end, &parts[i])))
+      return NULL;
+  }
+  return s;
+}
+
+/* prefix length after '/'. the accepted forms differ between ipv4 and
+   ipv6, see above */
+static int
+scan_prefix(const char *s, const char *end, int v6, unsigned int *plen)
+{
+  int n = scan_dec(s, end, 3, plen);
+  if (s + n != end || n == 0)
+    return -1;
+  if (v6)
+    return ((n < 3 || (s[0] == '1' && *plen <= 128)) ? 0 : -1);
+  if (n == 1 || (n == 2 && (s[0] == '1' || s[0] == '2'))
+      || (n == 2 && s[0] == '3' && *plen <= 32))
+    return 0;
+  return -1;
+}
+
+/* ipv6 address at [s, end). return end of the address or NULL */
+static const char *
+scan_ipv6(const char *s, const char *end, unsigned int *parts)
+{
+  unsigned int groups[8];
+  int ngroups = 0;
+  int gap = -1;  /* group index where "::" is */
+  int i;
+
+  if (end - s >= 2 && s[0] == ':' && s[1] == ':') {
+    gap = 0;
+    s += 2;
+  }
+  while (s < end && *s != '/') {
+    const char *g = s;
+    unsigned int val = 0;
+    int d;
+    while (s < end && s - g < 4 && (d = hex_digit(*s)) >= 0) {
+      val = (val << 4) | d;
+      ++s;
+    }
+    if (s == g)
+      return NULL;
+    if (s < end && *s == '.') {
+      /* trailing ipv4, takes 2 groups */
+      unsigned int v4[4];
+      if (ngroups > 6 || !(s = scan_ipv4(g, end, v4)))
+        return NULL;
+      groups[ngroups++] = (v4[0] << 8) | v4[1];
+      groups[ngroups++] = (v4[2] << 8) | v4[3];
+      break;
+    }
+    if (ngroups == 8)
+      return NULL;
+    groups[ngroups++] = val;
+    if (s == end || *s == '/')
+      break;
+    if (*s != ':')
+      return NULL;
+    ++s;
+    if (s < end && *s == ':') {
+      if (gap >= 0)
+        return NULL;
+      gap = ngroups;
+      ++s;
+      if (s == end || *s == '/')
+        break;
+    } else if (s == end || *s == '/') {
+      /* trailing single ':' */
+      return NULL;
+    }
+  }
+  if (s < end && *s != '/')
+    return NULL;
+  if (gap < 0) {
+    if (ngroups != 8)
+      return NULL;
+    memcpy(parts, groups, sizeof(groups));
+  } else {
+    if (ngroups > 7)
+      return NULL;
+    for (i = 0; i < gap; i++)
+      parts[i] = groups[i];
+    for (; i < 8 - (ngroups - gap); i++)
+      parts[i] = 0;
+    for (; i < 8; i++)
+      parts[i] = groups[ngroups - (8 - i)];
+  }
+  return s;
+}
+
+static int
+scan_macaddr(const char *s, const char *end, unsigned int *parts)
+{
+  int i, d;
+  for (i = 0; i < 6; i++) {
+    if (i > 0) {
+      if (s >= end || *s != ':')
+        return -1;
+      ++s;
+    }
+    if (s >= end || (d = hex_digit(*s)) < 0)
+      return -1;
+    parts[i] = d;
+    ++s;
+    if (s < end && (d = hex_digit(*s)) >= 0) {
+      parts[i] = (parts[i] << 4) | d;
+      ++s;
+    }
+  }
+  return (s == end ? 0 : -1);
+}
+
+static int
+scan_int(const char *s, const char *end, unsigned int *num)
+{
+  unsigned long long v = 0;
+  if (s == end)
+    return -1;
+  for (; s < end; ++s) {
+    if (*s < '0' || *s > '9')
+      return -1;
+    v = v * 10 + (*s - '0');
+    if (v > UINT_MAX)
+      return -1;
+  }
+  *num = (unsigned int) v;
+  return 0;
+}
+
+/**************************************************
+  cli_val_parts:
+    parse the len bytes at s as a value of the
+    specified type and store the binary form in
+    parts (room for CLI_VAL_MAX_PARTS).
+    return the number of parts, 0 for a bool, or
+    -1 if not a valid value of the type
+****************************************************/
+int cli_val_parts(vtw_type_e type, const char *s, size_t len,
+                  unsigned int *parts)
+{
+  const char *end = s + len;
+  const char *p;
+
+  switch (type) {
+  case INT_TYPE:
+    return (scan_int(s, end, parts) == 0 ? 1 : -1);
+  case IPV4_TYPE:
+    return ((p = scan_ipv4(s, end, parts)) && p == end ? 4 : -1);
+  case IPV4NET_TYPE:
+    if (!(p = scan_ipv4(s, end, parts)) || p == end || *p != '/'
+        || scan_prefix(p + 1, end, 0, &parts[4]) != 0)
+      return -1;
+    return 5;
+  case IPV6_TYPE:
+    return ((p = scan_ipv6(s, end, parts)) && p == end ? 8 : -1);
+  case IPV6NET_TYPE:
+    if (!(p = scan_ipv6(s, end, parts)) || p == end
+        || scan_prefix(p + 1, end, 1, &parts[8]) != 0)
+      return -1;
+    return 9;
+  case MACADDR_TYPE:
+    return (scan_macaddr(s, end, parts) == 0 ? 6 : -1);
+  case BOOL_TYPE:
+    if ((len == 4 && memcmp(s, "true", 4) == 0)
+        || (len == 5 && memcmp(s, "false", 5) == 0))
+      return 0;
+    return -1;
+  default:
+    return -1;
+  }
+}
+
+/**************************************************
+  cli_val_scan:
+    classify the len bytes at s (a single token
+    without whitespace) the same way as the original
+    lexer. the binary form is stored in parts and the
+    number of parts in *nparts.
+    return the type or ERROR_TYPE if not a valid
+    typed value
+****************************************************/
+vtw_type_e cli_val_scan(const char *s, size_t len, unsigned int *parts,
+                        int *nparts)
+{
+  /* in the order of the lexer rules */
+  static const vtw_type_e types[] = {
+    BOOL_TYPE, INT_TYPE, IPV4_TYPE, IPV4NET_TYPE, IPV6_TYPE,
+    IPV6NET_TYPE, MACADDR_TYPE
+  };
+  int i, n;
+
+  if (len == 0)
+    return ERROR_TYPE;
+  for (i = 0; i < (int) (sizeof(types) / sizeof(types[0])); i++) {
+    /* quick reject by the characters the types can start with */
+    if (types[i] == BOOL_TYPE && s[0] != 't' && s[0] != 'f')
+      continue;
+    if ((n = cli_val_parts(types[i], s, len, parts)) >= 0) {
+      *nparts = n;
+      return types[i];
+    }
+  }
+  return ERROR_TYPE;
+}
+
+/**************************************************
+  cli_val_scan_prefix:
+    find the longest prefix of the len bytes at s
+    that the original lexer would have matched as a
+    value, so that a token with trailing garbage is
+    reported the same way (the value is followed by
+    a stray token). the type and binary form are
+    returned as by cli_val_scan(). a number that is
+    too large for u32 is matched with ERROR_TYPE,
+    since the lexer rejected it after matching.
+    return the length of the prefix or 0 if none
+****************************************************/
+size_t cli_val_scan_prefix(const char *s, size_t len, vtw_type_e *type,
+                           unsigned int *parts, int *nparts)
+{
+  size_t digits = 0, n;
+
+  while (digits < len && s[digits] >= '0' && s[digits] <= '9')
+    ++digits;
+  /* prefixes with a non-digit */
+  for (n = len; n > digits; n--) {
+    if ((*type = cli_val_scan(s, n, parts, nparts)) != ERROR_TYPE)
+      return n;
+  }
+  /* all-digit prefixes only match as a number */
+  if (digits > 0) {
+    *nparts = cli_val_parts(INT_TYPE, s, digits, parts);
+    *type = (*nparts == 1 ? INT_TYPE : ERROR_TYPE);
+  }
+  return digits;
+}
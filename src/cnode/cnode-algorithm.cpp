@@ -39,6 +39,70 @@ static const string PFX_DIFF_NULL = "";
 const string cnode::ACTIVE_CFG = "@ACTIVE";
 const string cnode::WORKING_CFG = "@WORKING";
 
+// skip subtrees with the same hash in the diff functions
+static bool diff_hash_skip = true;
+
+/* output buffer for the "show" functions. output is collected in a large
+ * buffer that is written out in big chunks instead of through many small
+ * fprintf() calls. the buffer itself is kept across calls.
+ */
+class ShowBuf {
+public:
+  ShowBuf(FILE *ost) : _ost(ost) {
+    if (_buf.capacity() < BUF_SIZE) {
+      _buf.reserve(BUF_SIZE + BUF_SIZE / 4);
+    }
+  };
+  ~ShowBuf() { flush(); };
+
+  ShowBuf& operator<<(const string& s) {
+    _buf.append(s);
+    return check();
+  };
+  ShowBuf& operator<<(const char *s) {
+    _buf.append(s);
+    return check();
+  };
+  ShowBuf& write(const char *s, size_t len) {
+    _buf.append(s, len);
+    return check();
+  };
+  ShowBuf& operator<<(char c) {
+    _buf.push_back(c);
+    return check();
+  };
+  // diff prefix followed by indentation for the specified level
+  void indent(const char *pfx, int level) {
+    static const string spaces(128, ' ');
+    _buf.append(pfx);
+    for (size_t n = level * 4; n > 0; ) {
+      size_t l = (n < spaces.size() ? n : spaces.size());
+      _buf.append(spaces, 0, l);
+      n -= l;
+    }
+  };
+  void flush() {
+    if (!_buf.empty()) {
+      fwrite(_buf.data(), 1, _buf.size(), _ost);
+      _buf.clear();
+    }
+  };
+
+private:
+  static const size_t BUF_SIZE = 65536;
+  static string _buf;
+
+  FILE *_ost;
+
+  ShowBuf& check() {
+    if (_buf.size() >= BUF_SIZE) {
+      flush();
+    }
+    return *this;
+  };
+};
+string ShowBuf::_buf;
+
 ////// static (internal) functions
 static inline const char *
 diff_to_pfx(DiffState s)
@@ -61,7 +125,7 @@ diff_to_pfx(DiffState s)
 static void
 _show_diff(const CfgNode *cfg1, const CfgNode *cfg2, int level,
            Cpath& cur_path, Cpath& last_ctx, bool show_def,
-           bool hide_secret, bool context_diff, FILE *ost);
+           bool hide_secret, bool context_diff, ShowBuf& out);
 
 static void
 _get_cmds_diff(const CfgNode *cfg1, const CfgNode *cfg2,
@@ -130,6 +194,28 @@ cnode::cmp_non_leaf_nodes(const CfgNode *cfg1, const CfgNode *cfg2,
     value = cfg->getValue();
   }
 
+  if (cfg1 == cfg2) {
+    /* showing a single config (no diff). all children exist on both sides
+     * so just sort them without building the union.
+     */
+    const vector<CfgNode *>& cnodes = cfg->getChildNodes();
+    vector<string> keys;
+    MapT<string, CfgNode *> nmap;
+    keys.reserve(cnodes.size());
+    for (size_t i = 0; i < cnodes.size(); i++) {
+      keys.push_back(is_tag_node
+                     ? cnodes[i]->getValue() : cnodes[i]->getName());
+      nmap[keys.back()] = cnodes[i];
+    }
+    Cstore::sortNodes(keys);
+    rcnodes1.reserve(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+      rcnodes1.push_back(nmap[keys[i]]);
+    }
+    rcnodes2 = rcnodes1;
+    return;
+  }
+
   // handle child nodes
   vector<CfgNode *> cnodes1, cnodes2;
   if (cfg1) {
@@ -192,67 +278,72 @@ _add_path_to_list(vector<Cpath>& list, Cpath& path, const string *nptr,
   }
 }
 
+static const char *SECRET_STR = "****************";
+
+// whether the value of the node with the specified name is a "secret"
+static bool
+_is_secret(const string& name)
+{
+  static const char *sname[] = { "passphrase", "password",
+                                 "pre-shared-secret", "key", NULL };
+  static size_t slen[] = { 10, 8, 17, 3, 0 };
+  size_t nlen = name.length();
+  for (size_t i = 0; sname[i]; i++) {
+    if (nlen < slen[i]) {
+      // can't match
+      continue;
+    }
+    if (name.find(sname[i], nlen - slen[i]) != name.npos) {
+      return true;
+    }
+  }
+  return false;
+}
+
 static void
 _print_value_str(const string& name, const char *vstr, bool hide_secret,
-                 FILE *ost)
+                 ShowBuf& out)
 {
   // handle secret hiding first
-  if (hide_secret) {
-    static const char *sname[] = { "passphrase", "password",
-                                   "pre-shared-secret", "key", NULL };
-    static size_t slen[] = { 10, 8, 17, 3, 0 };
-    size_t nlen = name.length();
-    for (size_t i = 0; sname[i]; i++) {
-      if (nlen < slen[i]) {
-        // can't match
-        continue;
-      }
-      if (name.find(sname[i], nlen - slen[i]) != name.npos) {
-        // found secret
-        fprintf(ost, "****************");
-        return;
-      }
-    }
+  if (hide_secret && _is_secret(name)) {
+    out << SECRET_STR;
+    return;
   }
 
-  const char *quote = "";
-  size_t vlen = strlen(vstr);
-  if (*vstr == 0 || strcspn(vstr, "*}{;\011\012\013\014\015 ") < vlen) {
-    quote = "\"";
+  if (*vstr == 0 || vstr[strcspn(vstr, "*}{;\011\012\013\014\015 ")]) {
+    out << '"' << vstr << '"';
+  } else {
+    out << vstr;
   }
-  fprintf(ost, "%s%s%s", quote, vstr, quote);
 }
 
 static void
 _diff_print_indent(const CfgNode *cfg1, const CfgNode *cfg2, int level,
-                   const char *pfx_diff, FILE *ost)
+                   const char *pfx_diff, ShowBuf& out)
 {
   /* note: activate/deactivate state output was handled here. pending
    *       redesign, the output notation will be changed to "per-subtree"
    *       marking, so the output will be handled with the rest of the node.
    */
-  fprintf(ost, "%s", pfx_diff);
-  for (int i = 0; i < level; i++) {
-    fprintf(ost, "    ");
-  }
+  out.indent(pfx_diff, level);
 }
 
 /* this is used by "context diff" to print the context in "edit notation"
  * like in JUNOS "show | compare".
  */
 static void
-_diff_print_context(Cpath& cur_path, Cpath& last_ctx, FILE *ost)
+_diff_print_context(Cpath& cur_path, Cpath& last_ctx, ShowBuf& out)
 {
   if (last_ctx == cur_path) {
     // don't repeat the context if it's still the same as the last one
     return;
   }
   last_ctx = cur_path;
-  fprintf(ost, "[edit");
+  out << "[edit";
   for (size_t i = 0; i < cur_path.size(); i++) {
-    fprintf(ost, " %s", cur_path[i]);
+    out << ' ' << cur_path[i];
   }
-  fprintf(ost, "]\n");
+  out << "]\n";
 }
 
 /* print the comment (if any) at the specified node, including "change
@@ -270,7 +361,7 @@ _diff_print_context(Cpath& cur_path, Cpath& last_ctx, FILE *ost)
 static bool
 _diff_print_comment(const CfgNode *cfg1, const CfgNode *cfg2, int level,
                     Cpath& cur_path, Cpath& last_ctx, bool context_diff,
-                    FILE *ost)
+                    ShowBuf& out)
 {
   const char *pfx_diff = PFX_DIFF_NONE.c_str();
   string comment = "";
@@ -315,10 +406,10 @@ _diff_print_comment(const CfgNode *cfg1, const CfgNode *cfg2, int level,
                         && pfx_diff != PFX_DIFF_NULL.c_str())) {
     if (context_diff) {
       // print context first
-      _diff_print_context(cur_path, last_ctx, ost);
+      _diff_print_context(cur_path, last_ctx, out);
     }
-    _diff_print_indent(cfg1, cfg2, level, pfx_diff, ost);
-    fprintf(ost, "/* %s */\n", comment.c_str());
+    _diff_print_indent(cfg1, cfg2, level, pfx_diff, out);
+    out << "/* " << comment << " */\n";
     return true;
   } else {
     return false;
@@ -328,7 +419,7 @@ _diff_print_comment(const CfgNode *cfg1, const CfgNode *cfg2, int level,
 static bool
 _diff_check_and_show_leaf(const CfgNode *cfg1, const CfgNode *cfg2, int level,
                           Cpath& cur_path, Cpath& last_ctx, bool show_def,
-                          bool hide_secret, bool context_diff, FILE *ost)
+                          bool hide_secret, bool context_diff, ShowBuf& out)
 {
   if ((cfg1 && !cfg1->isLeaf()) || (cfg2 && !cfg2->isLeaf())) {
     // not a leaf node
@@ -351,7 +442,7 @@ _diff_check_and_show_leaf(const CfgNode *cfg1, const CfgNode *cfg2, int level,
   }
 
   bool cprint = _diff_print_comment(cfg1, cfg2, level, cur_path, last_ctx,
-                                    context_diff, ost);
+                                    context_diff, out);
   if (cprint) {
     /* when doing context diff, normally we only show the node if there is a
      * difference. however, if something was printed for comment, the node
@@ -368,16 +459,16 @@ _diff_check_and_show_leaf(const CfgNode *cfg1, const CfgNode *cfg2, int level,
         /* if nothing was printed for comment and we're doing context diff,
          * then context hasn't been displayed yet. so print it first.
          */
-        _diff_print_context(cur_path, last_ctx, ost);
+        _diff_print_context(cur_path, last_ctx, out);
       }
       if (!context_diff || force_pfx_diff != PFX_DIFF_NULL.c_str()) {
         // not context diff OR there is a difference => print the node
         const vector<string>& vvec = cfg->getValues();
         for (size_t i = 0; i < vvec.size(); i++) {
-          _diff_print_indent(cfg1, cfg2, level, force_pfx_diff, ost);
-          fprintf(ost, "%s ", cfg->getName().c_str());
-          _print_value_str(cfg->getName(), vvec[i].c_str(), hide_secret, ost);
-          fprintf(ost, "\n");
+          _diff_print_indent(cfg1, cfg2, level, force_pfx_diff, out);
+          out << cfg->getName() << ' ';
+          _print_value_str(cfg->getName(), vvec[i].c_str(), hide_secret, out);
+          out << '\n';
         }
       }
     } else {
@@ -399,14 +490,14 @@ _diff_check_and_show_leaf(const CfgNode *cfg1, const CfgNode *cfg2, int level,
              * set cprint to true so that later iterations won't print it
              * again.
              */
-            _diff_print_context(cur_path, last_ctx, ost);
+            _diff_print_context(cur_path, last_ctx, out);
             cprint = true;
           }
-          _diff_print_indent(cfg1, cfg2, level, diff_to_pfx(pfxs[i]), ost);
-          fprintf(ost, "%s ", cfg->getName().c_str());
+          _diff_print_indent(cfg1, cfg2, level, diff_to_pfx(pfxs[i]), out);
+          out << cfg->getName() << ' ';
           _print_value_str(cfg->getName(), values[i].c_str(), hide_secret,
-                           ost);
-          fprintf(ost, "\n");
+                           out);
+          out << '\n';
         }
       }
     }
@@ -431,12 +522,12 @@ _diff_check_and_show_leaf(const CfgNode *cfg1, const CfgNode *cfg2, int level,
           /* if nothing was printed for comment and we're doing context diff,
            * then context hasn't been displayed yet. so print it first.
            */
-          _diff_print_context(cur_path, last_ctx, ost);
+          _diff_print_context(cur_path, last_ctx, out);
         }
-        _diff_print_indent(cfg1, cfg2, level, force_pfx_diff, ost);
-        fprintf(ost, "%s ", cfg->getName().c_str());
-        _print_value_str(cfg->getName(), val.c_str(), hide_secret, ost);
-        fprintf(ost, "\n");
+        _diff_print_indent(cfg1, cfg2, level, force_pfx_diff, out);
+        out << cfg->getName() << ' ';
+        _print_value_str(cfg->getName(), val.c_str(), hide_secret, out);
+        out << '\n';
       }
     }
   }
@@ -447,7 +538,7 @@ _diff_check_and_show_leaf(const CfgNode *cfg1, const CfgNode *cfg2, int level,
 static void 
 _diff_show_other(const CfgNode *cfg1, const CfgNode *cfg2, int level,
                  Cpath& cur_path, Cpath& last_ctx, bool show_def,
-                 bool hide_secret, bool context_diff, FILE *ost)
+                 bool hide_secret, bool context_diff, ShowBuf& out)
 {
   bool orig_cdiff = context_diff;
   const char *pfx_diff = PFX_DIFF_NONE.c_str();
@@ -476,7 +567,7 @@ _diff_show_other(const CfgNode *cfg1, const CfgNode *cfg2, int level,
   int next_level = level + 1;
   if (print_this) {
     bool cprint = _diff_print_comment(cfg1, cfg2, level, cur_path, last_ctx,
-                                      orig_cdiff, ost);
+                                      orig_cdiff, out);
     if (orig_cdiff && pfx_diff != PFX_DIFF_NONE.c_str()) {
       /* note:
        *   orig_cdiff is the original value of context_diff.
@@ -511,15 +602,15 @@ _diff_show_other(const CfgNode *cfg1, const CfgNode *cfg2, int level,
         /* if nothing was printed for comment and we're doing context diff,
          * then context hasn't been displayed yet. so print it first.
          */
-        _diff_print_context(cur_path, last_ctx, ost);
+        _diff_print_context(cur_path, last_ctx, out);
       }
-      _diff_print_indent(cfg1, cfg2, level, pfx_diff, ost);
+      _diff_print_indent(cfg1, cfg2, level, pfx_diff, out);
       if (is_value) {
         // at tag value
-        fprintf(ost, "%s %s", name.c_str(), value.c_str());
+        out << name << ' ' << value;
       } else {
         // at intermediate node
-        fprintf(ost, "%s", name.c_str());
+        out << name;
       }
       if (cprint && orig_cdiff && pfx_diff == PFX_DIFF_NONE.c_str()) {
         /* the condition means:
@@ -537,10 +628,10 @@ _diff_show_other(const CfgNode *cfg1, const CfgNode *cfg2, int level,
          * in this case also set is_leaf_typeless to true to prevent a
          * dangling "}\n" from being printed at the end of this function.
          */
-        fprintf(ost, " { ... }\n");
+        out << " { ... }\n";
         is_leaf_typeless = true;
       } else {
-        fprintf(ost, "%s\n", (is_leaf_typeless ? "" : " {"));
+        out << (is_leaf_typeless ? "\n" : " {\n");
       }
     }
 
@@ -554,7 +645,7 @@ _diff_show_other(const CfgNode *cfg1, const CfgNode *cfg2, int level,
 
   for (size_t i = 0; i < rcnodes1.size(); i++) {
     _show_diff(rcnodes1[i], rcnodes2[i], next_level, cur_path, last_ctx,
-               show_def, hide_secret, context_diff, ost);
+               show_def, hide_secret, context_diff, out);
   }
 
   // finish printing "this" node if necessary
@@ -569,8 +660,8 @@ _diff_show_other(const CfgNode *cfg1, const CfgNode *cfg2, int level,
        * is set to true to prevent this.
        */
       if (!is_leaf_typeless) {
-        _diff_print_indent(cfg1, cfg2, level, pfx_diff, ost);
-        fprintf(ost, "}\n");
+        _diff_print_indent(cfg1, cfg2, level, pfx_diff, out);
+        out << "}\n";
       }
     }
   }
@@ -579,7 +670,7 @@ _diff_show_other(const CfgNode *cfg1, const CfgNode *cfg2, int level,
 static void
 _show_diff(const CfgNode *cfg1, const CfgNode *cfg2, int level,
            Cpath& cur_path, Cpath& last_ctx, bool show_def,
-           bool hide_secret, bool context_diff, FILE *ost)
+           bool hide_secret, bool context_diff, ShowBuf& out)
 {
   // if doesn't exist, treat as NULL
   if (cfg1 && !cfg1->exists()) {
@@ -615,6 +706,13 @@ _show_diff(const CfgNode *cfg1, const CfgNode *cfg2, int level,
        */
       return;
     }
+    if (diff_hash_skip && cfg1 && cfg2
+        && cfg1->getSubtreeHash() == cfg2->getSubtreeHash()) {
+      /* identical subtrees => no difference to show, so skip the whole
+       * subtree.
+       */
+      return;
+    }
     /* when doing context diff, the display indentation level always starts
      * at 0.
      */
@@ -623,13 +721,13 @@ _show_diff(const CfgNode *cfg1, const CfgNode *cfg2, int level,
 
   if (_diff_check_and_show_leaf(cfg1, cfg2, (level >= 0 ? level : 0),
                                 cur_path, last_ctx, show_def, hide_secret,
-                                context_diff, ost)) {
+                                context_diff, out)) {
     // leaf node has been shown. done.
     return;
   } else {
     // intermediate node, tag node, or tag value
     _diff_show_other(cfg1, cfg2, level, cur_path, last_ctx, show_def,
-                     hide_secret, context_diff, ost);
+                     hide_secret, context_diff, out);
   }
 }
 
@@ -825,6 +923,11 @@ _get_cmds_diff(const CfgNode *cfg1, const CfgNode *cfg2,
     fprintf(stderr, "_get_cmds_diff error (both config NULL)\n");
     exit(1);
   }
+  if (diff_hash_skip && cfg1 && cfg2 && cfg1 != cfg2
+      && cfg1->getSubtreeHash() == cfg2->getSubtreeHash()) {
+    // identical subtrees => no commands
+    return;
+  }
 
   if (_get_cmds_diff_leaf(cfg1, cfg2, cur_path, del_list, set_list,
                           com_list)) {
@@ -837,22 +940,136 @@ _get_cmds_diff(const CfgNode *cfg1, const CfgNode *cfg2,
 }
 
 static void
-_print_cmds_list(const char *op, vector<Cpath>& list, FILE *ost)
+_print_cmds_list(const char *op, vector<Cpath>& list, ShowBuf& out)
 {
   static const char *special = "*}{\011\012\013\014\015 [;&`!$><|]?#\\~():";
   for (size_t i = 0; i < list.size(); i++) {
-    fprintf(ost, "%s", op);
+    out << op;
     for (size_t j = 0; j < list[i].size(); j++) {
       const char *s = list[i][j];
-      bool usequote = (strlen(s) == 0 || strcspn(s, special) < strlen(s));
+      bool usequote = (*s == 0 || s[strcspn(s, special)]);
       const char *quote = (usequote ? "'" : "");
-      fprintf(ost, " %s%s%s", quote, s, quote);
+      out << ' ' << quote << s << quote;
     }
-    fprintf(ost, "\n");
+    out << '\n';
   }
 }
 
+static void
+_json_print_str(const string& str, ShowBuf& out)
+{
+  static const char *hex = "0123456789abcdef";
+  out << '"';
+  const char *s = str.c_str();
+  for (size_t i = 0; s[i]; ) {
+    size_t n = i;
+    while (s[n] && s[n] != '"' && s[n] != '\\'
+           && (unsigned char) s[n] >= 0x20) {
+      n++;
+    }
+    if (n > i) {
+      out.write(s + i, n - i);
+      i = n;
+      continue;
+    }
+    char esc[7] = { '\\', s[i], 0, 0, 0, 0, 0 };
+    switch (s[i]) {
+    case '"':
+    case '\\':
+      break;
+    case '\n':
+      esc[1] = 'n';
+      break;
+    case '\t':
+      esc[1] = 't';
+      break;
+    default:
+      esc[1] = 'u';
+      esc[2] = '0';
+      esc[3] = '0';
+      esc[4] = hex[(s[i] >> 4) & 0xf];
+      esc[5] = hex[s[i] & 0xf];
+      break;
+    }
+    out << esc;
+    i++;
+  }
+  out << '"';
+}
+
+/* output the specified (non-leaf) node's children as json members. the
+ * structure follows the config tree:
+ *   intermediate node  "name": { ... }
+ *   tag node           "name": { "value": { ... }, ... }
+ *   single-value leaf  "name": "value"
+ *   multi-value leaf   "name": [ "value", ... ]
+ *   typeless leaf      "name": {}
+ * comments are not included.
+ */
+static void
+_show_json(const CfgNode *cfg, bool show_def, bool hide_secret,
+           ShowBuf& out)
+{
+  vector<CfgNode *> cnodes, dummy;
+  bool not_tag_node, is_value, is_leaf_typeless;
+  string name, value;
+  cmp_non_leaf_nodes(cfg, cfg, cnodes, dummy, not_tag_node, is_value,
+                     is_leaf_typeless, name, value);
+
+  out << '{';
+  bool first = true;
+  for (size_t i = 0; i < cnodes.size(); i++) {
+    const CfgNode *c = cnodes[i];
+    if (c->isLeaf() && !c->isLeafTypeless() && c->isDefault()
+        && !show_def) {
+      continue;
+    }
+    if (!first) {
+      out << ',';
+    }
+    first = false;
+    _json_print_str((not_tag_node ? c->getName() : c->getValue()), out);
+    out << ':';
+    /* note: parsed nodes without child templates (including leaf nodes)
+     * are "leaf typeless", so check for leaf first. a typeless leaf has
+     * no child nodes and comes out as "{}".
+     */
+    if (!c->isLeaf()) {
+      _show_json(c, show_def, hide_secret, out);
+    } else if (hide_secret && _is_secret(c->getName())) {
+      if (c->isMulti()) {
+        out << '[';
+        for (size_t j = 0; j < c->getValues().size(); j++) {
+          out << (j > 0 ? ",\"" : "\"") << SECRET_STR << '"';
+        }
+        out << ']';
+      } else {
+        out << '"' << SECRET_STR << '"';
+      }
+    } else if (c->isMulti()) {
+      const vector<string>& vals = c->getValues();
+      out << '[';
+      for (size_t j = 0; j < vals.size(); j++) {
+        if (j > 0) {
+          out << ',';
+        }
+        _json_print_str(vals[j], out);
+      }
+      out << ']';
+    } else {
+      _json_print_str(c->getValue(), out);
+    }
+  }
+  out << '}';
+}
+
 ////// algorithms
+void
+cnode::set_diff_hash_skip(bool skip)
+{
+  diff_hash_skip = skip;
+}
+
 void
 cnode::show_cfg_diff(const CfgNode& cfg1, const CfgNode& cfg2,
                      Cpath& cur_path, bool show_def, bool hide_secret,
@@ -869,8 +1086,9 @@ cnode::show_cfg_diff(const CfgNode& cfg1, const CfgNode& cfg2,
   }
   // use an invalid value for initial last_ctx
   Cpath last_ctx;
+  ShowBuf out(ost);
   _show_diff(&cfg1, &cfg2, -1, cur_path, last_ctx, show_def, hide_secret,
-             context_diff, ost);
+             context_diff, out);
 }
 
 void
@@ -890,9 +1108,10 @@ cnode::show_cmds_diff(const CfgNode& cfg1, const CfgNode& cfg2, FILE *ost)
   vector<Cpath> com_list;
   _get_cmds_diff(&cfg1, &cfg2, cur_path, del_list, set_list, com_list);
 
-  _print_cmds_list("delete", del_list, ost);
-  _print_cmds_list("set", set_list, ost);
-  _print_cmds_list("comment", com_list, ost);
+  ShowBuf out(ost);
+  _print_cmds_list("delete", del_list, out);
+  _print_cmds_list("set", set_list, out);
+  _print_cmds_list("comment", com_list, out);
 }
 
 void
@@ -901,6 +1120,45 @@ cnode::show_cmds(const CfgNode& cfg, FILE *ost)
   show_cmds_diff(cfg, cfg, ost);
 }
 
+void
+cnode::show_cfg_json(const CfgNode& cfg, bool show_def, bool hide_secret,
+                     FILE *ost)
+{
+  if (cfg.isInvalid()) {
+    printf("Specified configuration path is not valid\n");
+    return;
+  }
+  ShowBuf out(ost);
+  if (!cfg.exists()) {
+    out << "{}\n";
+    return;
+  }
+  if (cfg.isLeaf()) {
+    // path is a leaf node. output it as a single member.
+    out << '{';
+    _json_print_str(cfg.getName(), out);
+    out << ':';
+    if (hide_secret && _is_secret(cfg.getName())) {
+      out << '"' << SECRET_STR << '"';
+    } else if (cfg.isMulti()) {
+      out << '[';
+      for (size_t i = 0; i < cfg.getValues().size(); i++) {
+        if (i > 0) {
+          out << ',';
+        }
+        _json_print_str(cfg.getValues()[i], out);
+      }
+      out << ']';
+    } else {
+      _json_print_str(cfg.getValue(), out);
+    }
+    out << "}\n";
+    return;
+  }
+  _show_json(&cfg, show_def, hide_secret, out);
+  out << '\n';
+}
+
 void
 cnode::get_cmds_diff(const CfgNode& cfg1, const CfgNode& cfg2,
                      vector<Cpath>& del_list, vector<Cpath>& set_list,
@@ -923,7 +1181,7 @@ void
 cnode::showConfig(const string& cfg1, const string& cfg2,
                   const Cpath& path, bool show_def, bool hide_secret,
                   bool context_diff, bool show_cmds, bool ignore_edit,
-                  FILE *ost)
+                  FILE *ost, bool show_json)
 {
   tr1::shared_ptr<CfgNode> aroot, wroot, croot1, croot2;
   tr1::shared_ptr<Cstore> cstore;
@@ -967,7 +1225,10 @@ cnode::showConfig(const string& cfg1, const string& cfg2,
     return;
   }
 
-  if (show_cmds) {
+  if (show_json) {
+    // no diff in json output. show the second config.
+    show_cfg_json(*croot2, show_def, hide_secret, ost);
+  } else if (show_cmds) {
     show_cmds_diff(*croot1, *croot2, ost);
   } else {
     show_cfg_diff(*croot1, *croot2, cur_path, show_def, hide_secret,
@@ -984,13 +1245,21 @@ cnode::showConfig(const string& cfg1, const string& cfg2,
  */
 CfgNode *
 cnode::findCfgNode(CfgNode *root, const Cpath& path, bool& is_value)
+{
+  return const_cast<CfgNode *>(
+           findCfgNode(const_cast<const CfgNode *>(root), path, is_value));
+}
+
+// const version of above, e.g., for subtrees from Cstore::cfgPathGetSubtree()
+const CfgNode *
+cnode::findCfgNode(const CfgNode *root, const Cpath& path, bool& is_value)
 {
   is_value = false;
   if (path.size() < 1) {
     return NULL;
   }
 
-  CfgNode *node = root;
+  const CfgNode *node = root;
   for (size_t i = 0; i < path.size(); i++) {
     if (node->isLeaf()) {
       // reached a leaf node
@@ -1020,22 +1289,9 @@ cnode::findCfgNode(CfgNode *root, const Cpath& path, bool& is_value)
       }
     }
 
-    const vector<CfgNode *>& cnodes = node->getChildNodes();
-    bool found = false;
-    for (size_t j = 0; j < cnodes.size(); j++) {
-      if (cnodes[j]->isValue()) {
-        // tag value
-        found = (cnodes[j]->getValue() == path[i]);
-      } else {
-        // others
-        found = (cnodes[j]->getName() == path[i]);
-      }
-      if (found) {
-        node = cnodes[j];
-        break;
-      }
-    }
-    if (!found) {
+    // tag value or others
+    node = node->findChildNode(path[i]);
+    if (!node) {
       return NULL;
     }
   }
@@ -1051,6 +1307,13 @@ cnode::findCfgNode(CfgNode *root, const Cpath& path)
   return findCfgNode(root, path, dummy);
 }
 
+const CfgNode *
+cnode::findCfgNode(const CfgNode *root, const Cpath& path)
+{
+  bool dummy;
+  return findCfgNode(root, path, dummy);
+}
+
 bool
 cnode::getCfgNodeValue(CfgNode *root, const Cpath& path, string& value)
 {
@@ -43,6 +43,12 @@ void cmp_non_leaf_nodes(const CfgNode *cfg1, const CfgNode *cfg2,
                         bool& is_leaf_typeless, std::string& name,
                         std::string& value);
 
+/* the diff functions skip a pair of subtrees without comparing them if
+ * their hashes are the same. turning this off makes them compare every
+ * node (for checking the results of the skip).
+ */
+void set_diff_hash_skip(bool skip);
+
 void show_cfg_diff(const CfgNode& cfg1, const CfgNode& cfg2,
                    cstore::Cpath& cur_path, bool show_def = false,
                    bool hide_secret = false, bool context_diff = false,
@@ -53,6 +59,8 @@ void show_cfg(const CfgNode& cfg, bool show_def = false,
 void show_cmds_diff(const CfgNode& cfg1, const CfgNode& cfg2,
                     FILE *ost = stdout);
 void show_cmds(const CfgNode& cfg, FILE *ost = stdout);
+void show_cfg_json(const CfgNode& cfg, bool show_def = false,
+                   bool hide_secret = false, FILE *ost = stdout);
 
 void get_cmds_diff(const CfgNode& cfg1, const CfgNode& cfg2,
                    std::vector<cstore::Cpath>& del_list,
@@ -68,7 +76,7 @@ void showConfig(const std::string& cfg1, const std::string& cfg2,
                 const cstore::Cpath& path, bool show_def = false,
                 bool hide_secret = false, bool context_diff = false,
                 bool show_cmds = false, bool ignore_edit = false,
-                FILE *ost = stdout);
+                FILE *ost = stdout, bool show_json = false);
 
 /* these functions provide the functionality necessary for the "config
  * file" shell API. basically the API uses the "cparse" interface to
@@ -78,6 +86,9 @@ void showConfig(const std::string& cfg1, const std::string& cfg2,
 CfgNode *findCfgNode(CfgNode *root, const cstore::Cpath& path,
                      bool& is_value);
 CfgNode *findCfgNode(CfgNode *root, const cstore::Cpath& path);
+const CfgNode *findCfgNode(const CfgNode *root, const cstore::Cpath& path,
+                           bool& is_value);
+const CfgNode *findCfgNode(const CfgNode *root, const cstore::Cpath& path);
 bool getCfgNodeValue(CfgNode *root, const cstore::Cpath& path,
                      std::string& value);
 bool getCfgNodeValues(CfgNode *root, const cstore::Cpath& path,
@@ -40,10 +40,14 @@ public:
   node_type *getParent() const { return _parent; }
   node_type *childAt(size_t idx) { return _child_nodes[idx]; }
   void setParent(node_type *p) { _parent = p; }
-  void clearChildNodes() { _child_nodes.clear(); }
+  void clearChildNodes() {
+    _child_nodes.clear();
+    childNodesChanged();
+  }
   void addChildNode(node_type *cnode) {
     _child_nodes.push_back(cnode);
     cnode->_parent = static_cast<node_type *>(this);
+    childNodesChanged();
   }
 
   bool removeChildNode(node_type *cnode) {
@@ -51,6 +55,7 @@ public:
     while (it != _child_nodes.end()) {
       if (*it == cnode) {
         _child_nodes.erase(it);
+        childNodesChanged();
         return true;
       }
       ++it;
@@ -75,8 +80,13 @@ public:
       _child_nodes[i]->_parent = 0;
     }
     _child_nodes.clear();
+    childNodesChanged();
   }
 
+protected:
+  // called whenever the set of child nodes changes
+  virtual void childNodesChanged() {}
+
 private:
   node_type *_parent;
   nodes_vec_type _child_nodes;
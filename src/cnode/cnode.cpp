@@ -35,7 +35,8 @@ CfgNode::CfgNode(Cpath& path_comps, char *name, char *val, char *comment,
   : TreeNode<CfgNode>(),
     _is_tag(false), _is_leaf(false), _is_multi(false), _is_value(false),
     _is_default(false), _is_deactivated(false), _is_leaf_typeless(false),
-    _is_invalid(false), _exists(true), _path_comps(path_comps)
+    _is_invalid(false), _exists(true), _path_comps(path_comps),
+    _hash(0), _hash_valid(false)
 {
   if (name && name[0]) {
     // name must be non-empty
@@ -129,28 +130,34 @@ CfgNode::CfgNode(Cpath& path_comps, char *name, char *val, char *comment,
 
 // for active/working config
 CfgNode::CfgNode(Cstore& cstore, Cpath& path_comps, bool active,
-                 bool recursive)
+                 bool recursive, size_t max_depth, bool skip_deactivated)
   : TreeNode<CfgNode>(),
     _is_tag(false), _is_leaf(false), _is_multi(false), _is_value(false),
     _is_default(false), _is_deactivated(false), _is_leaf_typeless(false),
-    _is_invalid(false), _exists(true), _path_comps(path_comps)
+    _is_invalid(false), _exists(true), _path_comps(path_comps),
+    _hash(0), _hash_valid(false)
 {
-  _init(cstore, path_comps, active, recursive, NULL);
+  _init(cstore, path_comps, active, recursive, NULL, max_depth,
+        skip_deactivated);
 }
 
 CfgNode::CfgNode(Cstore& cstore, Cpath& path_comps, const bool active,
-                 const bool recursive, const CfgNode * const parent)
+                 const bool recursive, const CfgNode * const parent,
+                 const size_t max_depth, const bool skip_deactivated)
   : TreeNode<CfgNode>(),
     _is_tag(false), _is_leaf(false), _is_multi(false), _is_value(false),
     _is_default(false), _is_deactivated(false), _is_leaf_typeless(false),
-    _is_invalid(false), _exists(true), _path_comps(path_comps)
+    _is_invalid(false), _exists(true), _path_comps(path_comps),
+    _hash(0), _hash_valid(false)
 {
-  _init(cstore, path_comps, active, recursive, parent);
+  _init(cstore, path_comps, active, recursive, parent, max_depth,
+        skip_deactivated);
 }
 
 void
 CfgNode::_init(Cstore& cstore, Cpath& path_comps, const bool active,
-               const bool recursive, const CfgNode * const parent)
+               const bool recursive, const CfgNode * const parent,
+               const size_t max_depth, const bool skip_deactivated)
 {
   vector<string> cnodes, cmarkers;
   /* first get the def (only if path is not empty). if path is empty, i.e.,
@@ -181,6 +188,10 @@ CfgNode::_init(Cstore& cstore, Cpath& path_comps, const bool active,
       } else {
         _is_deactivated = cstore._cfgPathLeafDeactivated(cmarkers);
       }
+      if (parent && skip_deactivated && _is_deactivated) {
+        // parent drops this node, don't read the rest of it
+        return;
+      }
       if (cstore._cfgPathCommentExists(cmarkers)) {
         cstore._cfgPathGetComment(path_comps, _comment, active);
       }
@@ -247,13 +258,26 @@ CfgNode::_init(Cstore& cstore, Cpath& path_comps, const bool active,
     return;
   }
 
-  // recurse
+  /* recurse. with a depth limit, nodes at the last level still get their
+   * own content (value, comment, etc.) but not their child nodes.
+   */
+  bool crecursive = (max_depth != 1);
+  size_t cdepth = (max_depth > 0 ? max_depth - 1 : 0);
   for (size_t i = 0; i < cnodes.size(); i++) {
     path_comps.push(cnodes[i]);
-    CfgNode *cn = new CfgNode(cstore, path_comps, active, recursive, this);
-    addChildNode(cn);
+    CfgNode *cn = new CfgNode(cstore, path_comps, active, crecursive, this,
+                              cdepth, skip_deactivated);
+    if (skip_deactivated && (cn->isDeactivated() || !cn->exists())) {
+      delete cn;
+    } else {
+      addChildNode(cn);
+    }
     path_comps.pop();
   }
+  if (parent && skip_deactivated && isTagNode() && numChildNodes() == 0) {
+    // all tag values are deactivated, parent drops this tag node too
+    _exists = false;
+  }
 }
 
 /* creates working configuration node from active if cstore particular
@@ -267,7 +291,8 @@ CfgNode::CfgNode(cstore::Cstore& cstore, const CfgNode& aroot)
   _is_deactivated(aroot._is_deactivated),
   _is_leaf_typeless(aroot._is_leaf_typeless), _is_invalid(aroot._is_invalid),
   _exists(aroot._exists), _name(aroot._name), _value(aroot._value),
-  _values(aroot._values), _comment(aroot._comment), _path_comps(aroot._path_comps)
+  _values(aroot._values), _comment(aroot._comment), _path_comps(aroot._path_comps),
+  _hash(0), _hash_valid(false)
 {
   if (!aroot.getName().empty() || aroot.isInvalid() || !aroot.exists()) {
     return;
@@ -283,7 +308,8 @@ CfgNode::CfgNode(cstore::Cstore& cstore, const CfgNode& anode,
   _is_deactivated(anode._is_deactivated),
   _is_leaf_typeless(anode._is_leaf_typeless), _is_invalid(anode._is_invalid),
   _exists(anode._exists), _name(anode._name), _value(anode._value),
-  _values(anode._values), _comment(anode._comment), _path_comps(anode._path_comps)
+  _values(anode._values), _comment(anode._comment), _path_comps(anode._path_comps),
+  _hash(0), _hash_valid(false)
 {
   if (changed) {
     _copy_init(cstore, anode, parent);
@@ -388,4 +414,101 @@ CfgNode::_copy_init(cstore::Cstore& cstore, const CfgNode& anode,
       }
     }
   }
-}
\ No newline at end of file
+}
+
+////// child lookup
+CfgNode *
+CfgNode::findChildNode(const char *key) const
+{
+  const vector<CfgNode *>& cnodes = getChildNodes();
+  if (cnodes.size() < CHILD_INDEX_MIN) {
+    // not worth an index
+    for (size_t i = 0; i < cnodes.size(); i++) {
+      const string& k = (cnodes[i]->isValue()
+                         ? cnodes[i]->getValue() : cnodes[i]->getName());
+      if (k == key) {
+        return cnodes[i];
+      }
+    }
+    return NULL;
+  }
+
+  if (!_child_index.get()) {
+    _child_index.reset(new ChildIndex);
+    for (size_t i = 0; i < cnodes.size(); i++) {
+      const string& k = (cnodes[i]->isValue()
+                         ? cnodes[i]->getValue() : cnodes[i]->getName());
+      // keep the first one if there are duplicates
+      _child_index->insert(make_pair(k, cnodes[i]));
+    }
+  }
+  ChildIndex::const_iterator it = _child_index->find(key);
+  return (it != _child_index->end() ? it->second : NULL);
+}
+
+////// subtree hash
+static inline unsigned long long
+_hash_bytes(unsigned long long h, const char *data, size_t len)
+{
+  // FNV-1a
+  for (size_t i = 0; i < len; i++) {
+    h ^= (unsigned char) data[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+static inline unsigned long long
+_hash_str(unsigned long long h, const string& str)
+{
+  // include the length so that adjacent strings cannot run together
+  size_t len = str.size();
+  h = _hash_bytes(h, (const char *) &len, sizeof(len));
+  return _hash_bytes(h, str.data(), len);
+}
+
+static inline unsigned long long
+_hash_mix(unsigned long long h)
+{
+  // splitmix64 finalizer
+  h ^= (h >> 30);
+  h *= 0xbf58476d1ce4e5b9ULL;
+  h ^= (h >> 27);
+  h *= 0x94d049bb133111ebULL;
+  h ^= (h >> 31);
+  return h;
+}
+
+unsigned long long
+CfgNode::getSubtreeHash() const
+{
+  if (_hash_valid) {
+    return _hash;
+  }
+
+  unsigned long long h = 14695981039346656037ULL;
+  char flags[9] = { _is_tag, _is_leaf, _is_multi, _is_value, _is_default,
+                    _is_deactivated, _is_leaf_typeless, _is_invalid,
+                    _exists };
+  h = _hash_bytes(h, flags, sizeof(flags));
+  h = _hash_str(h, _name);
+  h = _hash_str(h, _value);
+  h = _hash_str(h, _comment);
+  size_t nvals = _values.size();
+  h = _hash_bytes(h, (const char *) &nvals, sizeof(nvals));
+  for (size_t i = 0; i < nvals; i++) {
+    h = _hash_str(h, _values[i]);
+  }
+
+  /* child nodes are combined with a sum so that their order does not
+   * matter (the diff functions sort them anyway).
+   */
+  const vector<CfgNode *>& cnodes = getChildNodes();
+  unsigned long long csum = cnodes.size();
+  for (size_t i = 0; i < cnodes.size(); i++) {
+    csum += _hash_mix(cnodes[i]->getSubtreeHash());
+  }
+  _hash = _hash_mix(h ^ _hash_mix(csum));
+  _hash_valid = true;
+  return _hash;
+}
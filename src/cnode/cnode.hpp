@@ -31,9 +31,14 @@ public:
   // constructor for parser
   CfgNode(cstore::Cpath& path_comps, char *name, char *val, char *comment,
           int deact, cstore::Cstore *cstore, bool tag_if_invalid = false);
-  // constructor for active/working config
+  /* constructor for active/working config. if max_depth is non-zero,
+   * only that many levels below path_comps are read. if skip_deactivated,
+   * deactivated nodes below path_comps (and tag nodes left without tag
+   * values) are not read at all, as the non-DA observers see the config.
+   */
   CfgNode(cstore::Cstore& cstore, cstore::Cpath& path_comps,
-          bool active = false, bool recursive = true);
+          bool active = false, bool recursive = true, size_t max_depth = 0,
+          bool skip_deactivated = false);
   // constructor for working config from active and changes
   CfgNode(cstore::Cstore& cstore, const CfgNode& aroot);
   ~CfgNode() {};
@@ -56,8 +61,34 @@ public:
   const std::string& getComment() const { return _comment; }
   const cstore::Cpath& getPath() const { return _path_comps; }
 
-  void addMultiValue(char *val) { _values.push_back(val); }
-  void setValue(char *val) { _value = val; }
+  void addMultiValue(char *val) {
+    _values.push_back(val);
+    invalidateHash();
+  }
+  void setValue(char *val) {
+    _value = val;
+    invalidateHash();
+    if (getParent()) {
+      // value of a tag value is its key in the parent's index
+      getParent()->childNodesChanged();
+    }
+  }
+
+  /* return the child node with the specified name (or value for a tag
+   * value), or NULL if there is none. if there are more than one, the first
+   * one is returned. for a node with many child nodes, an index is built on
+   * the first lookup and kept until the child nodes change.
+   */
+  CfgNode *findChildNode(const char *key) const;
+
+  /* hash of the whole subtree rooted at this node, covering the names,
+   * values, comments, and node flags (including deactivated state). the
+   * order of the child nodes does not matter, but the order of the values
+   * of a multi-value node does. the hash is computed on first use and
+   * cached. changing a value or the child nodes of a node drops the cached
+   * hash of the node and all its ancestors.
+   */
+  unsigned long long getSubtreeHash() const;
 
   // XXX testing
   void rprint(size_t lvl) {
@@ -81,17 +112,34 @@ protected:
 
   CfgNode(cstore::Cstore& cstore, cstore::Cpath& path_comps,
           const bool active, const bool recursive,
-          const CfgNode * const parent);
+          const CfgNode * const parent, const size_t max_depth = 0,
+          const bool skip_deactivated = false);
   CfgNode(cstore::Cstore& cstore, const CfgNode& anode,
           const CfgNode *const parent, const bool changed);
 
   void _init(cstore::Cstore& cstore, cstore::Cpath& path_comps,
              const bool active, const bool recursive,
-             const CfgNode * const parent);
+             const CfgNode * const parent, const size_t max_depth = 0,
+             const bool skip_deactivated = false);
   void _copy_init(cstore::Cstore& cstore, const CfgNode& anode,
                   const CfgNode *const parent);
 
+  void childNodesChanged() {
+    _child_index.reset();
+    invalidateHash();
+  }
+  void invalidateHash() const {
+    for (const CfgNode *n = this; n; n = n->getParent()) {
+      n->_hash_valid = false;
+    }
+  }
+
 private:
+  typedef cstore::MapT<std::string, CfgNode *> ChildIndex;
+
+  // minimum number of child nodes for findChildNode() to build an index
+  static const size_t CHILD_INDEX_MIN = 16;
+
   bool _is_tag;
   bool _is_leaf;
   bool _is_multi;
@@ -106,6 +154,12 @@ private:
   std::vector<std::string> _values;
   std::string _comment;
   cstore::Cpath _path_comps;
+  mutable unsigned long long _hash;
+  mutable bool _hash_valid;
+  /* child nodes by key. the index is never modified once built, so copies
+   * of the node can share it.
+   */
+  mutable std::tr1::shared_ptr<ChildIndex> _child_index;
 };
 
 } // namespace cnode
@@ -20,9 +20,11 @@
 #include <errno.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <time.h>
 
 #include <cli_cstore.h>
 #include <commit/commit-algorithm.hpp>
+#include <commit/commit-deps.hpp>
 #include <cnode/cnode-algorithm.hpp>
 
 using namespace commit;
@@ -36,6 +38,12 @@ static const char *commit_hook_dirs[3] = {
   NULL
 };
 
+/* if set, the dependency graph of the commit is written to the file
+ * specified by this variable (JSON if the name ends in ".json", DOT
+ * otherwise).
+ */
+static const char *commit_dep_graph_env = "COMMIT_DEP_GRAPH";
+
 static void
 _set_node_commit_state(CfgNode& node, CommitState s, bool recursive)
 {
@@ -690,6 +698,29 @@ _commit_exec_prio_subtree(Cstore& cs, PrioNode *proot)
   return true;
 }
 
+// commit one priority subtree and report it to the observer if any
+static bool
+_commit_exec_prio_node(Cstore& cs, PrioNode *pnode, CommitObserver *obs)
+{
+  if (!obs) {
+    return _commit_exec_prio_subtree(cs, pnode);
+  }
+  if (obs->cancelRequested()) {
+    // skip the rest
+    pnode->setSucceeded(false);
+    return false;
+  }
+  obs->prioStart(*pnode);
+  struct timespec t0, t1;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  bool ret = _commit_exec_prio_subtree(cs, pnode);
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  unsigned long msec = ((t1.tv_sec - t0.tv_sec) * 1000
+                        + (t1.tv_nsec - t0.tv_nsec) / 1000000);
+  obs->prioEnd(*pnode, ret, msec);
+  return ret;
+}
+
 static CfgNode *
 _get_commit_leaf_node(CfgNode *cfg1, CfgNode *cfg2, const Cpath& cur_path,
                       bool& is_leaf)
@@ -801,6 +832,38 @@ _execute_hooks(CommitHook hook, Cstore& cs)
   }
 }
 
+static void
+_export_dep_graph(Cstore& cs, const PrioQueueT& pq, const DelPrioQueueT& dpq)
+{
+  const char *fname = getenv(commit_dep_graph_env);
+  if (!fname || !fname[0]) {
+    return;
+  }
+  FILE *out = fopen(fname, "w");
+  if (!out) {
+    OUTPUT_USER("Failed to open [%s] for the commit dependency graph\n",
+                fname);
+    return;
+  }
+  CommitDepGraph deps(cs, pq, dpq);
+  for (size_t i = 0; i < deps.numEdges(); i++) {
+    const CommitDepGraph::Edge& e = deps.edgeAt(i);
+    if (e.inverted) {
+      OUTPUT_USER("Warning: [%s] should be committed before [%s] (%s)\n",
+                  deps.nodeAt(e.from)->getCommitPath().to_string().c_str(),
+                  deps.nodeAt(e.to)->getCommitPath().to_string().c_str(),
+                  CommitDepGraph::edgeTypeName(e.type));
+    }
+  }
+  size_t len = strlen(fname);
+  if (len >= 5 && strcmp(fname + len - 5, ".json") == 0) {
+    deps.writeJson(out);
+  } else {
+    deps.writeDot(out);
+  }
+  fclose(out);
+}
+
 
 ////// class CommitData
 CommitData::CommitData()
@@ -1142,6 +1205,16 @@ bool
 commit::isCommitPathEffective(Cstore& cs, const Cpath& pcomps,
                               tr1::shared_ptr<Ctemplate> def,
                               bool in_active, bool in_working)
+{
+  return isCommitPathEffective(cs, pcomps, def->isTagNode(), in_active,
+                               in_working);
+}
+
+// same as above for callers that already know the node type
+bool
+commit::isCommitPathEffective(Cstore& cs, const Cpath& pcomps,
+                              bool is_tag_node, bool in_active,
+                              bool in_working)
 {
   if (in_active && in_working) {
     // remain the same
@@ -1153,7 +1226,7 @@ commit::isCommitPathEffective(Cstore& cs, const Cpath& pcomps,
   }
   // at this point, in_active corresponds to "being deleted"
 
-  if (def->isTagNode()) {
+  if (is_tag_node) {
     // special handling for tag nodes, which are never marked
     vector<string> tvals;
     // get tag values from active or working config
@@ -1217,7 +1290,8 @@ public:
 };
 
 bool
-commit::doCommit(Cstore& cs, CfgNode& cfg1, CfgNode& cfg2)
+commit::doCommit(Cstore& cs, CfgNode& cfg1, CfgNode& cfg2,
+                 CommitObserver *obs)
 {
   SetCommitSession scs;
 
@@ -1271,9 +1345,11 @@ commit::doCommit(Cstore& cs, CfgNode& cfg1, CfgNode& cfg2)
   _get_commit_prio_queue(&proot, pq, dpq);
   size_t s = 0, f = 0;
   cs.enableCacheMode();
+  cs.enableVarRefCache();
+  _export_dep_graph(cs, pq, dpq);
   while (!dpq.empty()) {
     PrioNode *p = dpq.top();
-    if (!_commit_exec_prio_subtree(cs, p)) {
+    if (!_commit_exec_prio_node(cs, p, obs)) {
       // prio subtree failed
       ++f;
     } else {
@@ -1284,7 +1360,7 @@ commit::doCommit(Cstore& cs, CfgNode& cfg1, CfgNode& cfg2)
   }
   while (!pq.empty()) {
     PrioNode *p = pq.top();
-    if (!_commit_exec_prio_subtree(cs, p)) {
+    if (!_commit_exec_prio_node(cs, p, obs)) {
       // prio subtree failed
       ++f;
     } else {
@@ -1294,6 +1370,17 @@ commit::doCommit(Cstore& cs, CfgNode& cfg1, CfgNode& cfg2)
     pq.pop();
   }
   cs.disableCacheMode();
+  {
+    // export var ref cache statistics along with the commit status
+    size_t hits, misses;
+    cs.getVarRefCacheStats(hits, misses);
+    cs.disableVarRefCache();
+    char buf[64];
+    snprintf(buf, sizeof(buf), "hits=%zu misses=%zu", hits, misses);
+    setenv("COMMIT_VARREF_CACHE", buf, 1);
+  }
+  // active config changed
+  Cstore::invalidateCompletionCache();
   bool ret = true;
   const char *cst = "SUCCESS";
   if (f > 0) {
@@ -22,6 +22,7 @@
 #include <tr1/memory>
 
 #include <cnode/cnode-util.hpp>
+#include <cstore/util.hpp>
 #include <cstore/cpath.hpp>
 #include <cstore/ctemplate.hpp>
 
@@ -160,13 +161,32 @@ typedef std::pair<CommitState, std::tr1::shared_ptr<Cpath> >
   CommittedPathT;
 typedef std::vector<CommittedPathT> CommittedPathListT;
 
+/* observer for commit progress, e.g., for reporting progress of a commit
+ * running in the background. the default does nothing.
+ */
+class CommitObserver {
+public:
+  virtual ~CommitObserver() {};
+
+  // called before and after each priority subtree is committed
+  virtual void prioStart(PrioNode& pnode) {};
+  virtual void prioEnd(PrioNode& pnode, bool success, unsigned long msec) {};
+  /* checked before each priority subtree. once this returns true, the
+   * remaining priority subtrees are not committed (i.e., they fail).
+   */
+  virtual bool cancelRequested() { return false; };
+};
+
 // exported functions
 const char *getCommitHookDir(CommitHook hook);
 CfgNode *getCommitTree(CfgNode *cfg1, CfgNode *cfg2, const Cpath& cur_path);
 bool isCommitPathEffective(Cstore& cs, const Cpath& pcomps,
                            std::tr1::shared_ptr<Ctemplate> def,
                            bool in_active, bool in_working);
-bool doCommit(Cstore& cs, CfgNode& cfg1, CfgNode& cfg2);
+bool isCommitPathEffective(Cstore& cs, const Cpath& pcomps, bool is_tag_node,
+                           bool in_active, bool in_working);
+bool doCommit(Cstore& cs, CfgNode& cfg1, CfgNode& cfg2,
+              CommitObserver *obs = NULL);
 
 } // namespace commit
 
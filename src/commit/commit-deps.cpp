@@ -0,0 +1,436 @@
+/*
+ * Copyright (C) 2011 Vyatta, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <string>
+
+#include <cli_cstore.h>
+#include <cstore/cstore.hpp>
+#include <cnode/cnode.hpp>
+#include <commit/commit-deps.hpp>
+
+using namespace commit;
+using namespace std;
+
+////// static
+static const char *VAR_REF_MARKER = "$VAR(";
+
+/* refs used by a template: the $VAR() refs in its actions and the
+ * "depends:" hints. parsed templates are cached by the cstore for the
+ * lifetime of the process, so these are cached per template as well. the
+ * entry holds on to the template so that the key stays valid.
+ */
+struct TmplRefsT {
+  tr1::shared_ptr<Ctemplate> tmpl;
+  vector<string> var_refs;
+  vector<string> hints;
+};
+
+typedef MapT<const vtw_def *, tr1::shared_ptr<TmplRefsT> > TmplRefsCacheT;
+static TmplRefsCacheT _tmpl_refs_cache;
+
+static void
+_add_ref(vector<string>& refs, MapT<string, bool>& added, const string& ref)
+{
+  if (ref.empty() || ref == "@" || added.find(ref) != added.end()) {
+    // self-reference does not go outside the node
+    return;
+  }
+  added[ref] = true;
+  refs.push_back(ref);
+}
+
+// find all "$VAR(...)" in str (same parsing as expand_string())
+static void
+_get_str_var_refs(const char *str, vector<string>& refs,
+                  MapT<string, bool>& added)
+{
+  const char *p = str;
+  size_t mlen = strlen(VAR_REF_MARKER);
+  while ((p = strstr(p, VAR_REF_MARKER))) {
+    p += mlen;
+    const char *e = strchr(p, ')');
+    if (!e) {
+      break;
+    }
+    _add_ref(refs, added, string(p, e - p));
+    p = e + 1;
+  }
+}
+
+static void
+_get_action_var_refs(const vtw_node *node, vector<string>& refs,
+                     MapT<string, bool>& added)
+{
+  /* var refs can be in VAR_OP nodes (syntax expressions) and in the
+   * command strings, so just check all strings.
+   */
+  for (; node; node = node->vtw_node_right) {
+    if (node->vtw_node_string) {
+      _get_str_var_refs(node->vtw_node_string, refs, added);
+    }
+    _get_action_var_refs(node->vtw_node_left, refs, added);
+  }
+}
+
+static tr1::shared_ptr<TmplRefsT>
+_get_tmpl_refs(tr1::shared_ptr<Ctemplate> tmpl)
+{
+  const vtw_def *def = tmpl->getDef();
+  TmplRefsCacheT::iterator it = _tmpl_refs_cache.find(def);
+  if (it != _tmpl_refs_cache.end()) {
+    return it->second;
+  }
+
+  tr1::shared_ptr<TmplRefsT> r(new TmplRefsT);
+  r->tmpl = tmpl;
+  MapT<string, bool> added;
+  for (int act = 0; act < top_act; act++) {
+    _get_action_var_refs(tmpl->getActions(static_cast<vtw_act_type>(act)),
+                         r->var_refs, added);
+  }
+  if (tmpl->getDepends()) {
+    // whitespace-separated list of refs
+    added.clear();
+    const char *ws = " \t\n";
+    const char *p = tmpl->getDepends();
+    while (*(p += strspn(p, ws))) {
+      size_t len = strcspn(p, ws);
+      _add_ref(r->hints, added, string(p, len));
+      p += len;
+    }
+  }
+  _tmpl_refs_cache[def] = r;
+  return r;
+}
+
+static bool
+_is_path_prefix(const Cpath& prefix, const Cpath& path)
+{
+  if (prefix.size() > path.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < prefix.size(); i++) {
+    if (strcmp(prefix[i], path[i]) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* get the path and "at" string used when the actions of the node are
+ * executed. see _exec_node_actions() and _exec_multi_node_actions().
+ */
+static void
+_get_node_action_path(const CfgNode& node, Cpath& path, string& at_str)
+{
+  path = node.getCommitPath();
+  if (node.isMulti()) {
+    at_str = (node.numCommitMultiValues() > 0
+              ? node.commitMultiValueAt(0) : "");
+  } else if (node.isLeaf()) {
+    at_str = ((node.getCommitState() == COMMIT_STATE_CHANGED)
+              ? node.commitValueAfter() : node.getValue());
+  } else if (node.isValue()) {
+    at_str = node.getValue();
+    path.pop();
+  } else {
+    at_str = node.getName();
+  }
+}
+
+static const char *
+_commit_state_name(CommitState s)
+{
+  switch (s) {
+  case COMMIT_STATE_ADDED:
+    return "added";
+  case COMMIT_STATE_DELETED:
+    return "deleted";
+  case COMMIT_STATE_CHANGED:
+    return "changed";
+  default:
+    return "unchanged";
+  }
+}
+
+static void
+_write_escaped(FILE *out, const string& str)
+{
+  for (size_t i = 0; i < str.size(); i++) {
+    unsigned char c = str[i];
+    if (c == '"' || c == '\\') {
+      fprintf(out, "\\%c", c);
+    } else if (c < 0x20) {
+      fprintf(out, "\\u%04x", c);
+    } else {
+      fputc(c, out);
+    }
+  }
+}
+
+////// class CommitDepGraph
+CommitDepGraph::CommitDepGraph(Cstore& cs, PrioQueueT pq, DelPrioQueueT dpq)
+  : _num_inverted(0), _num_del(0)
+{
+  // same order as doCommit()
+  for (; !dpq.empty(); dpq.pop()) {
+    _nodes.push_back(dpq.top());
+  }
+  _num_del = _nodes.size();
+  for (; !pq.empty(); pq.pop()) {
+    _nodes.push_back(pq.top());
+  }
+  MapT<PrioNode *, size_t> pidx;
+  for (size_t i = 0; i < _nodes.size(); i++) {
+    pidx[_nodes[i]] = i;
+    _path_idx[_nodes[i]->getCommitPath()] = i;
+  }
+
+  for (size_t i = 0; i < _nodes.size(); i++) {
+    // hierarchical constraint
+    PrioNode *pp = _nodes[i]->getParent();
+    MapT<PrioNode *, size_t>::iterator it;
+    if (pp && (it = pidx.find(pp)) != pidx.end()) {
+      /* parent first, except that deleted children are deleted before
+       * the parent. this is what the commit order does.
+       */
+      size_t p = it->second;
+      _add_edge((p < i ? p : i), (p < i ? i : p), EDGE_PRIORITY);
+    }
+  }
+  for (size_t i = 0; i < _nodes.size(); i++) {
+    // refs from all nodes in the subtree
+    if (_nodes[i]->getCfgNode()) {
+      _add_cfg_node_deps(cs, i, *(_nodes[i]->getCfgNode()));
+    }
+  }
+
+  /* for the levels, each edge keeps the current order of its two nodes,
+   * so a single pass is enough.
+   */
+  vector<vector<size_t> > preds(_nodes.size());
+  for (size_t i = 0; i < _edges.size(); i++) {
+    const Edge& e = _edges[i];
+    preds[e.inverted ? e.from : e.to].push_back(e.inverted ? e.to : e.from);
+  }
+  _levels.assign(_nodes.size(), 0);
+  for (size_t i = 0; i < _nodes.size(); i++) {
+    for (size_t j = 0; j < preds[i].size(); j++) {
+      if (_levels[preds[i][j]] + 1 > _levels[i]) {
+        _levels[i] = _levels[preds[i][j]] + 1;
+      }
+    }
+  }
+}
+
+size_t
+CommitDepGraph::numLevels() const
+{
+  size_t n = 0;
+  for (size_t i = 0; i < _levels.size(); i++) {
+    if (_levels[i] + 1 > n) {
+      n = _levels[i] + 1;
+    }
+  }
+  return n;
+}
+
+void
+CommitDepGraph::getLevels(vector<vector<PrioNode *> >& levels) const
+{
+  levels.clear();
+  levels.resize(numLevels());
+  for (size_t i = 0; i < _nodes.size(); i++) {
+    levels[_levels[i]].push_back(_nodes[i]);
+  }
+}
+
+const char *
+CommitDepGraph::edgeTypeName(EdgeType t)
+{
+  switch (t) {
+  case EDGE_PRIORITY:
+    return "priority";
+  case EDGE_VARREF:
+    return "varref";
+  case EDGE_HINT:
+    return "hint";
+  }
+  return "";
+}
+
+void
+CommitDepGraph::writeDot(FILE *out) const
+{
+  fprintf(out, "digraph commit {\n");
+  for (size_t i = 0; i < _nodes.size(); i++) {
+    fprintf(out, "  n%zu [label=\"", i);
+    _write_escaped(out, _nodes[i]->getCommitPath().to_string());
+    fprintf(out, "\\n%u %s L%zu\"];\n", _nodes[i]->getPriority(),
+            _commit_state_name(_nodes[i]->getCommitState()), _levels[i]);
+  }
+  for (size_t i = 0; i < _edges.size(); i++) {
+    const Edge& e = _edges[i];
+    fprintf(out, "  n%zu -> n%zu [label=\"%s\"%s%s];\n", e.from, e.to,
+            edgeTypeName(e.type),
+            ((e.type == EDGE_PRIORITY) ? "" : ", style=dashed"),
+            (e.inverted ? ", color=red" : ""));
+  }
+  fprintf(out, "}\n");
+}
+
+void
+CommitDepGraph::writeJson(FILE *out) const
+{
+  fprintf(out, "{\"nodes\": [");
+  for (size_t i = 0; i < _nodes.size(); i++) {
+    fprintf(out, "%s\n  {\"id\": %zu, \"path\": \"", (i > 0 ? "," : ""), i);
+    _write_escaped(out, _nodes[i]->getCommitPath().to_string());
+    fprintf(out, "\", \"priority\": %u, \"state\": \"%s\", \"level\": %zu}",
+            _nodes[i]->getPriority(),
+            _commit_state_name(_nodes[i]->getCommitState()), _levels[i]);
+  }
+  fprintf(out, "],\n \"edges\": [");
+  for (size_t i = 0; i < _edges.size(); i++) {
+    const Edge& e = _edges[i];
+    fprintf(out, "%s\n  {\"from\": %zu, \"to\": %zu, \"type\": \"%s\", "
+            "\"inverted\": %s}", (i > 0 ? "," : ""), e.from, e.to,
+            edgeTypeName(e.type), (e.inverted ? "true" : "false"));
+  }
+  fprintf(out, "]}\n");
+}
+
+/* add an edge meaning "from" must be committed before "to". the edge is
+ * marked inverted if the commit order is the other way around.
+ */
+void
+CommitDepGraph::_add_edge(size_t from, size_t to, EdgeType type)
+{
+  if (from == to) {
+    return;
+  }
+  Edge e;
+  e.from = from;
+  e.to = to;
+  e.type = type;
+  e.inverted = (to < from);
+  unsigned long long key = (static_cast<unsigned long long>(e.from)
+                            * _nodes.size() + e.to);
+  if (_edge_added.find(key) != _edge_added.end()) {
+    return;
+  }
+  _edge_added[key] = true;
+  _edges.push_back(e);
+  if (e.inverted) {
+    ++_num_inverted;
+  }
+}
+
+/* add the dependency of subtree idx on subtree ref_idx. the referenced
+ * subtree goes first, unless idx is being deleted: then the reference
+ * must go away before what it refers to.
+ */
+void
+CommitDepGraph::_add_dep_edge(size_t idx, size_t ref_idx, EdgeType type)
+{
+  if (idx < _num_del) {
+    _add_edge(idx, ref_idx, type);
+  } else {
+    _add_edge(ref_idx, idx, type);
+  }
+}
+
+/* add the dependencies of the cfg node and its descendants, which all
+ * belong to the priority subtree idx.
+ */
+void
+CommitDepGraph::_add_cfg_node_deps(Cstore& cs, size_t idx, CfgNode& node)
+{
+  // "tag nodes" are not acted on by commit, only their values
+  tr1::shared_ptr<Ctemplate> tmpl = node.getTmpl();
+  if (tmpl.get() && !node.isTagNode()) {
+    tr1::shared_ptr<TmplRefsT> refs = _get_tmpl_refs(tmpl);
+    if (refs->var_refs.size() > 0 || refs->hints.size() > 0) {
+      Cpath path;
+      string at_str;
+      _get_node_action_path(node, path, at_str);
+      bool active = (node.getCommitState() == COMMIT_STATE_DELETED);
+      vector<Cpath> rpaths;
+      for (size_t i = 0; i < refs->var_refs.size(); i++) {
+        cs.getVarRefPaths(at_str.c_str(), path, refs->var_refs[i].c_str(),
+                          active, rpaths);
+        for (size_t j = 0; j < rpaths.size(); j++) {
+          _add_ref_deps(idx, rpaths[j], false, EDGE_VARREF);
+        }
+      }
+      for (size_t i = 0; i < refs->hints.size(); i++) {
+        cs.getVarRefPaths(at_str.c_str(), path, refs->hints[i].c_str(),
+                          active, rpaths);
+        for (size_t j = 0; j < rpaths.size(); j++) {
+          _add_ref_deps(idx, rpaths[j], true, EDGE_HINT);
+        }
+      }
+    }
+  }
+
+  for (size_t i = 0; i < node.numChildNodes(); i++) {
+    _add_cfg_node_deps(cs, idx, *(node.childAt(i)));
+  }
+}
+
+/* add dependency of subtree idx on the priority subtree containing ref.
+ * if subtree, also on all priority subtrees below ref.
+ */
+void
+CommitDepGraph::_add_ref_deps(size_t idx, const Cpath& ref, bool subtree,
+                              EdgeType type)
+{
+  // find the closest priority subtree containing ref
+  Cpath p(ref);
+  MapT<Cpath, size_t, CpathHash>::iterator it;
+  while ((it = _path_idx.find(p)) == _path_idx.end()) {
+    if (p.size() == 0) {
+      // not in the commit at all
+      return;
+    }
+    p.pop();
+  }
+  _add_dep_edge(idx, it->second, type);
+  if (subtree) {
+    _add_subtree_deps(idx, _nodes[it->second], ref, type);
+  }
+}
+
+void
+CommitDepGraph::_add_subtree_deps(size_t idx, PrioNode *pnode,
+                                  const Cpath& ref, EdgeType type)
+{
+  for (size_t i = 0; i < pnode->numChildNodes(); i++) {
+    PrioNode *cn = pnode->childAt(i);
+    if (!_is_path_prefix(ref, cn->getCommitPath())) {
+      continue;
+    }
+    MapT<Cpath, size_t, CpathHash>::iterator it
+      = _path_idx.find(cn->getCommitPath());
+    if (it != _path_idx.end()) {
+      _add_dep_edge(idx, it->second, type);
+    }
+    _add_subtree_deps(idx, cn, ref, type);
+  }
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2011 Vyatta, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _COMMIT_DEPS_HPP_
+#define _COMMIT_DEPS_HPP_
+#include <cstdio>
+#include <vector>
+
+#include <cstore/util.hpp>
+#include <cstore/cpath.hpp>
+#include <commit/commit-algorithm.hpp>
+
+namespace commit {
+
+/* dependencies between the priority subtrees of a commit. the nodes are
+ * the PrioNodes in the order they are committed (i.e., the delete queue
+ * followed by the priority queue), and an edge (from, to) means "from"
+ * must be committed before "to". edges come from:
+ *   - the hierarchical constraint between a priority subtree and its
+ *     parent in the priority tree,
+ *   - $VAR() references in the actions (including syntax) of the nodes
+ *     in a subtree that resolve to a node in another subtree,
+ *   - "depends:" hints in the templates. each hint is a var ref (same
+ *     syntax as inside $VAR()) and the subtree depends on the whole
+ *     subtree(s) it refers to.
+ *
+ * a referenced subtree must be committed before the subtree referring to
+ * it, except when the latter is being deleted, in which case it must go
+ * first. priority edges always follow the commit order, but ref edges
+ * can go against it when the priorities are wrong. such edges are kept in
+ * their real direction and marked "inverted".
+ *
+ * subtrees in the same "level" have no dependencies among them. the
+ * levels keep the current order of dependent subtrees (even for inverted
+ * edges), so committing level by level gives the same results as the
+ * current order as far as the dependencies above are concerned.
+ */
+class CommitDepGraph {
+public:
+  enum EdgeType {
+    EDGE_PRIORITY,
+    EDGE_VARREF,
+    EDGE_HINT
+  };
+
+  struct Edge {
+    size_t from;
+    size_t to;
+    EdgeType type;
+    bool inverted;   // "to" is committed before "from"
+  };
+
+  // queues are copied so that the caller's queues are not consumed
+  CommitDepGraph(Cstore& cs, PrioQueueT pq, DelPrioQueueT dpq);
+  ~CommitDepGraph() {}
+
+  size_t numNodes() const { return _nodes.size(); }
+  PrioNode *nodeAt(size_t i) const { return _nodes[i]; }
+  size_t numEdges() const { return _edges.size(); }
+  const Edge& edgeAt(size_t i) const { return _edges[i]; }
+  size_t numInvertedEdges() const { return _num_inverted; }
+  size_t levelOf(size_t i) const { return _levels[i]; }
+  size_t numLevels() const;
+  /* nodes grouped by level. nodes in level i only depend on nodes in
+   * levels before i, and each level is in commit order.
+   */
+  void getLevels(std::vector<std::vector<PrioNode *> >& levels) const;
+
+  void writeDot(FILE *out) const;
+  void writeJson(FILE *out) const;
+
+  static const char *edgeTypeName(EdgeType t);
+
+private:
+  std::vector<PrioNode *> _nodes;
+  std::vector<Edge> _edges;
+  std::vector<size_t> _levels;
+  size_t _num_inverted;
+  size_t _num_del;
+  MapT<Cpath, size_t, CpathHash> _path_idx;
+  MapT<unsigned long long, bool> _edge_added;
+
+  void _add_edge(size_t from, size_t to, EdgeType type);
+  void _add_dep_edge(size_t idx, size_t ref_idx, EdgeType type);
+  void _add_cfg_node_deps(Cstore& cs, size_t idx, CfgNode& node);
+  void _add_ref_deps(size_t idx, const Cpath& ref, bool subtree,
+                     EdgeType type);
+  void _add_subtree_deps(size_t idx, PrioNode *pnode, const Cpath& ref,
+                         EdgeType type);
+};
+
+} // namespace commit
+
+#endif /* _COMMIT_DEPS_HPP_ */
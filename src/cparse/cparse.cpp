@@ -0,0 +1,503 @@
+/*
+ * Copyright (C) 2010 Vyatta, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <string>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstore/cstore.hpp>
+#include <cnode/cnode.hpp>
+#include <cparse/cparse.hpp>
+
+using namespace std;
+using namespace cstore;
+using namespace cnode;
+
+/* config file parser. this is a hand-written replacement of the original
+ * flex scanner and bison grammar, which had all their state in globals.
+ * the scanner below follows the original lexer rules exactly (including
+ * the longest-match and rule-order semantics of flex), and the parser
+ * accepts the same grammar:
+ *
+ *   input:  forest comment
+ *   forest: (empty) | forest tree
+ *   tree:   node | node LEFTB forest comment RIGHTB
+ *   node:   nodec | nodec VALUE
+ *   nodec:  NODE | COMMENT comment NODE
+ *   comment: (empty) | COMMENT comment
+ *
+ * so that the same tree is built and a syntax error is reported at the
+ * same token with the same message as before.
+ *
+ * the whole file is scanned in place (the file is mmap'ed), and a node is
+ * looked up by the id of its parent path and its own name instead of by
+ * its full path.
+ */
+
+namespace {
+
+enum {
+  T_END = 0,
+  T_NODE,
+  T_VALUE,
+  T_COMMENT,
+  T_LEFTB,
+  T_RIGHTB,
+  T_SYNTAX_ERROR
+};
+
+// lexer start conditions
+enum {
+  S_INITIAL,
+  S_COMMENT,
+  S_ID,
+  S_VALUE,
+  S_QSTR
+};
+
+// a path is identified by the id of its parent path and its last component
+struct PathKey {
+  size_t pid;
+  string comp;
+  PathKey(size_t p, const char *c) : pid(p), comp(c) {}
+  bool operator==(const PathKey& rhs) const {
+    return (pid == rhs.pid && comp == rhs.comp);
+  }
+};
+
+struct PathKeyHash {
+  size_t operator()(const PathKey& k) const {
+    return (std::tr1::hash<string>()(k.comp)
+            ^ (k.pid * 0x9e3779b97f4a7c15ULL));
+  }
+};
+
+struct PathEntry {
+  size_t id;
+  CfgNode *node; // node for the path (NULL if none yet)
+  PathEntry() : id(0), node(NULL) {}
+};
+
+class Parser {
+public:
+  Parser(const char *buf, size_t len, Cstore& cs)
+    : _p(buf), _end(buf + len), _cond(S_INITIAL), _lineno(1),
+      _node_deact(false), _tok_deact(false), _cs(&cs), _ndeact(false),
+      _has_comment(false), _has_val(false), _next_id(1), _cur_pid(0),
+      _cur_node(NULL), _cur_parent(NULL) {}
+
+  CfgNode *parse();
+
+private:
+  struct Frame {
+    CfgNode *parent;
+    size_t pid;
+    bool has_val;
+  };
+
+  int lex();
+  static bool is_space(char c) {
+    // [[:space:]] without '\n'
+    return (c == ' ' || c == '\t' || c == '\v' || c == '\f' || c == '\r');
+  }
+  static bool is_id(char c) {
+    // [-[:alnum:]_]
+    return ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+            || (c >= '0' && c <= '9') || c == '-' || c == '_');
+  }
+  int token(int tok, const char *text, size_t tlen) {
+    _text.assign(text, tlen);
+    return tok;
+  }
+
+  PathEntry& path_entry(size_t pid, const char *comp);
+  void add_node();
+  void go_down();
+  void go_up();
+
+  // scanner state
+  const char *_p;
+  const char *_end;
+  int _cond;
+  int _lineno;
+  bool _node_deact;
+  string _sbuf; // comment or quoted string being scanned
+  // last token
+  string _str;
+  string _text;
+  bool _tok_deact;
+
+  // parser state
+  Cstore *_cs;
+  bool _ndeact;
+  bool _has_comment;
+  string _ncomment;
+  string _nname;
+  bool _has_val;
+  string _nval;
+
+  MapT<PathKey, PathEntry, PathKeyHash> _paths;
+  size_t _next_id;
+  size_t _cur_pid;
+  Cpath _pcomps;
+  vector<Frame> _stack;
+  CfgNode *_cur_node;
+  CfgNode *_cur_parent;
+};
+
+/* return the next token. the token text (for error messages) is left in
+ * _text and the string value of NODE/VALUE/COMMENT in _str.
+ */
+int
+Parser::lex()
+{
+  while (_p < _end) {
+    const char *s = _p;
+    char c = *s;
+    switch (_cond) {
+    case S_INITIAL:
+      if (c == '/' && s + 1 < _end && s[1] == '*') {
+        _p += 2;
+        _sbuf.clear();
+        _cond = S_COMMENT;
+      } else if (c == '!') {
+        ++_p;
+        _node_deact = true;
+      } else if (is_space(c)) {
+        for (++_p; _p < _end && is_space(*_p); ++_p);
+      } else if (c == '\n') {
+        ++_p;
+        ++_lineno;
+      } else if (c == '}') {
+        ++_p;
+        _node_deact = false;
+        return token(T_RIGHTB, s, 1);
+      } else if (is_id(c)) {
+        for (++_p; _p < _end && is_id(*_p); ++_p);
+        _str.assign(s, _p - s);
+        _tok_deact = _node_deact;
+        _node_deact = false;
+        _cond = S_ID;
+        return token(T_NODE, s, _p - s);
+      } else {
+        ++_p;
+        return token(T_SYNTAX_ERROR, s, 1);
+      }
+      break;
+    case S_COMMENT:
+      if (c == '*') {
+        if (s + 1 == _end) {
+          ++_p;
+          return token(T_SYNTAX_ERROR, s, 1);
+        }
+        _p += 2;
+        if (s[1] == '/') {
+          // strip one leading and one trailing space
+          size_t b = 0, e = _sbuf.size();
+          if (e > 0 && _sbuf[e - 1] == ' ') {
+            --e;
+          }
+          if (e > 0 && _sbuf[0] == ' ') {
+            b = 1;
+          }
+          _str.assign(_sbuf, b, e - b);
+          _cond = S_INITIAL;
+          return token(T_COMMENT, s, 2);
+        }
+        // note: a '\n' here does not count as a new line (same as before)
+        _sbuf.append(s, 2);
+      } else if (c == '\n') {
+        ++_p;
+        ++_lineno;
+        _sbuf += c;
+      } else {
+        for (++_p; _p < _end && *_p != '*' && *_p != '\n'; ++_p);
+        _sbuf.append(s, _p - s);
+      }
+      break;
+    case S_ID:
+      if (c == ':' || is_space(c)) {
+        const char *q = s + (c == ':' ? 1 : 0);
+        size_t n = 0;
+        for (; q < _end && is_space(*q); ++q, ++n);
+        if (n > 0 && ((q < _end && *q != '{' && *q != '\n') || n > 1)) {
+          // value follows
+          _p = q;
+          _cond = S_VALUE;
+        } else if (c == ':') {
+          ++_p;
+          return token(T_SYNTAX_ERROR, s, 1);
+        } else {
+          _p = q;
+        }
+      } else if (c == '{') {
+        ++_p;
+        _cond = S_INITIAL;
+        return token(T_LEFTB, s, 1);
+      } else if (c == '\n') {
+        ++_p;
+        ++_lineno;
+        _cond = S_INITIAL;
+      } else {
+        ++_p;
+        return token(T_SYNTAX_ERROR, s, 1);
+      }
+      break;
+    case S_VALUE:
+      if (is_space(c)) {
+        for (++_p; _p < _end && is_space(*_p); ++_p);
+      } else if (c == '"') {
+        ++_p;
+        _sbuf.clear();
+        _cond = S_QSTR;
+      } else if (c == '{') {
+        ++_p;
+        _cond = S_INITIAL;
+        return token(T_LEFTB, s, 1);
+      } else if (c == '\n') {
+        ++_p;
+        ++_lineno;
+        _cond = S_INITIAL;
+      } else {
+        for (++_p; _p < _end && *_p != '{' && *_p != '\n' && !is_space(*_p);
+             ++_p);
+        _str.assign(s, _p - s);
+        return token(T_VALUE, s, _p - s);
+      }
+      break;
+    case S_QSTR:
+      if (c == '"') {
+        ++_p;
+        _str = _sbuf;
+        _cond = S_VALUE;
+        return token(T_VALUE, s, 1);
+      } else if (c == '\\') {
+        if (s + 1 == _end || s[1] == '\n') {
+          ++_p;
+          return token(T_SYNTAX_ERROR, s, 1);
+        }
+        // escape sequences are kept as is
+        _p += 2;
+        _sbuf.append(s, 2);
+      } else if (c == '\n') {
+        ++_p;
+        ++_lineno;
+        _sbuf += c;
+      } else {
+        for (++_p; _p < _end && *_p != '"' && *_p != '\\' && *_p != '\n';
+             ++_p);
+        _sbuf.append(s, _p - s);
+      }
+      break;
+    }
+  }
+  return token(T_END, "", 0);
+}
+
+// entry for the path with the specified parent path id and last component
+PathEntry&
+Parser::path_entry(size_t pid, const char *comp)
+{
+  PathEntry& e = _paths[PathKey(pid, comp)];
+  if (e.id == 0) {
+    e.id = _next_id++;
+  }
+  return e;
+}
+
+void
+Parser::add_node()
+{
+  char *nname = const_cast<char *>(_nname.c_str());
+  char *nval = (_has_val ? const_cast<char *>(_nval.c_str()) : NULL);
+  char *ncomment = (_has_comment ? const_cast<char *>(_ncomment.c_str())
+                                 : NULL);
+  PathEntry& e = path_entry(_cur_pid, nname);
+  CfgNode *onode = e.node;
+  if (onode) {
+    if (nval) {
+      if (onode->isMulti()) {
+        // a new value for a "multi node"
+        onode->addMultiValue(nval);
+        _cur_node = onode;
+      } else if (onode->isTag()) {
+        // a new value for a "tag node"
+        _cur_node = new CfgNode(_pcomps, nname, nval, ncomment, _ndeact, _cs);
+        onode->addChildNode(_cur_node);
+      } else {
+        /* a new value for a single-value node => invalid?
+         * for now, use the newer value.
+         */
+        _cur_node = onode;
+        _cur_node->setValue(nval);
+      }
+    } else {
+      // existing intermediate node => move current node pointer
+      _cur_node = onode;
+    }
+  } else {
+    // new node
+    _cur_node = new CfgNode(_pcomps, nname, nval, ncomment, _ndeact, _cs);
+    CfgNode *mapped_node = _cur_node;
+    if (_cur_node->isTag() && _cur_node->isValue()) {
+      // tag value => need to add the "tag node" on top
+      // (need to force "tag" if the node is invalid => tag_if_invalid)
+      CfgNode *p = new CfgNode(_pcomps, nname, NULL, NULL, _ndeact, _cs,
+                               true);
+      p->addChildNode(_cur_node);
+      mapped_node = p;
+    }
+    _cur_parent->addChildNode(mapped_node);
+    e.node = mapped_node;
+  }
+}
+
+void
+Parser::go_down()
+{
+  Frame f = { _cur_parent, _cur_pid, _has_val };
+  _stack.push_back(f);
+  _cur_parent = _cur_node;
+
+  _pcomps.push(_nname);
+  _cur_pid = path_entry(_cur_pid, _nname.c_str()).id;
+  if (_has_val) {
+    _pcomps.push(_nval);
+    _cur_pid = path_entry(_cur_pid, _nval.c_str()).id;
+  }
+}
+
+void
+Parser::go_up()
+{
+  const Frame& f = _stack.back();
+  _cur_parent = f.parent;
+  _cur_pid = f.pid;
+  if (f.has_val) {
+    _pcomps.pop();
+  }
+  _pcomps.pop();
+  _stack.pop_back();
+}
+
+CfgNode *
+Parser::parse()
+{
+  _cur_parent = new CfgNode(_pcomps, NULL, NULL, NULL, 0, _cs);
+  int tok = lex();
+  while (true) {
+    if (tok == T_NODE || tok == T_COMMENT) {
+      _has_comment = false;
+      if (tok == T_COMMENT) {
+        // only the first comment is attached to the node
+        _has_comment = true;
+        _ncomment = _str;
+        while ((tok = lex()) == T_COMMENT);
+      }
+      if (tok == T_NODE) {
+        _nname = _str;
+        _ndeact = _tok_deact;
+        _has_val = false;
+        if ((tok = lex()) == T_VALUE) {
+          _has_val = true;
+          _nval = _str;
+          tok = lex();
+        }
+        add_node();
+        if (tok == T_LEFTB) {
+          go_down();
+          tok = lex();
+        }
+        continue;
+      }
+      // otherwise comments at the end of a forest
+    }
+    if (tok == T_RIGHTB && _stack.size() > 0) {
+      go_up();
+      tok = lex();
+      continue;
+    }
+    if (tok == T_END && _stack.size() == 0) {
+      return _cur_parent;
+    }
+    break;
+  }
+
+  printf("Invalid config file (%s): error at line %d, text [%s]\n",
+         "syntax error", _lineno, _text.c_str());
+  // free the partial tree
+  while (_stack.size() > 0) {
+    _cur_parent = _stack.back().parent;
+    _stack.pop_back();
+  }
+  delete _cur_parent;
+  return NULL;
+}
+
+} // end anonymous namespace
+
+CfgNode *
+cparse::parse_file(FILE *fin, Cstore& cs)
+{
+  string buf;
+  char rbuf[65536];
+  size_t n;
+  while ((n = fread(rbuf, 1, sizeof(rbuf), fin)) > 0) {
+    buf.append(rbuf, n);
+  }
+  Parser p(buf.data(), buf.size(), cs);
+  return p.parse();
+}
+
+CfgNode *
+cparse::parse_file(const char *fname, Cstore& cs)
+{
+  int fd = open(fname, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return NULL;
+  }
+  if (!S_ISREG(st.st_mode) || st.st_size == 0) {
+    // not mmap-able
+    FILE *fin = fdopen(fd, "r");
+    if (!fin) {
+      close(fd);
+      return NULL;
+    }
+    CfgNode *ret = parse_file(fin, cs);
+    fclose(fin);
+    return ret;
+  }
+  void *buf = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (buf == MAP_FAILED) {
+    return NULL;
+  }
+  Parser p(static_cast<const char *>(buf), st.st_size, cs);
+  CfgNode *ret = p.parse();
+  munmap(buf, st.st_size);
+  return ret;
+}
@@ -16,41 +16,85 @@
 
 #ifndef _CPATH_HPP_
 #define _CPATH_HPP_
+#include <cstring>
 #include <string>
 #include <vector>
-
-#include <cstore/svector.hpp>
+#include <algorithm>
+#include <new>
 
 namespace cstore { // begin namespace cstore
 
+/* config path. the components are kept in a single reference-counted
+ * block that is shared between copies (copy-on-write), so copying a path
+ * (e.g., into every CfgNode, or returning one by value) is just a
+ * reference count increment. the block also stores the hash of every
+ * prefix, so hash() is constant time and pop() does not invalidate it.
+ * in the absence of move semantics, swap() can be used to hand a path
+ * over without touching the reference count.
+ *
+ * note: pointers returned by operator[] and back() remain valid until
+ *       the path is modified or destroyed.
+ */
 class Cpath {
 public:
-  Cpath() : _data() {};
-  Cpath(const Cpath& p) : _data() { operator=(p); };
-  Cpath(const char *comps[], size_t num_comps) : _data() {
+  Cpath() : _rep(0) {};
+  Cpath(const Cpath& p) : _rep(p._rep) { ref(); };
+  Cpath(const char *comps[], size_t num_comps) : _rep(0) {
     for (size_t i = 0; i < num_comps; i++) {
       push(comps[i]);
     }
   };
-  Cpath(const std::vector<std::string>& comps) : _data() {
+  Cpath(const std::vector<std::string>& comps) : _rep(0) {
+    size_t dlen = 0;
+    for (size_t i = 0; i < comps.size(); i++) {
+      dlen += comps[i].size() + 1;
+    }
+    reserve(comps.size(), dlen);
     for (size_t i = 0; i < comps.size(); i++) {
       push(comps[i]);
     }
   };
-  ~Cpath() {};
+  ~Cpath() { unref(); };
 
-  void push(const char *comp) { _data.push_back(comp); };
-  void push(const std::string& comp) { _data.push_back(comp.c_str()); };
-  void pop() { _data.pop_back(); };
-  void pop(std::string& last) { _data.pop_back(last); };
-  void clear() { _data.assign("", 0); };
+  void push(const char *comp) { push(comp, strlen(comp)); };
+  void push(const std::string& comp) { push(comp.c_str()); };
+  void pop() {
+    if (size() == 0) {
+      return;
+    }
+    reserve(0, 0);
+    --_rep->num;
+    _rep->len = _rep->elems()[_rep->num].off;
+    _rep->data()[_rep->len] = 0;
+  };
+  void pop(std::string& last) {
+    if (size() == 0) {
+      return;
+    }
+    last = back();
+    pop();
+  };
+  void clear() {
+    unref();
+    _rep = 0;
+  };
+  void swap(Cpath& p) { std::swap(_rep, p._rep); };
 
   Cpath& operator=(const Cpath& p) {
-    _data = p._data;
+    if (_rep != p._rep) {
+      p.ref();
+      unref();
+      _rep = p._rep;
+    }
     return *this;
   };
   Cpath& operator/=(const Cpath& p) {
-    _data /= p._data;
+    // hold a reference so that "p /= p" works
+    Cpath rhs(p);
+    reserve(rhs.size(), rhs.length());
+    for (size_t i = 0; i < rhs.size(); i++) {
+      push(rhs[i], rhs.comp_len(i));
+    }
     return *this;
   }
   Cpath operator/(const Cpath& rhs) {
@@ -60,27 +104,153 @@ public:
   };
 
   bool operator==(const Cpath& rhs) const {
-    return (_data == rhs._data);
+    if (_rep == rhs._rep) {
+      return true;
+    }
+    return (size() == rhs.size() && length() == rhs.length()
+            && hash() == rhs.hash()
+            && (length() == 0
+                || memcmp(_rep->data(), rhs._rep->data(), length()) == 0));
   };
   const char *operator[](size_t idx) const {
-    return _data[idx];
+    return (idx < size() ? (_rep->data() + _rep->elems()[idx].off + 1)
+                         : NULL);
   };
 
-  size_t size() const { return _data.size(); };
-  size_t hash() const { return _data.hash(); };
+  size_t size() const { return (_rep ? _rep->num : 0); };
+  size_t hash() const {
+    if (!_rep) {
+      return HASH_BASIS;
+    }
+    return _rep->elems()[_rep->num].hash;
+  };
   const char *back() const {
-    return (size() > 0 ? _data[size() - 1] : NULL);
+    return (size() > 0 ? operator[](size() - 1) : NULL);
+  };
+  std::string to_string() const {
+    std::string ret;
+    for (size_t i = 0; i < size(); i++) {
+      if (i > 0) {
+        ret += " ";
+      }
+      ret.append(operator[](i), comp_len(i));
+    }
+    return ret;
   };
-  std::string to_string() const { return _data.to_string(); };
 
 private:
-  struct CpathParams {
-    static const char separator = 0;
-    static const size_t static_num_elems = 24;
-    static const size_t static_buf_len = 256;
+  static const char SEP = 0;
+  static const size_t HASH_BASIS = (sizeof(size_t) == 8
+                                    ? static_cast<size_t>(14695981039346656037ULL)
+                                    : static_cast<size_t>(2166136261UL));
+  static const size_t HASH_PRIME = (sizeof(size_t) == 8
+                                    ? static_cast<size_t>(1099511628211ULL)
+                                    : static_cast<size_t>(16777619UL));
+
+  // per-component entry. entry "num" marks the end of the path.
+  struct Elem {
+    size_t hash;      // hash of the path before this component
+    unsigned int off; // offset of the separator before this component
+  };
+
+  /* header of the shared block. it is followed by (ecap + 1) Elem
+   * entries and then cap bytes of data holding the components, each
+   * preceded by SEP, followed by a terminating 0.
+   */
+  struct Rep {
+    long refs;
+    unsigned int num;
+    unsigned int ecap;
+    unsigned int len;
+    unsigned int cap;
+
+    Elem *elems() { return reinterpret_cast<Elem *>(this + 1); };
+    char *data() { return reinterpret_cast<char *>(elems() + ecap + 1); };
   };
 
-  cstore::svector<CpathParams> _data;
+  Rep *_rep;
+
+  size_t length() const { return (_rep ? _rep->len : 0); };
+  size_t comp_len(size_t idx) const {
+    Elem *e = _rep->elems();
+    return (e[idx + 1].off - e[idx].off - 1);
+  };
+
+  void ref() const {
+    if (_rep) {
+      __sync_add_and_fetch(&_rep->refs, 1);
+    }
+  };
+  void unref() {
+    if (_rep && __sync_sub_and_fetch(&_rep->refs, 1) == 0) {
+      ::operator delete(_rep);
+    }
+  };
+
+  static size_t hash_bytes(size_t h, const char *s, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+      h ^= static_cast<unsigned char>(s[i]);
+      h *= HASH_PRIME;
+    }
+    return h;
+  };
+
+  static Rep *alloc(size_t ecap, size_t cap) {
+    Rep *r = static_cast<Rep *>(::operator new(sizeof(Rep)
+                                               + sizeof(Elem) * (ecap + 1)
+                                               + cap));
+    r->refs = 1;
+    r->num = 0;
+    r->ecap = ecap;
+    r->len = 0;
+    r->cap = cap;
+    r->elems()[0].hash = HASH_BASIS;
+    r->elems()[0].off = 0;
+    r->data()[0] = 0;
+    return r;
+  };
+
+  /* make sure this path owns its block and has room for "ne" more
+   * components and "dl" more bytes of data.
+   */
+  void reserve(size_t ne, size_t dl) {
+    size_t nnum = size() + ne;
+    size_t nlen = length() + dl;
+    bool own = (_rep && _rep->refs == 1);
+    if (own && _rep->ecap >= nnum && _rep->cap > nlen) {
+      return;
+    }
+    size_t ecap = nnum, cap = nlen + 1;
+    if (own) {
+      // growing in place, leave room for more
+      ecap = std::max(ecap, static_cast<size_t>(_rep->ecap) * 2);
+      cap = std::max(cap, static_cast<size_t>(_rep->cap) * 2);
+    }
+    Rep *n = alloc((ecap < 4 ? 4 : ecap), (cap < 32 ? 32 : cap));
+    if (_rep) {
+      n->num = _rep->num;
+      n->len = _rep->len;
+      memcpy(n->elems(), _rep->elems(), sizeof(Elem) * (_rep->num + 1));
+      memcpy(n->data(), _rep->data(), _rep->len + 1);
+    }
+    unref();
+    _rep = n;
+  };
+
+  void push(const char *comp, size_t clen) {
+    reserve(1, clen + 1);
+    Elem *e = _rep->elems();
+    char *d = _rep->data();
+    unsigned int n = _rep->num;
+    unsigned int off = _rep->len;
+    d[off] = SEP;
+    memcpy(d + off + 1, comp, clen);
+    d[off + 1 + clen] = 0;
+    e[n + 1].off = off + 1 + clen;
+    e[n + 1].hash = hash_bytes(e[n].hash, d + off, clen + 1);
+    _rep->num = n + 1;
+    _rep->len = off + 1 + clen;
+  };
 };
 
 struct CpathHash {
@@ -92,4 +262,3 @@ struct CpathHash {
 } // end namespace cstore
 
 #endif /* _CPATH_HPP_ */
-
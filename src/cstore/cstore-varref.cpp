@@ -311,3 +311,22 @@ Cstore::VarRef::getSetPath(Cpath& path_comps)
   return true;
 }
 
+
+/* get the paths of the nodes referenced, without checking existence. for
+ * a "value" entry, the value is dropped so the path is that of the leaf
+ * node.
+ */
+void
+Cstore::VarRef::getRefPaths(vector<Cpath>& paths)
+{
+  paths.clear();
+  for (size_t i = 0; i < _paths.size(); i++) {
+    Cpath p(_paths[i].first);
+    if (_paths[i].second != ERROR_TYPE && p.size() > 0) {
+      p.pop();
+    }
+    if (p.size() > 0) {
+      paths.push_back(p);
+    }
+  }
+}
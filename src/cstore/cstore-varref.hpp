@@ -31,6 +31,7 @@ public:
 
   bool getValue(string& value, vtw_type_e& def_type);
   bool getSetPath(Cpath& path_comps);
+  void getRefPaths(vector<Cpath>& paths);
 
 private:
   Cstore *_cstore;
@@ -20,7 +20,12 @@
 #include <cstdarg>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/xattr.h>
 #include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
 #include <algorithm>
 #include <sstream>
 #include <memory>
@@ -66,9 +71,17 @@ const string Cstore::C_ENV_SHAPI_COMP_HELP = "_cli_shell_api_comp_help";
 const string Cstore::C_ENV_SHAPI_HELP_ITEMS = "_cli_shell_api_hitems";
 const string Cstore::C_ENV_SHAPI_HELP_STRS = "_cli_shell_api_hstrs";
 
+// template preloading
+const string Cstore::C_ENV_TMPL_PRELOAD = "VYATTA_TMPL_PRELOAD";
+
 //// dirs/files
 const string Cstore::C_ENUM_SCRIPT_DIR = "/opt/vyatta/share/enumeration";
 const string Cstore::C_LOGFILE_STDOUT = "/var/log/vyatta/cfg-stdout.log";
+const string Cstore::C_COMP_CACHE_DIR = "/tmp/.vyatta-comp-cache";
+const string Cstore::C_COMP_CACHE_GEN = ".generation";
+const string Cstore::C_SAVE_VERSION_CMD
+  = "/opt/vyatta/sbin/vyatta_current_conf_ver.pl";
+const string Cstore::C_SAVE_FP_XATTR = "user.vyatta.save-fp";
 
 //// sorting
 const unsigned int Cstore::SORT_DEFAULT = 0;
@@ -92,6 +105,8 @@ MapT<unsigned int, Cstore::SortFuncT> Cstore::_sort_func_map;
  *       this base class.
  */
 Cstore::Cstore(string& env)
+  : _varref_cache_enabled(false), _varref_cache_hits(0),
+    _varref_cache_misses(0)
 {
   init();
 
@@ -205,6 +220,9 @@ Cstore::getParsedTmpl(const Cpath& path_comps, MapT<string, string>& tmap,
   if (def->getValHelp()) {
     tmap["val_help"] = def->getValHelp();
   }
+  if (def->getDepends()) {
+    tmap["depends"] = def->getDepends();
+  }
   return true;
 }
 
@@ -228,6 +246,8 @@ Cstore::tmplGetChildNodes(const Cpath& path_comps,
 bool
 Cstore::_deleteCfgPath(const Cpath& path_comps)
 {
+  varref_cache_flush();
+  invalidateCompletionCache();
   string terr;
   tr1::shared_ptr<Ctemplate> def(get_parsed_tmpl(path_comps, false, terr));
   if (!def.get()) {
@@ -374,6 +394,18 @@ Cstore::validateSetPath(const Cpath& path_comps)
   return _validateSetPath(path_comps);
 }
 
+/* validate the "set" paths in "paths" starting at "start" that share the
+ * same parent as a batch. see validate_set_path_batch().
+ */
+size_t
+Cstore::validateSetPathBatch(const vector<Cpath>& paths, size_t start,
+                             vector<bool>& valid, BatchOutput *bout)
+{
+  ASSERT_IN_SESSION;
+
+  return validate_set_path_batch(paths, start, valid, bout);
+}
+
 /* check if specified "logical path" is valid for "activate" operation
  * return true if valid. otherwise return false.
  */
@@ -568,6 +600,267 @@ Cstore::getEditResetEnv(string& env)
   return _getEditResetEnv(env);
 }
 
+/* completion cache. "enumeration" scripts and "allowed" commands are run
+ * through the shell for every TAB press, and each TAB press is a separate
+ * process, so the output is kept in files in a per-user directory (see
+ * _comp_cache_dir()). an entry is used if it was written in the current
+ * "generation", which is bumped by any config change (see
+ * invalidateCompletionCache()), and it is not older than C_COMP_CACHE_TTL,
+ * which covers system state such as interfaces coming and going as well as
+ * commits by other users.
+ *
+ * the key is the config session plus the command body plus, only if the
+ * body refers to them, the COMP_WORDS/COMP_CWORD setup, so typing more
+ * characters of the current word reuses the same entry for most templates.
+ *
+ * the cached output is eval'ed by the completion code, so the directory
+ * must be private to the user. if it is not (e.g., someone else created it
+ * first), the cache is simply not used.
+ */
+static string
+_comp_cache_dir()
+{
+  char buf[32];
+  snprintf(buf, sizeof(buf), "-%u", (unsigned int) getuid());
+  return (Cstore::C_COMP_CACHE_DIR + buf);
+}
+
+static bool
+_comp_cache_dir_ok(bool create)
+{
+  string dir = _comp_cache_dir();
+  if (create && mkdir(dir.c_str(), 0700) != 0 && errno != EEXIST) {
+    return false;
+  }
+  struct stat st;
+  return (lstat(dir.c_str(), &st) == 0 && S_ISDIR(st.st_mode)
+          && st.st_uid == getuid() && (st.st_mode & 077) == 0);
+}
+
+static string
+_comp_cache_generation(const string& script)
+{
+  ostringstream gen;
+  struct stat st;
+  string gfile = _comp_cache_dir() + "/" + Cstore::C_COMP_CACHE_GEN;
+  if (lstat(gfile.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+    gen << st.st_mtim.tv_sec << "." << st.st_mtim.tv_nsec;
+  } else {
+    gen << "0";
+  }
+  if (script.length() > 0 && stat(script.c_str(), &st) == 0) {
+    // script changes also invalidate
+    gen << ":" << st.st_mtim.tv_sec << "." << st.st_mtim.tv_nsec;
+  }
+  return gen.str();
+}
+
+static string
+_comp_cache_file(const string& key)
+{
+  // FNV-1a
+  unsigned long long h = 14695981039346656037ULL;
+  for (size_t i = 0; i < key.length(); i++) {
+    h ^= (unsigned char) key[i];
+    h *= 1099511628211ULL;
+  }
+  char buf[64];
+  snprintf(buf, sizeof(buf), "/%016llx", h);
+  return (_comp_cache_dir() + buf);
+}
+
+static bool
+_read_fd(int fd, string& data)
+{
+  char buf[4096];
+  ssize_t cnt;
+  while ((cnt = read(fd, buf, sizeof(buf))) != 0) {
+    if (cnt < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data.append(buf, cnt);
+  }
+  return true;
+}
+
+static bool
+_read_whole_file(const string& file, string& data)
+{
+  int fd = open(file.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  bool ret = _read_fd(fd, data);
+  close(fd);
+  return ret;
+}
+
+/* entry format: "<generation>\n<key length>\n<key><output>". the key is
+ * stored so that hash collisions are detected.
+ */
+static bool
+_comp_cache_get(const string& key, const string& gen, string& output)
+{
+  if (!_comp_cache_dir_ok(false)) {
+    return false;
+  }
+  int fd = open(_comp_cache_file(key).c_str(), O_RDONLY | O_NOFOLLOW);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  string data;
+  bool ok = (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)
+             && st.st_uid == getuid()
+             && time(NULL) - st.st_mtime < (time_t) Cstore::C_COMP_CACHE_TTL
+             && time(NULL) >= st.st_mtime
+             && _read_fd(fd, data));
+  close(fd);
+  if (!ok) {
+    return false;
+  }
+  size_t p1 = data.find('\n');
+  if (p1 == data.npos || data.compare(0, p1, gen) != 0) {
+    return false;
+  }
+  size_t p2 = data.find('\n', p1 + 1);
+  if (p2 == data.npos) {
+    return false;
+  }
+  size_t klen = strtoul(data.c_str() + p1 + 1, NULL, 10);
+  if (data.length() - (p2 + 1) < klen
+      || data.compare(p2 + 1, klen, key) != 0) {
+    return false;
+  }
+  output = data.substr(p2 + 1 + klen);
+  return true;
+}
+
+static bool
+_write_fd(int fd, const char *data, size_t len)
+{
+  while (len > 0) {
+    ssize_t cnt = write(fd, data, len);
+    if (cnt < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data += cnt;
+    len -= cnt;
+  }
+  return true;
+}
+
+static void
+_comp_cache_put(const string& key, const string& gen, const string& output)
+{
+  if (!_comp_cache_dir_ok(true)) {
+    return;
+  }
+  string gfile = _comp_cache_dir() + "/" + Cstore::C_COMP_CACHE_GEN;
+  int fd = open(gfile.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW,
+                0600);
+  if (fd >= 0) {
+    /* first use. this starts a new generation, so the output does not
+     * belong to the current one any more.
+     */
+    close(fd);
+    return;
+  }
+
+  string file = _comp_cache_file(key);
+  ostringstream tmp;
+  tmp << file << "." << getpid();
+  fd = open(tmp.str().c_str(), O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW,
+            0600);
+  if (fd < 0) {
+    return;
+  }
+  ostringstream hdr;
+  hdr << gen << "\n" << key.length() << "\n";
+  bool ok = (_write_fd(fd, hdr.str().data(), hdr.str().length())
+             && _write_fd(fd, key.data(), key.length())
+             && _write_fd(fd, output.data(), output.length()));
+  if (close(fd) != 0 || !ok
+      || rename(tmp.str().c_str(), file.c_str()) != 0) {
+    unlink(tmp.str().c_str());
+  }
+}
+
+/* execute specified command and return the complete output, which is read
+ * in chunks so that there is no limit on its size. return the exit status
+ * of the command or -1 if failed.
+ *
+ * NOTE: same as get_shell_command_output(), *DO NOT* use a user-supplied
+ *       string as the command.
+ */
+static int
+_get_shell_command_output(const string& cmd, string& output)
+{
+  FILE *cmd_in = popen(cmd.c_str(), "r");
+  if (!cmd_in) {
+    return -1;
+  }
+  char buf[4096];
+  size_t cnt;
+  while ((cnt = fread(buf, 1, sizeof(buf), cmd_in)) > 0) {
+    output.append(buf, cnt);
+  }
+  bool err = ferror(cmd_in);
+  int status = pclose(cmd_in);
+  if (err || status == -1 || !WIFEXITED(status)) {
+    return -1;
+  }
+  return WEXITSTATUS(status);
+}
+
+/* get the output of an "enumeration" script or an "allowed" command for
+ * completion, from the cache if possible.
+ *   setup: COMP_WORDS/COMP_CWORD setup, must precede body.
+ *   body: the command itself.
+ *   script: the "enumeration" script file if any, whose content decides
+ *           whether the setup is part of the key.
+ * return the time spent running the command in ms (0 if cached).
+ */
+static unsigned long
+_get_completion_output(const string& session, const string& setup,
+                       const string& body, const string& script,
+                       string& output)
+{
+  string key = body;
+  string text = body;
+  if (script.length() > 0) {
+    text.clear();
+    _read_whole_file(script, text);
+  }
+  if (text.find("COMP_") != text.npos) {
+    key = setup + body;
+  }
+  // uncommitted changes of one session must not show up in another
+  key = session + '\0' + key;
+  string gen = _comp_cache_generation(script);
+  if (_comp_cache_get(key, gen, output)) {
+    return 0;
+  }
+
+  struct timespec t0, t1;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  int ret = _get_shell_command_output(setup + body, output);
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  unsigned long msec = ((t1.tv_sec - t0.tv_sec) * 1000
+                        + (t1.tv_nsec - t0.tv_nsec) / 1000000);
+  if (ret == 0) {
+    // only cache successful runs
+    _comp_cache_put(key, gen, output);
+  }
+  return msec;
+}
+
 /* set "env" arg to the environment string needed for "completion".
  * return true if successful.
  *
@@ -654,12 +947,7 @@ Cstore::_getCompletionEnv(const Cpath& comps, string& env)
       // return all template children
       get_all_tmpl_child_node_names(ufvec);
     }
-    for (size_t i = 0; i < ufvec.size(); i++) {
-      if (last_comp == ""
-          || ufvec[i].compare(0, last_comp.length(), last_comp) == 0) {
-        comp_vals.push_back(ufvec[i]);
-      }
-    }
+    filterCompletionPrefix(ufvec, last_comp, comp_vals);
     if (comp_vals.size() == 0) {
       // no matches
       return false;
@@ -714,17 +1002,19 @@ Cstore::_getCompletionEnv(const Cpath& comps, string& env)
        */
       ostringstream cword_count;
       cword_count << (comps.size() - 1);
-      string cmd_str = ("export " + C_ENV_SHELL_CWORD_COUNT + "="
-                         + cword_count.str() + "; ");
-      cmd_str += ("export " + C_ENV_SHELL_CWORDS + "=(");
+      string setup = ("export " + C_ENV_SHELL_CWORD_COUNT + "="
+                      + cword_count.str() + "; ");
+      setup += ("export " + C_ENV_SHELL_CWORDS + "=(");
       for (size_t i = 0; i < comps.size(); i++) {
-        cmd_str += " '";
-        cmd_str += comps[i];
-        cmd_str += "'";
+        setup += " '";
+        setup += comps[i];
+        setup += "'";
       }
-      cmd_str += "); ";
+      setup += "); ";
+      string cmd_str, script;
       if (def->getEnumeration()) {
-        cmd_str += (C_ENUM_SCRIPT_DIR + "/" + def->getEnumeration());
+        script = (C_ENUM_SCRIPT_DIR + "/" + def->getEnumeration());
+        cmd_str = script;
       } else {
         string astr = def->getAllowed();
         shell_escape_squotes(astr);
@@ -733,25 +1023,28 @@ Cstore::_getCompletionEnv(const Cpath& comps, string& env)
         cmd_str += "'; }; _cstore_internal_allowed";
       }
 
-      char *buf = (char *) malloc(MAX_CMD_OUTPUT_SIZE);
-      int ret = get_shell_command_output(cmd_str.c_str(), buf,
-                                         MAX_CMD_OUTPUT_SIZE);
-      if (ret > 0) {
-        // '<' and '>' need to be escaped
-        char *ptr = buf;
-        while (*ptr) {
-          if (*ptr == '<' || *ptr == '>') {
-            comp_string += "\\";
-          }
-          comp_string += *ptr;
-          ptr++;
+      string output;
+      unsigned long msec = _get_completion_output(get_session_key(), setup,
+                                                  cmd_str, script, output);
+      if (msec >= C_COMP_SLOW_MSEC) {
+        output_internal("completion: [%s] took %lu ms (%zu bytes)\n",
+                        (script.empty() ? def->getAllowed() : script.c_str()),
+                        msec, output.length());
+      }
+      // '<' and '>' need to be escaped
+      for (size_t i = 0; i < output.length(); i++) {
+        if (output[i] == '\0') {
+          break;
+        }
+        if (output[i] == '<' || output[i] == '>') {
+          comp_string += "\\";
         }
+        comp_string += output[i];
       }
       /* note that for "enumeration" and "allowed", comp_string is the
        * complete output of the command and it is to be evaled by the
        * shell into an array of values.
        */
-      free(buf);
     } else if (def->getActions(syntax_act)) {
       // look for "self ref in values" from syntax
       const valstruct *vals
@@ -890,6 +1183,68 @@ Cstore::getCompletionEnv(const Cpath& comps, string& env)
   return _getCompletionEnv(comps, env);
 }
 
+/* append values in "vals" that start with "prefix" to "matches", in the
+ * same order. an empty prefix matches everything.
+ */
+void
+Cstore::filterCompletionPrefix(const vector<string>& vals,
+                               const string& prefix, vector<string>& matches)
+{
+  for (size_t i = 0; i < vals.size(); i++) {
+    if (prefix.empty()
+        || vals[i].compare(0, prefix.length(), prefix) == 0) {
+      matches.push_back(vals[i]);
+    }
+  }
+}
+
+/* start a new completion cache "generation" so that cached "enumeration"
+ * and "allowed" output is not used after the config changes.
+ */
+void
+Cstore::invalidateCompletionCache()
+{
+  /* a single syscall that fails if the cache has not been used. the
+   * generation file is created by _comp_cache_put().
+   */
+  string gfile = _comp_cache_dir() + "/" + C_COMP_CACHE_GEN;
+  utimensat(AT_FDCWD, gfile.c_str(), NULL, AT_SYMLINK_NOFOLLOW);
+}
+
+/* parse all templates into the template cache. the result is the same as
+ * parsing them on demand; this just does all the work at once, with the
+ * template tree read by multiple threads.
+ */
+size_t
+Cstore::preloadTemplates(unsigned int nthreads)
+{
+  if (nthreads == 0) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    nthreads = (n > 0 ? n : 1);
+  }
+  struct timespec t0, t1;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  size_t num = tmpl_preload(nthreads);
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  unsigned long msec = ((t1.tv_sec - t0.tv_sec) * 1000
+                        + (t1.tv_nsec - t0.tv_nsec) / 1000000);
+  output_internal("template preload: %zu templates in %lu ms (%u threads)\n",
+                  num, msec, nthreads);
+  return num;
+}
+
+size_t
+Cstore::preloadTemplatesIfEnabled()
+{
+  static bool done = false;
+  const char *val = getenv(C_ENV_TMPL_PRELOAD.c_str());
+  if (done || !val || !val[0]) {
+    return 0;
+  }
+  done = true;
+  return preloadTemplates(strtoul(val, NULL, 10));
+}
+
 /* set specified "logical path" in "working config".
  * return true if successful. otherwise return false.
  * note: assume specified path is valid (i.e., validateSetPath()).
@@ -980,6 +1335,8 @@ Cstore::validateCloneArgs(const Cpath& args)
 bool
 Cstore::_renameCfgPath(const Cpath& args)
 {
+  varref_cache_flush();
+  invalidateCompletionCache();
   const char *otagnode = args[0];
   const char *otagval = args[1];
   const char *ntagval = args[4];
@@ -1014,6 +1371,8 @@ Cstore::renameCfgPath(const Cpath& args)
 bool
 Cstore::_copyCfgPath(const Cpath& args)
 {
+  varref_cache_flush();
+  invalidateCompletionCache();
   const char *otagnode = args[0];
   const char *otagval = args[1];
   const char *ntagval = args[4];
@@ -1041,6 +1400,8 @@ Cstore::copyCfgPath(const Cpath& args)
 bool
 Cstore::_commentCfgPath(const Cpath& args)
 {
+  varref_cache_flush();
+  invalidateCompletionCache();
   /* separate path from comment.
    * follow the original implementation: the last arg is the comment, and
    * everything else is part of the path.
@@ -1133,6 +1494,8 @@ Cstore::commentCfgPath(const Cpath& args)
 bool
 Cstore::_discardChanges()
 {
+  varref_cache_flush();
+  invalidateCompletionCache();
   // just call underlying implementation
   unsigned long long num_removed = 0;
   if (discard_changes(num_removed)) {
@@ -1161,6 +1524,8 @@ Cstore::discardChanges()
 bool
 Cstore::_moveCfgPath(const Cpath& args)
 {
+  varref_cache_flush();
+  invalidateCompletionCache();
   Cpath epath;
   Cpath nargs;
   if (!conv_move_args_for_rename(args, epath, nargs)) {
@@ -1184,6 +1549,8 @@ Cstore::moveCfgPath(const Cpath& args)
 bool
 Cstore::_cloneCfgPath(const Cpath& args)
 {
+  varref_cache_flush();
+  invalidateCompletionCache();
   Cpath epath;
   Cpath nargs;
   if (!conv_move_args_for_rename(args, epath, nargs)) {
@@ -1353,6 +1720,69 @@ Cstore::cfgPathGetDeletedValues(const Cpath& path_comps, vector<string>& dvals)
   _cfgPathGetDeletedValuesDA(path_comps, dvals, false);
 }
 
+/* get the status of the node at the specified path and of every node
+ * below it (in the union of active and working configs) in a single pass
+ * over the two subtrees, instead of individual cfgPathAdded(),
+ * cfgPathDeleted(), cfgPathChanged(), cfgPathEffective(), and
+ * cfgPathDeactivated() calls for each node.
+ *   paths: (output) path of each node relative to the specified path. the
+ *          first one is the specified path itself (i.e., empty) unless it
+ *          is the root.
+ *   status: (output) status of each node, a combination of the
+ *           C_PATH_STATUS_* flags. "added", "deleted", "changed", and
+ *           "effective" are the same as the individual (non-DA) observers.
+ *           "deactivated" is the same as cfgPathDeactivated() on the
+ *           working config.
+ * the result is empty if the path is not valid or does not exist in either
+ * config.
+ */
+void
+Cstore::cfgPathGetSubtreeStatus(const Cpath& path_comps,
+                                vector<Cpath>& paths,
+                                vector<unsigned int>& status)
+{
+  tr1::shared_ptr<const CfgNode> aroot, wroot;
+  cfgPathGetSubtreesWithStatus(path_comps, aroot, wroot, paths, status);
+}
+
+/* same as above but returns a map from the relative path (space-separated
+ * components) to the list of status names (see pathStatusToString()).
+ */
+void
+Cstore::cfgPathGetSubtreeStatus(const Cpath& path_comps,
+                                MapT<string, string>& smap)
+{
+  vector<Cpath> paths;
+  vector<unsigned int> status;
+  cfgPathGetSubtreeStatus(path_comps, paths, status);
+  for (size_t i = 0; i < paths.size(); i++) {
+    smap[paths[i].to_string()] = pathStatusToString(status[i]);
+  }
+}
+
+// comma-separated names of the status flags, or "static" if none
+string
+Cstore::pathStatusToString(unsigned int status)
+{
+  static const unsigned int flags[] = {
+    C_PATH_STATUS_ADDED, C_PATH_STATUS_DELETED, C_PATH_STATUS_CHANGED,
+    C_PATH_STATUS_EFFECTIVE, C_PATH_STATUS_DEACTIVATED, 0
+  };
+  static const char *names[] = {
+    "added", "deleted", "changed", "effective", "deactivated", NULL
+  };
+  string ret;
+  for (size_t i = 0; flags[i]; i++) {
+    if (status & flags[i]) {
+      if (!ret.empty()) {
+        ret += ",";
+      }
+      ret += names[i];
+    }
+  }
+  return (ret.empty() ? C_NODE_STATUS_STATIC : ret);
+}
+
 // same as above but DA
 void
 Cstore::_cfgPathGetDeletedValuesDA(const Cpath& path_comps,
@@ -1699,6 +2129,117 @@ Cstore::cfgPathDefault(const Cpath& path_comps, bool active_cfg)
   return _cfgPathDefault(path_comps, active_cfg);
 }
 
+/* drop deactivated nodes from a tree built by the CfgNode constructor
+ * with the deactivated nodes in it (see _cfgPathGetSubtreesWithStatus()
+ * below), the same as the constructor leaves them out with
+ * skip_deactivated. a tag node that loses all of its tag values this way
+ * is dropped as well.
+ */
+static void
+_prune_deactivated(CfgNode& node)
+{
+  vector<CfgNode *> cnodes = node.getChildNodes();
+  node.detachFromChildren();
+  for (size_t i = 0; i < cnodes.size(); i++) {
+    if (cnodes[i]->isDeactivated()) {
+      delete cnodes[i];
+      continue;
+    }
+    size_t num = cnodes[i]->numChildNodes();
+    _prune_deactivated(*(cnodes[i]));
+    if (cnodes[i]->isTagNode() && num > 0
+        && cnodes[i]->numChildNodes() == 0) {
+      delete cnodes[i];
+      continue;
+    }
+    node.addChildNode(cnodes[i]);
+  }
+}
+
+/* get the whole subtree at specified path in working config or active
+ * config in one pass, instead of walking it with the per-node observers
+ * above (each of which has to set up the paths and look up the template
+ * again).
+ *   max_depth: number of levels below specified path to read. nodes at
+ *              the last level have no child nodes. 0 means no limit.
+ * return the root of the subtree, or NULL if specified path is not valid
+ * or doesn't exist. the tree must not be modified by the caller.
+ *
+ * note: like the other observers here, this is NOT "deactivate-aware",
+ *       i.e., deactivated nodes are not read into the returned tree.
+ */
+tr1::shared_ptr<const CfgNode>
+Cstore::_cfgPathGetSubtree(const Cpath& path_comps, bool active_cfg,
+                           size_t max_depth)
+{
+  Cpath p(path_comps);
+  tr1::shared_ptr<CfgNode> root(new CfgNode(*this, p, active_cfg, true,
+                                            max_depth, true));
+  if (root->isInvalid() || !root->exists()) {
+    return tr1::shared_ptr<const CfgNode>();
+  }
+  return root;
+}
+
+tr1::shared_ptr<const CfgNode>
+Cstore::cfgPathGetSubtree(const Cpath& path_comps, bool active_cfg,
+                          size_t max_depth)
+{
+  if (!active_cfg) {
+    ASSERT_IN_SESSION;
+  }
+
+  return _cfgPathGetSubtree(path_comps, active_cfg, max_depth);
+}
+
+/* same as cfgPathGetSubtreeStatus(), and also return the subtrees of both
+ * configs as cfgPathGetSubtree() does (NULL if not there), from the same read of each
+ * config instead of reading each of them again.
+ */
+void
+Cstore::_cfgPathGetSubtreesWithStatus(const Cpath& path_comps,
+                                      tr1::shared_ptr<const CfgNode>& aroot,
+                                      tr1::shared_ptr<const CfgNode>& wroot,
+                                      vector<Cpath>& paths,
+                                      vector<unsigned int>& status)
+{
+  Cpath p(path_comps);
+  tr1::shared_ptr<CfgNode> atree(new CfgNode(*this, p, true, true));
+  tr1::shared_ptr<CfgNode> wtree(new CfgNode(*this, p, false, true));
+  if (atree->isInvalid() || wtree->isInvalid()) {
+    return;
+  }
+  const CfgNode *anode = (atree->exists() ? atree.get() : NULL);
+  const CfgNode *wnode = (wtree->exists() ? wtree.get() : NULL);
+  if (!anode && !wnode) {
+    return;
+  }
+  Cpath rpath;
+  get_subtree_status(anode, wnode, p, rpath, paths, status);
+
+  // the status needs the deactivated nodes, the subtrees leave them out
+  if (anode) {
+    _prune_deactivated(*atree);
+    aroot = atree;
+  }
+  if (wnode) {
+    _prune_deactivated(*wtree);
+    wroot = wtree;
+  }
+}
+
+void
+Cstore::cfgPathGetSubtreesWithStatus(const Cpath& path_comps,
+                                     tr1::shared_ptr<const CfgNode>& aroot,
+                                     tr1::shared_ptr<const CfgNode>& wroot,
+                                     vector<Cpath>& paths,
+                                     vector<unsigned int>& status)
+{
+  ASSERT_IN_SESSION;
+
+  _cfgPathGetSubtreesWithStatus(path_comps, aroot, wroot, paths, status);
+}
+
 /* the following functions are observers of the "effective" config.
  * they can be used
  *   (1) outside a config session (e.g., op mode, daemons, callbacks, etc.).
@@ -1941,11 +2482,46 @@ Cstore::cfgPathGetEffectiveValues(const Cpath& path_comps,
 char *
 Cstore::getVarRef(const char *ref_str, vtw_type_e& type, bool from_active)
 {
+  string key;
+  if (_varref_cache_enabled) {
+    /* relative refs depend on the current node and refs containing "@"
+     * on the current "at" string. absolute refs are shared by all nodes.
+     */
+    key = (from_active ? "A" : "W");
+    if (ref_str[0] != '/') {
+      key += cfg_path_to_str();
+    }
+    key += '\0';
+    const char *at = (strchr(ref_str, '@') ? get_at_string() : NULL);
+    if (at) {
+      key += at;
+    }
+    key += '\0';
+    key += ref_str;
+    MapT<string, VarRefCacheEntryT>::iterator it = _varref_cache.find(key);
+    if (it != _varref_cache.end()) {
+      ++_varref_cache_hits;
+      if (!it->second.found) {
+        return NULL;
+      }
+      type = it->second.type;
+      return strdup(it->second.value.c_str());
+    }
+    ++_varref_cache_misses;
+  }
+
   auto_ptr<SavePaths> save(create_save_paths());
   VarRef vref(this, ref_str, from_active);
   string val;
-  vtw_type_e t;
-  if (vref.getValue(val, t)) {
+  vtw_type_e t = ERROR_TYPE;
+  bool found = vref.getValue(val, t);
+  if (_varref_cache_enabled) {
+    VarRefCacheEntryT& e = _varref_cache[key];
+    e.found = found;
+    e.type = t;
+    e.value = val;
+  }
+  if (found) {
     type = t;
     // follow original implementation. caller is supposed to free this.
     return strdup(val.c_str());
@@ -1977,6 +2553,8 @@ Cstore::setVarRef(const char *ref_str, const char *value, bool to_active)
    *       that's what the template specifies.
    *     * it only supports only single-value leaf nodes.
    */
+  varref_cache_flush();
+  invalidateCompletionCache();
   auto_ptr<SavePaths> save(create_save_paths());
   VarRef vref(this, ref_str, to_active);
   Cpath pcomps;
@@ -2049,15 +2627,17 @@ Cstore::unmarkCfgPathDeactivated(const Cpath& path_comps)
 bool
 Cstore::_loadFile(const char *filename)
 {
-  FILE *fin = fopen(filename, "r");
-  if (!fin) {
+  if (access(filename, R_OK) != 0) {
     output_user("Failed to open specified config file\n");
     return false;
   }
 
-  // get the config tree from the file
-  CfgNode *froot = cparse::parse_file(fin, *this);
-  if (!froot) {
+  // the whole template tree is visited below
+  preloadTemplatesIfEnabled();
+
+  // get the config tree from the file (mapped instead of copied)
+  auto_ptr<CfgNode> froot(cparse::parse_file(filename, *this));
+  if (!froot.get()) {
     output_user("Failed to parse specified config file\n");
     return false;
   }
@@ -2078,9 +2658,15 @@ Cstore::_loadFile(const char *filename)
       print_path_vec("Delete [", "] failed\n", del_list[i], "'");
     }
   }
-  for (size_t i = 0; i < set_list.size(); i++) {
-    if (!_validateSetPath(set_list[i]) || !set_cfg_path(set_list[i], true)) {
-      print_path_vec("Set [", "] failed\n", set_list[i], "'");
+  for (size_t i = 0; i < set_list.size(); ) {
+    // values of the same node are validated as a batch
+    vector<bool> valid;
+    size_t start = i;
+    size_t end = validate_set_path_batch(set_list, start, valid, NULL);
+    for (; i < end; i++) {
+      if (!valid[i - start] || !set_cfg_path(set_list[i], true)) {
+        print_path_vec("Set [", "] failed\n", set_list[i], "'");
+      }
     }
   }
   for (size_t i = 0; i < com_list.size(); i++) {
@@ -2108,6 +2694,158 @@ Cstore::loadFile(const char *filename)
   return _loadFile(filename);
 }
 
+/* 64-bit FNV-1a hash used for the save fingerprints */
+static unsigned long long
+_save_hash(const char *data, size_t len)
+{
+  unsigned long long h = 14695981039346656037ULL;
+  for (size_t i = 0; i < len; i++) {
+    h ^= (unsigned char) data[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+static string
+_save_fingerprint(unsigned long long dhash, const struct stat& st)
+{
+  char buf[128];
+  snprintf(buf, sizeof(buf), "%016llx %llu %lld %lld.%09ld", dhash,
+           (unsigned long long) st.st_ino, (long long) st.st_size,
+           (long long) st.st_mtim.tv_sec, (long) st.st_mtim.tv_nsec);
+  return buf;
+}
+
+/* save the active config to the specified file.
+ * the config is rendered into memory (same output as "showConfig
+ * --show-active-only --show-ignore-edit") followed by the output of the
+ * config version script, and then written to a temporary file in the same
+ * directory with a single write, fsync()ed, and atomically renamed to the
+ * target.
+ *
+ * each save records a fingerprint (hash of the content and the inode, size,
+ * and mtime of the saved file) in the C_SAVE_FP_XATTR attribute of the
+ * file itself, so only those who can write the file can change it. if
+ * skip_unchanged is set and the content is the same as the last save to
+ * the same file and the file has not been touched since, nothing is
+ * written.
+ *
+ * note: this always saves from the root of the active config, so it should
+ *       be used with a cstore that does not use the edit level.
+ * return true if successful. otherwise return false.
+ */
+bool
+Cstore::saveConfig(const char *filename, bool show_def, bool skip_unchanged,
+                   bool *skipped)
+{
+  if (skipped) {
+    *skipped = false;
+  }
+
+  char *buf = NULL;
+  size_t size = 0;
+  FILE *mf = open_memstream(&buf, &size);
+  if (!mf) {
+    output_internal("saveConfig: open_memstream failed\n");
+    return false;
+  }
+  {
+    Cpath root;
+    CfgNode aroot(*this, root, true, true);
+    show_cfg(aroot, show_def, false, mf);
+  }
+  FILE *vf = popen(C_SAVE_VERSION_CMD.c_str(), "r");
+  if (vf) {
+    char vbuf[4096];
+    size_t n;
+    while ((n = fread(vbuf, 1, sizeof(vbuf), vf)) > 0) {
+      fwrite(vbuf, 1, n, mf);
+    }
+    pclose(vf);
+  }
+  fclose(mf);
+  string data(buf, size);
+  free(buf);
+
+  // fingerprint of the content
+  unsigned long long dhash = _save_hash(data.data(), data.size());
+  struct stat st;
+  if (skip_unchanged && lstat(filename, &st) == 0 && S_ISREG(st.st_mode)) {
+    char prev[128];
+    ssize_t len = lgetxattr(filename, C_SAVE_FP_XATTR.c_str(), prev,
+                            sizeof(prev) - 1);
+    if (len > 0) {
+      prev[len] = 0;
+      if (_save_fingerprint(dhash, st) == prev) {
+        if (skipped) {
+          *skipped = true;
+        }
+        return true;
+      }
+    }
+  }
+
+  string tfile = filename;
+  tfile += ".XXXXXX";
+  int fd = mkstemp(&tfile[0]);
+  if (fd < 0) {
+    output_user("Cannot create temporary file for [%s]\n", filename);
+    return false;
+  }
+  mode_t um = umask(0);
+  umask(um);
+  fchmod(fd, 0666 & ~um);
+  const char *p = data.data();
+  size_t left = data.size();
+  while (left > 0) {
+    ssize_t n = write(fd, p, left);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    p += n;
+    left -= n;
+  }
+  if (left > 0 || fsync(fd) != 0) {
+    output_user("Failed to write [%s]: %s\n", tfile.c_str(), strerror(errno));
+    close(fd);
+    unlink(tfile.c_str());
+    return false;
+  }
+  /* record the fingerprint for the next save. this does not change the
+   * mtime, and the attribute moves with the file in the rename below. not
+   * fatal if the filesystem does not support it (never skipped then).
+   */
+  if (fstat(fd, &st) == 0) {
+    string fp = _save_fingerprint(dhash, st);
+    fsetxattr(fd, C_SAVE_FP_XATTR.c_str(), fp.data(), fp.length(), 0);
+  }
+  close(fd);
+  if (rename(tfile.c_str(), filename) != 0) {
+    output_user("Failed to rename [%s] to [%s]: %s\n", tfile.c_str(),
+                filename, strerror(errno));
+    unlink(tfile.c_str());
+    return false;
+  }
+  // make the rename itself durable
+  string dir = filename;
+  size_t slash = dir.rfind('/');
+  if (slash == string::npos) {
+    dir = ".";
+  } else {
+    dir.resize(slash > 0 ? slash : 1);
+  }
+  int dfd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+  if (dfd >= 0) {
+    fsync(dfd);
+    close(dfd);
+  }
+
+  return true;
+}
+
 /* "changed" status handling.
  * the "changed" status is used during commit to check if a node has been
  * changed. note that if a node is "changed", all of its ancestors are also
@@ -2194,6 +2932,25 @@ Cstore::executeTmplActions(char *at_str, const Cpath& path,
   return ret;
 }
 
+void
+Cstore::getVarRefPaths(const char *at_str, const Cpath& path,
+                       const char *ref_str, bool from_active,
+                       vector<Cpath>& paths)
+{
+  // the "at" string is only borrowed, so restore it when done
+  char *save_at = get_at_string();
+  set_at_string(const_cast<char *>(at_str));
+  {
+    auto_ptr<SavePaths> save(create_save_paths());
+    append_cfg_path(path);
+    append_tmpl_path(path);
+
+    VarRef vref(this, ref_str, from_active);
+    vref.getRefPaths(paths);
+  }
+  set_at_string(save_at);
+}
+
 bool
 Cstore::cfgPathMarkedCommitted(const Cpath& path_comps, bool is_delete)
 {
@@ -2277,9 +3034,71 @@ Cstore::assert_internal(bool cond, const char *fmt, ...)
 
 ////// private functions
 bool
-Cstore::sort_func_deb_version(string a, string b)
+Cstore::sort_func_deb_version(const string& a, const string& b)
+{
+  const char *pa = a.data();
+  const char *pb = b.data();
+  return (debVS.DoCmpVersion(pa, pa + a.size(), pb, pb + b.size()) < 0);
+}
+
+/* precomputed sort key for deb version sorting. names that are plain
+ * numbers (rule numbers, etc.) compare the same as numbers under deb
+ * version comparison, so they are compared by number of significant digits
+ * and then the digits, without calling the version comparison.
+ */
+typedef struct {
+  size_t idx;       // index of the name
+  const string *name;
+  size_t off;       // start of significant digits. npos if not a number.
+} DebSortKeyT;
+
+static bool
+_deb_sort_key_less(const DebSortKeyT& a, const DebSortKeyT& b)
+{
+  if (a.off == string::npos || b.off == string::npos) {
+    const char *pa = a.name->data();
+    const char *pb = b.name->data();
+    return (debVS.DoCmpVersion(pa, pa + a.name->size(),
+                               pb, pb + b.name->size()) < 0);
+  }
+  size_t la = a.name->size() - a.off;
+  size_t lb = b.name->size() - b.off;
+  if (la != lb) {
+    return (la < lb);
+  }
+  return (memcmp(a.name->data() + a.off, b.name->data() + b.off, la) < 0);
+}
+
+void
+Cstore::sort_nodes_deb_version(vector<string>& nvec)
 {
-  return (debVS.CmpVersion(a, b) < 0);
+  vector<DebSortKeyT> keys(nvec.size());
+  for (size_t i = 0; i < nvec.size(); i++) {
+    const string& n = nvec[i];
+    keys[i].idx = i;
+    keys[i].name = &n;
+    keys[i].off = string::npos;
+    if (!n.empty() && n.find_first_not_of("0123456789") == string::npos) {
+      size_t off = n.find_first_not_of('0');
+      keys[i].off = (off == string::npos ? n.size() : off);
+    }
+  }
+
+  // listings are often already sorted. nothing to do in that case.
+  size_t n = 1;
+  while (n < keys.size() && !_deb_sort_key_less(keys[n], keys[n - 1])) {
+    n++;
+  }
+  if (n == keys.size()) {
+    return;
+  }
+
+  sort(keys.begin(), keys.end(), _deb_sort_key_less);
+  vector<string> sorted(nvec.size());
+  for (size_t i = 0; i < keys.size(); i++) {
+    sorted[i].swap(nvec[keys[i].idx]);
+  }
+  nvec.swap(sorted);
 }
 
 void
@@ -2294,6 +3113,10 @@ Cstore::sort_nodes(vector<string>& nvec, unsigned int sort_alg)
   if (p == _sort_func_map.end()) {
     return;
   }
+  if (p->second == &sort_func_deb_version) {
+    sort_nodes_deb_version(nvec);
+    return;
+  }
   sort(nvec.begin(), nvec.end(), p->second);
 }
 
@@ -2662,6 +3485,8 @@ Cstore::cfg_path_exists(const Cpath& path_comps, const bool active_cfg,
 bool
 Cstore::set_cfg_path(const Cpath& path_comps, bool output)
 {
+  varref_cache_flush();
+  invalidateCompletionCache();
   Cpath ppath;
   tr1::shared_ptr<Ctemplate> def;
   bool ret = true;
@@ -2924,6 +3749,63 @@ Cstore::get_child_nodes_status_da(const Cpath& path_comps,
   }
 }
 
+/* recursive part of cfgPathGetSubtreeStatus(). anode and wnode are the
+ * node in active and working config respectively (NULL if not there).
+ * path is the full path of the node and rpath the relative one.
+ */
+void
+Cstore::get_subtree_status(const CfgNode *anode, const CfgNode *wnode,
+                           Cpath& path, Cpath& rpath, vector<Cpath>& paths,
+                           vector<unsigned int>& status)
+{
+  // the node-level observers are not DA, so deactivated means not there
+  bool in_active = (anode && !anode->isDeactivated());
+  bool in_work = (wnode && !wnode->isDeactivated());
+  const CfgNode *node = (wnode ? wnode : anode);
+
+  if (path.size() > 0) {
+    unsigned int st = 0;
+    if (in_active && !in_work) {
+      st |= (C_PATH_STATUS_DELETED | C_PATH_STATUS_CHANGED);
+    } else if (!in_active && in_work) {
+      st |= (C_PATH_STATUS_ADDED | C_PATH_STATUS_CHANGED);
+    } else {
+      auto_ptr<SavePaths> save(create_save_paths());
+      append_cfg_path(path);
+      if (cfg_node_changed()) {
+        st |= C_PATH_STATUS_CHANGED;
+      }
+    }
+    if (commit::isCommitPathEffective(*this, path, node->isTagNode(),
+                                      in_active, in_work)) {
+      st |= C_PATH_STATUS_EFFECTIVE;
+    }
+    if (wnode && wnode->isDeactivated()) {
+      st |= C_PATH_STATUS_DEACTIVATED;
+    }
+    paths.push_back(rpath);
+    status.push_back(st);
+  }
+
+  if (node->isLeaf()) {
+    return;
+  }
+  vector<CfgNode *> acnodes, wcnodes;
+  bool not_tag_node, is_value, is_leaf_typeless;
+  string name, value;
+  cmp_non_leaf_nodes(anode, wnode, acnodes, wcnodes, not_tag_node, is_value,
+                     is_leaf_typeless, name, value);
+  for (size_t i = 0; i < acnodes.size(); i++) {
+    const CfgNode *c = (acnodes[i] ? acnodes[i] : wcnodes[i]);
+    const string& comp = (not_tag_node ? c->getName() : c->getValue());
+    path.push(comp);
+    rpath.push(comp);
+    get_subtree_status(acnodes[i], wcnodes[i], path, rpath, paths, status);
+    path.pop();
+    rpath.pop();
+  }
+}
+
 /* remove tag at current work path and its subtree.
  * if specified tag is the last one, also remove the tag node.
  * return true if successful. otherwise return false.
@@ -2962,29 +3844,16 @@ Cstore::remove_tag()
 bool
 Cstore::remove_value_from_multi(const string& value)
 {
-  // get current values
-  vector<string> vvec;
-  if (!read_value_vec(vvec, false)) {
-    return false;
-  }
-
-  // remove the value
-  size_t bc = vvec.size();
-  vector<string> nvec(vvec.begin(), remove(vvec.begin(), vvec.end(), value));
-  size_t ac = nvec.size();
-
-  // sanity check
-  if (ac == bc) {
+  size_t remaining;
+  if (!remove_from_value_vec(value, remaining)) {
     // nothing removed
     return false;
   }
-  if (ac == 0) {
+  if (remaining == 0) {
     // was the last value. remove the node.
     return remove_node();
-  } else {
-    // write the new values out
-    return write_value_vec(nvec);
   }
+  return true;
 }
 
 /* check whether specified value exists at current work path.
@@ -2993,13 +3862,7 @@ Cstore::remove_value_from_multi(const string& value)
 bool
 Cstore::cfg_value_exists(const string& value, bool active_cfg)
 {
-  // get current values
-  vector<string> vvec;
-  if (!read_value_vec(vvec, active_cfg)) {
-    return false;
-  }
-
-  return (find(vvec.begin(), vvec.end(), value) != vvec.end());
+  return value_vec_contains(value, active_cfg);
 }
 
 /* validate value at current template path.
@@ -3029,6 +3892,143 @@ Cstore::validate_val(const tr1::shared_ptr<Ctemplate>& def, const char *value)
   return ret;
 }
 
+/* validate values in "values" starting at "start" against the same
+ * template, in order, stopping at the first invalid one. this is the same
+ * as validate_val() on each value, but "exec" checks that do not depend on
+ * the individual value are run once for the batch (see validate_values()).
+ * return the number of valid values before the first invalid one.
+ * note: same as validate_val(), current template and cfg paths both point
+ *       to the node.
+ */
+size_t
+Cstore::validate_vals(const tr1::shared_ptr<Ctemplate>& def,
+                      const vector<string>& values, size_t start)
+{
+  if (!def.get()) {
+    exit_internal("validate_vals: no tmpl [%s]\n",
+                  tmpl_path_to_str().c_str());
+  }
+  if (start >= values.size()) {
+    return 0;
+  }
+
+  // validate_value() may change the values. make copies first.
+  vector<char *> vbufs;
+  for (size_t i = start; i < values.size(); i++) {
+    vbufs.push_back(strdup(values[i].c_str()));
+  }
+  var_ref_handle = (void *) this;
+  int ret = validate_values(def->getDef(), &(vbufs[0]), vbufs.size());
+  var_ref_handle = NULL;
+  for (size_t i = 0; i < vbufs.size(); i++) {
+    free(vbufs[i]);
+  }
+  return ret;
+}
+
+/* validate the "set" paths in "paths" starting at "start" that set values
+ * of the same node, e.g., the values of a multi-value node or the tag
+ * values of a tag node. this is the same as _validateSetPath() on each of
+ * them, but the path leading to the node is only validated once and the
+ * values (including the first one) are validated as a batch.
+ *   valid: (output) whether each path of the batch is valid.
+ *   bout:  (optional) told which output is for which path.
+ * return the index of the path after the batch.
+ */
+size_t
+Cstore::validate_set_path_batch(const vector<Cpath>& paths, size_t start,
+                                vector<bool>& valid, BatchOutput *bout)
+{
+  const Cpath& first = paths[start];
+  size_t plen = first.size() - 1;
+  size_t end = start + 1;
+  while (first.size() > 1 && end < paths.size()
+         && paths[end].size() == first.size()) {
+    size_t i = 0;
+    for (; i < plen && strcmp(paths[end][i], first[i]) == 0; i++);
+    if (i < plen) {
+      break;
+    }
+    ++end;
+  }
+  valid.assign(end - start, false);
+
+  if (end - start == 1) {
+    if (bout) {
+      bout->start();
+    }
+    valid[0] = _validateSetPath(first);
+    if (bout && !valid[0]) {
+      bout->end(start);
+    }
+    return end;
+  }
+
+  // validate the path to the node once
+  Cpath ppath;
+  for (size_t i = 0; i < plen; i++) {
+    ppath.push(first[i]);
+  }
+  if (bout) {
+    bout->start();
+  }
+  string terr;
+  tr1::shared_ptr<Ctemplate> def(get_parsed_tmpl(ppath, true, terr));
+  if (!def.get()) {
+    // the error applies to the whole batch
+    output_user("%s\n", terr.c_str());
+    for (size_t i = start; bout && i < end; i++) {
+      bout->end(i);
+    }
+    return end;
+  }
+  if (!def->isTag() && !def->isMulti() && def->isTypeless()) {
+    // not values. validate them one by one.
+    for (size_t i = start; i < end; i++) {
+      if (bout) {
+        bout->start();
+      }
+      valid[i - start] = _validateSetPath(paths[i]);
+      if (bout && !valid[i - start]) {
+        bout->end(i);
+      }
+    }
+    return end;
+  }
+
+  // all the values (including the first) are validated as a batch
+  vector<string> vals;
+  for (size_t i = start; i < end; i++) {
+    vals.push_back(paths[i][plen]);
+  }
+  auto_ptr<SavePaths> save(create_save_paths());
+  append_cfg_path(ppath);
+  append_tmpl_path(ppath);
+  size_t i = 0;
+  while (i < vals.size()) {
+    /* validation stops at the first invalid value, so the output of each
+     * round is for that value.
+     */
+    if (bout) {
+      bout->start();
+    }
+    size_t n = validate_vals(def, vals, i);
+    for (size_t j = 0; j < n; j++) {
+      valid[i + j] = true;
+    }
+    i += n;
+    if (i < vals.size()) {
+      // same as get_parsed_tmpl() failing in _validateSetPath()
+      output_user("Value validation failed\n");
+      if (bout) {
+        bout->end(start + i);
+      }
+      ++i;
+    }
+  }
+  return end;
+}
+
 /* add tag at current work path.
  * return true if successful. otherwise return false.
  * note: assume current work path is a new tag and path from root to parent
@@ -3073,11 +4073,6 @@ Cstore::add_tag(unsigned int tlimit)
 bool
 Cstore::add_value_to_multi(unsigned int mlimit, const string& value)
 {
-  // get current values
-  vector<string> vvec;
-  // ignore return value here. if it failed, vvec is empty.
-  read_value_vec(vvec, false);
-
   /* note: XXX the original limit-checking logic uses the same count as tag
    *       node, which is wrong since multi-node values are not stored as
    *       directories in the original implementation.
@@ -3091,7 +4086,7 @@ Cstore::add_value_to_multi(unsigned int mlimit, const string& value)
    *
    *       for now just apply the limit for anything >= 1.
    */
-  if (mlimit >= 1 && vvec.size() >= mlimit) {
+  if (mlimit >= 1 && value_vec_size(false) >= mlimit) {
     // limit exceeded
     output_user("Cannot set value \"%s\": number of values exceeded "
                 "(%d allowed)\n", value.c_str(), mlimit);
@@ -3099,10 +4094,56 @@ Cstore::add_value_to_multi(unsigned int mlimit, const string& value)
   }
 
   // append the value
+  return append_value_vec(value);
+}
+
+/* default implementations of the single-value operations on a
+ * multi-value node. these go through the whole value vector.
+ */
+bool
+Cstore::append_value_vec(const string& value)
+{
+  vector<string> vvec;
+  // ignore return value here. if it failed, vvec is empty.
+  read_value_vec(vvec, false);
   vvec.push_back(value);
   return write_value_vec(vvec);
 }
 
+bool
+Cstore::remove_from_value_vec(const string& value, size_t& remaining)
+{
+  vector<string> vvec;
+  if (!read_value_vec(vvec, false)) {
+    return false;
+  }
+  size_t bc = vvec.size();
+  vector<string> nvec(vvec.begin(), remove(vvec.begin(), vvec.end(), value));
+  remaining = nvec.size();
+  if (remaining == bc) {
+    return false;
+  }
+  return (remaining == 0 || write_value_vec(nvec));
+}
+
+bool
+Cstore::value_vec_contains(const string& value, bool active_cfg)
+{
+  vector<string> vvec;
+  if (!read_value_vec(vvec, active_cfg)) {
+    return false;
+  }
+  return (find(vvec.begin(), vvec.end(), value) != vvec.end());
+}
+
+size_t
+Cstore::value_vec_size(bool active_cfg)
+{
+  vector<string> vvec;
+  read_value_vec(vvec, active_cfg);
+  return vvec.size();
+}
+
 /* this uses the get_all_child_node_names_impl() from the underlying
  * implementation but provides the option to exclude deactivated nodes.
  */
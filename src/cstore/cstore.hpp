@@ -57,7 +57,9 @@ typedef std::vector<CstoreCPathT> CstoreCPathListT;
 
 class Cstore {
 public:
-  Cstore() { init(); };
+  Cstore()
+    : _varref_cache_enabled(false), _varref_cache_hits(0),
+      _varref_cache_misses(0) { init(); };
   Cstore(string& env);
   virtual ~Cstore() {};
 
@@ -85,10 +87,18 @@ public:
   static const string C_ENV_SHAPI_HELP_ITEMS;
   static const string C_ENV_SHAPI_HELP_STRS;
 
+  static const string C_ENV_TMPL_PRELOAD;
+
   static const string C_ENUM_SCRIPT_DIR;
   static const string C_LOGFILE_STDOUT;
 
-  static const size_t MAX_CMD_OUTPUT_SIZE = 4096;
+  // completion cache for "enumeration"/"allowed" output
+  static const string C_COMP_CACHE_DIR;
+  static const string C_COMP_CACHE_GEN;
+  static const string C_SAVE_VERSION_CMD;
+  static const string C_SAVE_FP_XATTR;
+  static const unsigned int C_COMP_CACHE_TTL = 15;   // seconds
+  static const unsigned int C_COMP_SLOW_MSEC = 250;
 
   // for sorting
   /* apparently unordered_map template does not work with "enum" type, so
@@ -130,6 +140,21 @@ public:
    */
   // set
   bool validateSetPath(const Cpath& path_comps);
+  /* called around the validation of a batch so that the caller can tell
+   * which output belongs to which path: the output between start() and
+   * end(i) is for paths[i]. end() is only called for invalid paths, and it
+   * can be called for several paths after one start() if the same output
+   * applies to all of them.
+   */
+  class BatchOutput {
+  public:
+    BatchOutput() {}
+    virtual ~BatchOutput() {}
+    virtual void start() = 0;
+    virtual void end(size_t idx) = 0;
+  };
+  size_t validateSetPathBatch(const vector<Cpath>& paths, size_t start,
+                              vector<bool>& valid, BatchOutput *bout = NULL);
   bool setCfgPath(const Cpath& path_comps);
   // delete
   bool deleteCfgPath(const Cpath& path_comps);
@@ -163,6 +188,10 @@ public:
   };
   // completion-related
   bool getCompletionEnv(const Cpath& comps, string& env);
+  static void filterCompletionPrefix(const vector<string>& vals,
+                                     const string& prefix,
+                                     vector<string>& matches);
+  static void invalidateCompletionCache();
   void getEditLevel(Cpath& comps) {
     get_edit_level(comps);
   };
@@ -179,6 +208,14 @@ public:
   bool executeTmplActions(char *at_str, const Cpath& path,
                           const Cpath& disp_path, const vtw_node *actions,
                           const vtw_def *def);
+  /* get the config paths that the var ref ref_str refers to when it is
+   * evaluated for the node at path with the specified "at" string (i.e.,
+   * the same context as executeTmplActions()). for a ref to a value, the
+   * path of the leaf node is returned.
+   */
+  void getVarRefPaths(const char *at_str, const Cpath& path,
+                      const char *ref_str, bool from_active,
+                      vector<Cpath>& paths);
   bool cfgPathMarkedCommitted(const Cpath& path_comps, bool is_delete);
   bool markCfgPathCommitted(const Cpath& path_comps, bool is_delete);
   virtual bool markCfgPathCommitted(const CstoreCPathListT& clist);
@@ -200,6 +237,13 @@ public:
      */
   // load
   bool loadFile(const char *filename);
+  /* save the active config (plus the config version string) to the
+   * specified file. see the source file for details.
+   *   skipped: (output, optional) whether the write was skipped since the
+   *            file has not changed since the last save.
+   */
+  bool saveConfig(const char *filename, bool show_def = true,
+                  bool skip_unchanged = false, bool *skipped = NULL);
 
   /******
    * these functions are observers of the current "working config" or
@@ -226,6 +270,10 @@ public:
   bool cfgPathGetComment(const Cpath& path_comps, string& comment,
                          bool active_cfg = false);
   bool cfgPathDefault(const Cpath& path_comps, bool active_cfg = false);
+  // bulk read of a whole subtree (max_depth 0 means no limit)
+  tr1::shared_ptr<const cnode::CfgNode>
+    cfgPathGetSubtree(const Cpath& path_comps, bool active_cfg = false,
+                      size_t max_depth = 0);
 
   /* observers for working AND active configs (at the same time).
    * MUST ONLY be used during config session.
@@ -237,6 +285,23 @@ public:
                                    vector<string>& cnodes);
   void cfgPathGetDeletedValues(const Cpath& path_comps,
                                vector<string>& dvals);
+  /* status of the node at the specified path and all nodes below it,
+   * obtained in one pass. see source file for details.
+   */
+  static const unsigned int C_PATH_STATUS_ADDED = 0x01;
+  static const unsigned int C_PATH_STATUS_DELETED = 0x02;
+  static const unsigned int C_PATH_STATUS_CHANGED = 0x04;
+  static const unsigned int C_PATH_STATUS_EFFECTIVE = 0x08;
+  static const unsigned int C_PATH_STATUS_DEACTIVATED = 0x10;
+  void cfgPathGetSubtreeStatus(const Cpath& path_comps, vector<Cpath>& paths,
+                               vector<unsigned int>& status);
+  void cfgPathGetSubtreeStatus(const Cpath& path_comps,
+                               MapT<string, string>& smap);
+  void cfgPathGetSubtreesWithStatus(
+    const Cpath& path_comps, tr1::shared_ptr<const cnode::CfgNode>& aroot,
+    tr1::shared_ptr<const cnode::CfgNode>& wroot, vector<Cpath>& paths,
+    vector<unsigned int>& status);
+  static string pathStatusToString(unsigned int status);
   void cfgPathGetChildNodesStatus(const Cpath& path_comps,
                                   MapT<string, string>& cmap) {
     get_child_nodes_status(path_comps, cmap, NULL);
@@ -315,6 +380,34 @@ public:
   virtual void enableCacheMode() {};
   virtual void disableCacheMode() {};
 
+  /* var ref cache. while enabled (for the duration of a commit), resolved
+   * $VAR() references are cached per (node, "@" value, ref). the cache is
+   * flushed by setVarRef() and by config changes made through this object.
+   */
+  void enableVarRefCache() {
+    _varref_cache.clear();
+    _varref_cache_enabled = true;
+    _varref_cache_hits = _varref_cache_misses = 0;
+  };
+  void disableVarRefCache() {
+    _varref_cache.clear();
+    _varref_cache_enabled = false;
+  };
+  void getVarRefCacheStats(size_t& hits, size_t& misses) const {
+    hits = _varref_cache_hits;
+    misses = _varref_cache_misses;
+  };
+
+  /* template preloading. parse all templates up front instead of on demand
+   * when they are visited. this is opt-in for full-tree operations (load,
+   * commit): preloadTemplatesIfEnabled() only does it if C_ENV_TMPL_PRELOAD
+   * is set in the environment, and its value (if a number) is the number
+   * of threads used to read the template tree (0 = number of cpus).
+   * returns the number of templates parsed.
+   */
+  size_t preloadTemplates(unsigned int nthreads = 0);
+  size_t preloadTemplatesIfEnabled();
+
   /* these are internal API functions and operate on current cfg and
    * tmpl paths during cstore operations. they are only used to work around
    * the limitations of the original CLI library implementation and MUST NOT
@@ -327,6 +420,13 @@ public:
   // Should not be called from CLI directly.
   // set
   bool _validateSetPath(const Cpath& path_comps);
+  size_t _validateSetPathBatch(const vector<Cpath>& paths, size_t start,
+                               vector<bool>& valid, BatchOutput *bout = NULL) {
+    return validate_set_path_batch(paths, start, valid, bout);
+  }
+  bool _setCfgPath(const Cpath& path_comps) {
+    return set_cfg_path(path_comps, true);
+  }
   // delete
   bool _deleteCfgPath(const Cpath& path_comps);
   // activate (actually "unmark deactivated" since it is 2-state, not 3)
@@ -420,6 +520,13 @@ public:
     return comment_exists(cmarkers);
   }
   bool _cfgPathDefault(const Cpath& path_comps, bool active_cfg = false);
+  tr1::shared_ptr<const cnode::CfgNode>
+    _cfgPathGetSubtree(const Cpath& path_comps, bool active_cfg = false,
+                       size_t max_depth = 0);
+  void _cfgPathGetSubtreesWithStatus(
+    const Cpath& path_comps, tr1::shared_ptr<const cnode::CfgNode>& aroot,
+    tr1::shared_ptr<const cnode::CfgNode>& wroot, vector<Cpath>& paths,
+    vector<unsigned int>& status);
   bool _cfgPathDefault(const vector<string>& cmarkers) {
     return marked_display_default(cmarkers);
   }
@@ -477,6 +584,23 @@ private:
   // for variable reference
   class VarRef;
 
+  // var ref cache
+  struct VarRefCacheEntryT {
+    bool found;
+    vtw_type_e type;
+    string value;
+  };
+  MapT<string, VarRefCacheEntryT> _varref_cache;
+  bool _varref_cache_enabled;
+  size_t _varref_cache_hits;
+  size_t _varref_cache_misses;
+
+  void varref_cache_flush() {
+    if (!_varref_cache.empty()) {
+      _varref_cache.clear();
+    }
+  };
+
   ////// virtual
   /* "path modifiers"
    * note: only these functions are allowed to permanently change the paths.
@@ -502,6 +626,8 @@ private:
   // these operate on current tmpl path
   virtual bool tmpl_node_exists() = 0;
   virtual Ctemplate *tmpl_parse() = 0;
+  // parse all templates under the template root into the template cache
+  virtual size_t tmpl_preload(unsigned int nthreads) { return 0; };
 
   // these operate on current work path (or active with "active_cfg")
   virtual bool remove_node() = 0;
@@ -518,6 +644,11 @@ private:
   virtual bool write_value_vec(const vector<string>& vvec,
                                bool active_cfg = false) = 0;
   virtual bool update_value_vec() = 0;
+  /* single-value edits of a multi-value node. the defaults rewrite the
+   * whole value vector; implementations can do better for large nodes.
+   */
+  virtual bool append_value_vec(const string& value);
+  virtual bool remove_from_value_vec(const string& value, size_t& remaining);
   virtual bool add_node() = 0;
   virtual bool rename_child_node(const char *oname, const char *nname) = 0;
   virtual bool copy_child_node(const char *oname, const char *nname) = 0;
@@ -538,6 +669,8 @@ private:
 
   // observers for current work path or active path
   virtual bool read_value_vec(vector<string>& vvec, bool active_cfg) = 0;
+  virtual bool value_vec_contains(const string& value, bool active_cfg);
+  virtual size_t value_vec_size(bool active_cfg);
   virtual bool val_exists(const vector<string>& cmarkers) = 0;
   virtual bool cfg_node_exists(bool active_cfg) = 0;
   virtual bool marked_deactivated(bool active_cfg) = 0;
@@ -563,6 +696,9 @@ private:
   virtual void get_edit_level(Cpath& path_comps) = 0;
   virtual bool edit_level_at_root() = 0;
 
+  // identifies the config session (e.g., for the completion cache)
+  virtual string get_session_key() = 0;
+
   // functions for commit operation
   virtual bool marked_committed(bool is_delete) = 0;
   virtual bool mark_committed(bool is_delete) = 0;
@@ -573,10 +709,11 @@ private:
 
   ////// implemented
   // for sorting
-  typedef bool (*SortFuncT)(std::string, std::string);
+  typedef bool (*SortFuncT)(const std::string&, const std::string&);
   static MapT<unsigned int, SortFuncT> _sort_func_map;
 
-  static bool sort_func_deb_version(string a, string b);
+  static bool sort_func_deb_version(const string& a, const string& b);
+  static void sort_nodes_deb_version(vector<string>& nvec);
   static void sort_nodes(vector<string>& nvec,
                          unsigned int sort_alg = SORT_DEFAULT);
 
@@ -626,6 +763,10 @@ private:
                        const bool include_deactivated,
                        const bool is_value = true);
   bool set_cfg_path(const Cpath& path_comps, bool output);
+  void get_subtree_status(const cnode::CfgNode *anode,
+                          const cnode::CfgNode *wnode, Cpath& path,
+                          Cpath& rpath, vector<Cpath>& paths,
+                          vector<unsigned int>& status);
   void get_child_nodes_status(const Cpath& path_comps,
                               MapT<string, string>& cmap,
                               vector<string> *sorted_keys);
@@ -659,11 +800,17 @@ private:
 
   // these operate on both current tmpl and work paths
   bool validate_val(const tr1::shared_ptr<Ctemplate>& def, const char *value);
+  size_t validate_vals(const tr1::shared_ptr<Ctemplate>& def,
+                       const vector<string>& values, size_t start = 0);
   bool create_default_children(const Cpath& path_comps); /* this requires
     * path_comps but DOES operate on current work path.
     */
   void get_edit_env(string& env);
 
+  // these use (and restore) the paths
+  size_t validate_set_path_batch(const vector<Cpath>& paths, size_t start,
+                                 vector<bool>& valid, BatchOutput *bout);
+
   // util functions
   string get_shell_prompt(const string& level);
   void shell_escape_squotes(string& str);
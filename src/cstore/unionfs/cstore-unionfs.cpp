@@ -22,6 +22,9 @@
 
 #include <fcntl.h>
 #include <errno.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <unistd.h>
 #include <sys/mount.h>
 #include <sys/time.h>
 
@@ -940,6 +943,157 @@ UnionfsCstore::tmpl_parse()
   return ctmpl;
 }
 
+/* template preloading. the template tree is read by a pool of threads:
+ * each thread takes a directory from the shared queue, records the type of
+ * each entry, reads any template file, and queues the subdirectories. the
+ * templates are then parsed in this thread since the parser is not
+ * reentrant.
+ */
+struct TmplPreloadItemT {
+  string path;
+  mode_t mode;
+  bool is_def;
+  string def;
+};
+
+struct TmplPreloadStateT {
+  string def_name;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  vector<string> dirs;
+  size_t active;
+  vector<TmplPreloadItemT> items;
+};
+
+static bool
+_read_tmpl_file(const string& path, string& data)
+{
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  char buf[8192];
+  ssize_t n;
+  while ((n = read(fd, buf, sizeof(buf))) > 0) {
+    data.append(buf, n);
+  }
+  close(fd);
+  return (n == 0);
+}
+
+static void *
+_tmpl_preload_thread(void *arg)
+{
+  TmplPreloadStateT *st = static_cast<TmplPreloadStateT *>(arg);
+  vector<string> subdirs;
+  vector<TmplPreloadItemT> items;
+
+  pthread_mutex_lock(&st->mutex);
+  while (true) {
+    while (st->dirs.empty() && st->active > 0) {
+      pthread_cond_wait(&st->cond, &st->mutex);
+    }
+    if (st->dirs.empty()) {
+      // no more work
+      break;
+    }
+    string dir = st->dirs.back();
+    st->dirs.pop_back();
+    ++st->active;
+    pthread_mutex_unlock(&st->mutex);
+
+    subdirs.clear();
+    items.clear();
+    DIR *dp = opendir(dir.c_str());
+    struct dirent *de;
+    while (dp && (de = readdir(dp))) {
+      if (de->d_name[0] == '.') {
+        continue;
+      }
+      TmplPreloadItemT item;
+      item.path = dir + "/" + de->d_name;
+      item.is_def = false;
+      if (de->d_type != DT_UNKNOWN) {
+        item.mode = DTTOIF(de->d_type);
+      } else {
+        struct stat sb;
+        item.mode = (lstat(item.path.c_str(), &sb) == 0 ? sb.st_mode : 0);
+      }
+      if (S_ISDIR(item.mode)) {
+        subdirs.push_back(item.path);
+      } else if (S_ISREG(item.mode) && st->def_name == de->d_name) {
+        item.is_def = _read_tmpl_file(item.path, item.def);
+      }
+      items.push_back(item);
+    }
+    if (dp) {
+      closedir(dp);
+    }
+
+    pthread_mutex_lock(&st->mutex);
+    st->dirs.insert(st->dirs.end(), subdirs.begin(), subdirs.end());
+    st->items.insert(st->items.end(), items.begin(), items.end());
+    --st->active;
+    pthread_cond_broadcast(&st->cond);
+  }
+  pthread_cond_broadcast(&st->cond);
+  pthread_mutex_unlock(&st->mutex);
+  return NULL;
+}
+
+size_t
+UnionfsCstore::tmpl_preload(unsigned int nthreads)
+{
+  TmplPreloadStateT st;
+  st.def_name = C_DEF_NAME;
+  pthread_mutex_init(&st.mutex, NULL);
+  pthread_cond_init(&st.cond, NULL);
+  st.active = 0;
+  st.dirs.push_back(tmpl_root.path_cstr());
+
+  vector<pthread_t> threads;
+  for (unsigned int i = 0; i < nthreads; i++) {
+    pthread_t t;
+    if (pthread_create(&t, NULL, _tmpl_preload_thread, &st) != 0) {
+      break;
+    }
+    threads.push_back(t);
+  }
+  if (threads.empty()) {
+    // no threads. do it here.
+    _tmpl_preload_thread(&st);
+  }
+  for (size_t i = 0; i < threads.size(); i++) {
+    pthread_join(threads[i], NULL);
+  }
+  pthread_cond_destroy(&st.cond);
+  pthread_mutex_destroy(&st.mutex);
+
+  /* fill in the cache. entries that are already cached are left alone
+   * so the result is the same as without preloading.
+   */
+  size_t num = 0;
+  for (size_t i = 0; i < st.items.size(); i++) {
+    const TmplPreloadItemT& item = st.items[i];
+    FsPath path(item.path);
+    if (_parsed_tmpl_cache.find(path) != _parsed_tmpl_cache.end()) {
+      continue;
+    }
+    tr1::shared_ptr<TmplCacheT> tmpl_item(new TmplCacheT);
+    tmpl_item->mode = item.mode;
+    if (item.is_def) {
+      tr1::shared_ptr<vtw_def> def(new vtw_def);
+      if (parse_def_buf(def.get(), item.path.c_str(), item.def.data(),
+                        item.def.size(), 0) == 0) {
+        tmpl_item->def = def;
+        ++num;
+      }
+    }
+    _parsed_tmpl_cache[path] = tmpl_item;
+  }
+  return num;
+}
+
 bool
 UnionfsCstore::check_cached_path(const FsPath& path, mode_t& mode)
 {
@@ -1036,8 +1190,11 @@ void
 UnionfsCstore::get_all_child_node_names_impl(vector<string>& cnodes,
                                              bool active_cfg)
 {
-  FsPath p = (active_cfg ? get_active_path() : get_work_path());
-  get_all_child_dir_names(p, cnodes);
+  if (active_cfg) {
+    get_cached_child_dir_names(get_active_path(), cnodes);
+  } else {
+    get_all_child_dir_names(get_work_path(), cnodes);
+  }
 
   /* XXX special cases to emulate original perl API behavior.
    *     original perl listNodes() and listOrigNodes() return everything
@@ -1143,17 +1300,15 @@ UnionfsCstore::get_changed_items(vector<string>& mnodes,
   }
 }
 
-bool
-UnionfsCstore::read_value_vec(vector<string>& vvec, bool active_cfg)
+/* value files hold the values separated by newline (no trailing newline,
+ * so an empty file is one empty value). this format is also read directly
+ * by the C CLI code, so it is kept as is; single-value edits below avoid
+ * splitting/rejoining the whole vector, and large files get an in-memory
+ * sorted index for membership checks.
+ */
+static void
+split_values(const string& ostr, vector<string>& vvec)
 {
-  FsPath vpath = (active_cfg ? get_active_path() : get_work_path());
-  vpath.push(C_VAL_NAME);
-
-  string ostr;
-  if (!read_whole_file(vpath, ostr)) {
-    return false;
-  }
-
   /* XXX original implementation used to remove a trailing '\n' after
    *     a read. it was only necessary because it was adding a '\n' when
    *     writing the file. don't remove anything now since we shouldn't
@@ -1174,6 +1329,94 @@ UnionfsCstore::read_value_vec(vector<string>& vvec, bool active_cfg)
     // last char is a newline => another empty value
     vvec.push_back("");
   }
+}
+
+// find the start of the line matching value in the raw file content
+static bool
+find_value(const string& ostr, const string& value, size_t& pos)
+{
+  size_t start = 0;
+  while (true) {
+    size_t end = ostr.find('\n', start);
+    size_t len = (end == string::npos ? ostr.size() : end) - start;
+    if (len == value.size() && ostr.compare(start, len, value) == 0) {
+      pos = start;
+      return true;
+    }
+    if (end == string::npos) {
+      return false;
+    }
+    start = end + 1;
+  }
+}
+
+typedef struct {
+  dev_t           dev;
+  ino_t           ino;
+  off_t           size;
+  struct timespec mtime;
+  vector<string>  sorted;
+} ValIndexT;
+
+typedef MapT<string, tr1::shared_ptr<ValIndexT> > ValIndexCacheT;
+static ValIndexCacheT _val_index_cache;
+
+static bool
+val_index_valid(const ValIndexT& vi, const struct stat& st)
+{
+  return (vi.dev == st.st_dev && vi.ino == st.st_ino
+          && vi.size == st.st_size
+          && vi.mtime.tv_sec == st.st_mtim.tv_sec
+          && vi.mtime.tv_nsec == st.st_mtim.tv_nsec);
+}
+
+// put back the index of a value file that was just written by this process
+static void
+val_index_keep(const FsPath& vpath, const tr1::shared_ptr<ValIndexT>& vi)
+{
+  struct stat st;
+  if (stat(vpath.path_cstr(), &st) != 0) {
+    return;
+  }
+  vi->dev = st.st_dev;
+  vi->ino = st.st_ino;
+  vi->size = st.st_size;
+  vi->mtime = st.st_mtim;
+  _val_index_cache[vpath.path_cstr()] = vi;
+}
+
+/* take the index of a value file out of the cache before writing the file.
+ * returns the index if it was up to date, so that the caller can apply its
+ * edit to it and put it back with val_index_keep().
+ */
+static tr1::shared_ptr<ValIndexT>
+val_index_take(const FsPath& vpath)
+{
+  tr1::shared_ptr<ValIndexT> vi;
+  ValIndexCacheT::iterator p = _val_index_cache.find(vpath.path_cstr());
+  if (p == _val_index_cache.end()) {
+    return vi;
+  }
+  struct stat st;
+  if (stat(vpath.path_cstr(), &st) == 0 && val_index_valid(*(p->second), st)) {
+    vi = p->second;
+  }
+  _val_index_cache.erase(p);
+  return vi;
+}
+
+bool
+UnionfsCstore::read_value_vec(vector<string>& vvec, bool active_cfg)
+{
+  FsPath vpath = (active_cfg ? get_active_path() : get_work_path());
+  vpath.push(C_VAL_NAME);
+
+  string ostr;
+  if (!read_whole_file(vpath, ostr)) {
+    return false;
+  }
+
+  split_values(ostr, vvec);
   return true;
 }
 
@@ -1192,6 +1435,7 @@ UnionfsCstore::write_value_vec(const vector<string>& vvec, bool active_cfg)
     ostr += vvec[i];
   }
 
+  _val_index_cache.erase(wp.path_cstr());
   if (!write_file(wp, ostr)) {
     output_internal("failed to write node value (write) [%s]\n",
                     wp.path_cstr());
@@ -1201,6 +1445,153 @@ UnionfsCstore::write_value_vec(const vector<string>& vvec, bool active_cfg)
   return true;
 }
 
+bool
+UnionfsCstore::append_value_vec(const string& value)
+{
+  FsPath wp = get_work_path();
+  wp.push(C_VAL_NAME);
+
+  tr1::shared_ptr<ValIndexT> vi(val_index_take(wp));
+  bool ret;
+  struct stat st;
+  if (stat(wp.path_cstr(), &st) == 0) {
+    // only the new value goes to disk, but the limit is on the whole file
+    string data = "\n" + value;
+    if ((size_t) st.st_size + data.size() > C_UNIONFS_MAX_FILE_SIZE) {
+      output_internal("append_value_vec too large [%s]\n", wp.path_cstr());
+      return false;
+    }
+    ret = write_file(wp, data, true);
+  } else {
+    ret = write_file(wp, value);
+  }
+  if (!ret) {
+    output_internal("failed to write node value (append) [%s]\n",
+                    wp.path_cstr());
+  } else if (vi.get()) {
+    vi->sorted.insert(upper_bound(vi->sorted.begin(), vi->sorted.end(),
+                                  value), value);
+    val_index_keep(wp, vi);
+  }
+  return ret;
+}
+
+bool
+UnionfsCstore::remove_from_value_vec(const string& value, size_t& remaining)
+{
+  FsPath wp = get_work_path();
+  wp.push(C_VAL_NAME);
+
+  /* the file itself is rewritten without the value (the values are only
+   * delimited by newlines), but an index tells if the value is there
+   * without reading the file, and is kept in step with the file instead
+   * of being rebuilt by the next lookup.
+   */
+  tr1::shared_ptr<ValIndexT> vi(val_index_take(wp));
+  if (vi.get() && !binary_search(vi->sorted.begin(), vi->sorted.end(),
+                                 value)) {
+    val_index_keep(wp, vi);
+    return false;
+  }
+
+  string ostr;
+  if (!read_whole_file(wp, ostr)) {
+    return false;
+  }
+
+  size_t nvals = count(ostr.begin(), ostr.end(), '\n') + 1;
+  size_t pos, removed = 0;
+  while (find_value(ostr, value, pos)) {
+    // take out the value and one of its delimiters
+    if (pos > 0) {
+      ostr.erase(pos - 1, value.size() + 1);
+    } else if (value.size() < ostr.size()) {
+      ostr.erase(0, value.size() + 1);
+    } else {
+      ostr.clear();
+    }
+    removed++;
+    if (removed == nvals) {
+      break;
+    }
+  }
+  if (removed == 0) {
+    return false;
+  }
+  remaining = nvals - removed;
+  if (remaining == 0) {
+    // caller removes the node
+    return true;
+  }
+
+  if (!write_file(wp, ostr)) {
+    output_internal("failed to write node value (remove) [%s]\n",
+                    wp.path_cstr());
+    return false;
+  }
+  if (vi.get()) {
+    pair<vector<string>::iterator, vector<string>::iterator>
+      r = equal_range(vi->sorted.begin(), vi->sorted.end(), value);
+    vi->sorted.erase(r.first, r.second);
+    val_index_keep(wp, vi);
+  }
+  return true;
+}
+
+bool
+UnionfsCstore::value_vec_contains(const string& value, bool active_cfg)
+{
+  FsPath vpath = (active_cfg ? get_active_path() : get_work_path());
+  vpath.push(C_VAL_NAME);
+
+  struct stat st;
+  if (!path_status(vpath, &st)) {
+    return false;
+  }
+  if (static_cast<size_t>(st.st_size) < C_VAL_INDEX_MIN_SIZE) {
+    string ostr;
+    size_t pos;
+    return (read_whole_file(vpath, ostr) && find_value(ostr, value, pos));
+  }
+
+  tr1::shared_ptr<ValIndexT>& vi = _val_index_cache[vpath.path_cstr()];
+  if (!vi.get() || !val_index_valid(*vi, st)) {
+    string ostr;
+    if (!read_whole_file(vpath, ostr)) {
+      _val_index_cache.erase(vpath.path_cstr());
+      return false;
+    }
+    vi.reset(new ValIndexT);
+    vi->dev = st.st_dev;
+    vi->ino = st.st_ino;
+    vi->size = st.st_size;
+    vi->mtime = st.st_mtim;
+    split_values(ostr, vi->sorted);
+    sort(vi->sorted.begin(), vi->sorted.end());
+  }
+  return binary_search(vi->sorted.begin(), vi->sorted.end(), value);
+}
+
+size_t
+UnionfsCstore::value_vec_size(bool active_cfg)
+{
+  FsPath vpath = (active_cfg ? get_active_path() : get_work_path());
+  vpath.push(C_VAL_NAME);
+
+  ValIndexCacheT::iterator p = _val_index_cache.find(vpath.path_cstr());
+  struct stat st;
+  if (p != _val_index_cache.end() && path_status(vpath, &st)
+      && val_index_valid(*(p->second), st)) {
+    return p->second->sorted.size();
+  }
+
+  string ostr;
+  if (!read_whole_file(vpath, ostr)) {
+    return 0;
+  }
+  return count(ostr.begin(), ostr.end(), '\n') + 1;
+}
+
 bool
 UnionfsCstore::update_value_vec()
 {
@@ -1720,29 +2111,86 @@ bool
 UnionfsCstore::check_dir_entries(const FsPath& root, vector<string>& cnodes,
                                  bool filter_nodes)
 {
-  try {
-    b_fs::directory_iterator di(root.path_cstr());
-    for (; di != b_fs::directory_iterator(); ++di) {
-      string cname = di->path().filename().string();
-      if (filter_nodes) {
-        // dir name cannot start with "." or be node.val
-        if (cname.length() < 1 || cname[0] == '.' || cname == C_VAL_NAME) {
-          continue;
-        }
-        // must be directory
-        if (!path_is_directory(di->path().string())) {
+  DIR *dp = opendir(root.path_cstr());
+  if (!dp) {
+    return false;
+  }
+  struct dirent *de;
+  while ((de = readdir(dp))) {
+    const char *cname = de->d_name;
+    if (strcmp(cname, ".") == 0 || strcmp(cname, "..") == 0) {
+      continue;
+    }
+    if (filter_nodes) {
+      // dir name cannot start with "." or be node.val
+      if (cname[0] == 0 || cname[0] == '.' || C_VAL_NAME == cname) {
+        continue;
+      }
+      // must be directory. use the type from the entry if available.
+      if (de->d_type == DT_UNKNOWN) {
+        FsPath p(root);
+        p.push(cname);
+        if (!path_is_directory(p)) {
           continue;
         }
+      } else if (de->d_type != DT_DIR) {
+        continue;
       }
-      // found one
-      cnodes.push_back(_unescape_path_name(cname));
     }
-  } catch (...) {
-    // skip the rest
+    // found one
+    cnodes.push_back(_unescape_path_name(cname));
   }
+  closedir(dp);
   return (cnodes.size() > 0);
 }
 
+/* child node listings of active config directories are cached (sorted) and
+ * reused as long as the directory is not modified, i.e., adding or removing
+ * an entry changes the mtime. directories modified in the last second are
+ * not cached since the mtime granularity may hide a following change.
+ */
+typedef struct {
+  ino_t ino;
+  struct timespec mtime;
+  vector<string> names;
+} DirEntriesCacheT;
+
+typedef MapT<FsPath, DirEntriesCacheT, FsPathHash> DirEntriesCacheMapT;
+static DirEntriesCacheMapT _dir_entries_cache;
+
+void
+UnionfsCstore::get_cached_child_dir_names(const FsPath& root,
+                                          vector<string>& nodes)
+{
+  struct stat st;
+  if (stat(root.path_cstr(), &st) != 0) {
+    _dir_entries_cache.erase(root);
+    return;
+  }
+  DirEntriesCacheMapT::iterator p = _dir_entries_cache.find(root);
+  if (p != _dir_entries_cache.end()) {
+    if (p->second.ino == st.st_ino
+        && p->second.mtime.tv_sec == st.st_mtim.tv_sec
+        && p->second.mtime.tv_nsec == st.st_mtim.tv_nsec) {
+      nodes.insert(nodes.end(), p->second.names.begin(),
+                   p->second.names.end());
+      return;
+    }
+    _dir_entries_cache.erase(p);
+  }
+
+  vector<string> names;
+  check_dir_entries(root, names);
+  sortNodes(names);
+  if (time(NULL) > st.st_mtim.tv_sec) {
+    DirEntriesCacheT& e = _dir_entries_cache[root];
+    e.ino = st.st_ino;
+    e.mtime = st.st_mtim;
+    e.names = names;
+  }
+  nodes.insert(nodes.end(), names.begin(), names.end());
+}
+
 bool
 UnionfsCstore::isEmptyDir(const char *const dir)
 {
@@ -113,6 +113,11 @@ private:
    */
   static const size_t C_UNIONFS_MAX_FILE_SIZE = 262144;
 
+  /* value files at least this large get a sorted in-memory index for
+   * membership checks (see value_vec_contains()).
+   */
+  static const size_t C_VAL_INDEX_MIN_SIZE = 16384;
+
   // root dirs (constant)
   FsPath work_root;   // working root (union)
   FsPath active_root; // active root (readonly part of union)
@@ -225,6 +230,7 @@ private:
   // these operate on current tmpl path
   bool tmpl_node_exists();
   Ctemplate *tmpl_parse();
+  size_t tmpl_preload(unsigned int nthreads);
 
   // these operate on current work path
   bool add_node();
@@ -240,6 +246,8 @@ private:
   void get_all_tmpl_child_node_names(vector<string>& cnodes);
   bool write_value_vec(const vector<string>& vvec, bool active_cfg);
   bool update_value_vec();
+  bool append_value_vec(const string& value);
+  bool remove_from_value_vec(const string& value, size_t& remaining);
   bool val_exists(const vector<string>& cmarkers);
   bool rename_child_node(const char *oname, const char *nname);
   bool copy_child_node(const char *oname, const char *nname);
@@ -264,6 +272,8 @@ private:
   // observers for work path or active path
   bool cfg_node_exists(bool active_cfg);
   bool read_value_vec(vector<string>& vvec, bool active_cfg);
+  bool value_vec_contains(const string& value, bool active_cfg);
+  size_t value_vec_size(bool active_cfg);
   bool marked_deactivated(bool active_cfg);
   bool marked_deactivated(const vector<string>& cmarkers);
   bool get_comment(string& comment, bool active_cfg);
@@ -284,6 +294,11 @@ private:
     return cfg_path_at_root();
   };
 
+  // the work dir is specific to the session
+  string get_session_key() {
+    return work_root.path_cstr();
+  };
+
   // functions for commit operation
   bool marked_committed(bool is_delete);
   bool mark_committed(bool is_delete);
@@ -305,6 +320,7 @@ private:
   void get_all_child_dir_names(const FsPath& root, vector<string>& nodes) {
     check_dir_entries(root, nodes);
   }
+  void get_cached_child_dir_names(const FsPath& root, vector<string>& nodes);
   bool _write_file(const char *const file, const string& data,
                    const bool append);
   bool write_file(const FsPath& file, const string& data,
@@ -8,39 +8,63 @@
 
 #include <boost/algorithm/string.hpp>
 
+#include <cnode/cnode-algorithm.hpp>
+
 #include "fw.hpp"
 #include "address.hpp"
 #include "util.hpp"
 
 using namespace std;
 using namespace cstore;
+using namespace cnode;
 
 Address::Address()
 {
     _setup = false;
 }
 
-void
-Address::setup(Cpath& cpath, bool active)
+static void
+_value(const CfgNode *node, const char *name, string& value)
 {
-    vector<string> children;
-    vector<string>::iterator it;
+    Cpath p;
+    p.push(name);
+    const CfgNode *c = cnode::findCfgNode(node, p);
+    if (c && c->isLeaf() && !c->isMulti()) {
+        value = c->getValue();
+    }
+}
 
+/*
+ * rule is the "firewall ... rule <n>" subtree (NULL if it doesn't exist)
+ */
+void
+Address::setup(const CfgNode *rule, const string& srcdst)
+{
     _ip_version = "ipv4";
-    _srcdst     = cpath[5];
+    _srcdst     = srcdst;
 
-    cpath.pop();
-    cpath.push("protocol");
-    g_cstore->_cfgPathGetValue(cpath, _protocol, active);
-    cpath.pop();
-    cpath.push(_srcdst);
+    if (!rule) {
+        _setup = true;
+        return;
+    }
+    _value(rule, "protocol", _protocol);
+
+    Cpath p;
+    p.push(_srcdst);
+    const CfgNode *node = cnode::findCfgNode(rule, p);
+    if (!node) {
+        _setup = true;
+        return;
+    }
 
-    g_cstore->_cfgPathGetChildNodes(cpath, children, active);
+    const vector<CfgNode *>& children = node->getChildNodes();
+    vector<CfgNode *>::const_iterator it;
     for (it = children.begin(); it < children.end(); it++) {
-        if (*it == "address") {
+        const CfgNode *c = *it;
+        const string& name = c->getName();
+        if (name == "address") {
             size_t pos;
-            cpath.push(*it);
-            g_cstore->_cfgPathGetValue(cpath, _address, active);
+            _address = c->getValue();
             if (_address.find('/') != string::npos) {
                 _network = _address;
                 _address.clear();
@@ -49,60 +73,43 @@ Address::setup(Cpath& cpath, bool active)
                 _range_stop  = _address.substr(pos+1);
                 _address.clear();
             }
-            cpath.pop();
             continue;
         }
-        if (*it == "port") {
-            cpath.push(*it);
-            g_cstore->_cfgPathGetValue(cpath, _port, active);
-            cpath.pop();
+        if (name == "port") {
+            _port = c->getValue();
             continue;
         }
-        if (*it == "mac-address") {
-            cpath.push(*it);
-            g_cstore->_cfgPathGetValue(cpath, _src_mac, active);
-            cpath.pop();
+        if (name == "mac-address") {
+            _src_mac = c->getValue();
             continue;
         }
-        if (*it == "group") {
-            vector<string> g_children;
-            vector<string>::iterator g_it;
-            cpath.push(*it);
-            g_cstore->_cfgPathGetChildNodes(cpath, g_children, active);
+        if (name == "group") {
+            const vector<CfgNode *>& g_children = c->getChildNodes();
+            vector<CfgNode *>::const_iterator g_it;
             for (g_it = g_children.begin(); g_it < g_children.end(); g_it++) {
-                if (*g_it == "address-group") {
-                    cpath.push(*g_it);
-                    g_cstore->_cfgPathGetValue(cpath, _address_group, active);
-                    cpath.pop();
+                const string& g_name = (*g_it)->getName();
+                if (g_name == "address-group") {
+                    _address_group = (*g_it)->getValue();
                     continue;
                 }
-                if (*g_it == "network-group") {
-                    cpath.push(*g_it);
-                    g_cstore->_cfgPathGetValue(cpath, _network_group, active);
-                    cpath.pop();
+                if (g_name == "network-group") {
+                    _network_group = (*g_it)->getValue();
                     continue;
                 }
-                if (*g_it == "ipv6-address-group") {
-                    cpath.push(*g_it);
-                    g_cstore->_cfgPathGetValue(cpath, _address_group, active);
-                    cpath.pop();
+                if (g_name == "ipv6-address-group") {
+                    _address_group = (*g_it)->getValue();
                     continue;
                 }
-                if (*g_it == "ipv6-network-group") {
-                    cpath.push(*g_it);
-                    g_cstore->_cfgPathGetValue(cpath, _network_group, active);
-                    cpath.pop();
+                if (g_name == "ipv6-network-group") {
+                    _network_group = (*g_it)->getValue();
                     continue;
                 }
 
-                if (*g_it == "port-group") {
-                    cpath.push(*g_it);
-                    g_cstore->_cfgPathGetValue(cpath, _port_group, active);
-                    cpath.pop();
+                if (g_name == "port-group") {
+                    _port_group = (*g_it)->getValue();
                     continue;
                 }
             } // end of for g_children
-            cpath.pop();
         } // end of "group"
     }
     _setup = true;
@@ -4,6 +4,7 @@
 #include <string>
 
 #include <cstore/cstore.hpp>
+#include <cnode/cnode.hpp>
 
 class Address
 {
@@ -15,7 +16,7 @@ public:
         FW_GROUP_LAST
     };
     Address();
-    void setup(cstore::Cpath& cpath, bool active);
+    void setup(const cnode::CfgNode *rule, const std::string& srcdst);
     void set_ip_version(const std::string& ip_version);
     bool rule(std::string& rule_string, std::string& err) const;
     void print() const;
@@ -7,6 +7,9 @@
 #include <boost/lexical_cast.hpp>
 #include <boost/algorithm/string.hpp>
 
+#include <cnode/cnode.hpp>
+#include <cnode/cnode-algorithm.hpp>
+
 #include "fw.hpp"
 #include "rule.hpp"
 #include "util.hpp"
@@ -14,6 +17,7 @@
 
 using namespace std;
 using namespace cstore;
+using namespace cnode;
 
 Rule::Rule()
 {
@@ -38,6 +42,29 @@ Rule::Rule()
     _selfdestruct = false;
 }
 
+static const CfgNode *
+_child(const CfgNode *node, const char *name)
+{
+    Cpath p;
+    p.push(name);
+    return cnode::findCfgNode(node, p);
+}
+
+static bool
+_exists(const CfgNode *node, const char *name)
+{
+    return (_child(node, name) != NULL);
+}
+
+static void
+_value(const CfgNode *node, const char *name, string& value)
+{
+    const CfgNode *c = _child(node, name);
+    if (c && c->isLeaf() && !c->isMulti()) {
+        value = c->getValue();
+    }
+}
+
 void
 Rule::setup_base(Cpath& cpath, bool active)
 {
@@ -47,247 +74,132 @@ Rule::setup_base(Cpath& cpath, bool active)
     _rule_number = cpath[4];
     _comment     = _name + "-" + _rule_number;
 
-    vector<string> children;
-    vector<string>::iterator it;
-    g_cstore->_cfgPathGetChildNodes(cpath, children, active);
+    // read the whole rule at once instead of one path at a time
+    static const vector<CfgNode *> none;
+    tr1::shared_ptr<const CfgNode> rule
+        = g_cstore->_cfgPathGetSubtree(cpath, active);
+    const vector<CfgNode *>& children
+        = (rule.get() ? rule->getChildNodes() : none);
+    vector<CfgNode *>::const_iterator it;
     for (it = children.begin(); it < children.end(); it++) {
-        if (*it == "action") {
-            cpath.push("action");
-            g_cstore->_cfgPathGetValue(cpath, _action, active);
-            cpath.pop();
+        const CfgNode *c = *it;
+        const string& name = c->getName();
+        if (name == "action") {
+            _action = c->getValue();
             continue;
         }
-        if (*it == "protocol") {
-            cpath.push("protocol");
-            g_cstore->_cfgPathGetValue(cpath, _protocol, active);
-            cpath.pop();
+        if (name == "protocol") {
+            _protocol = c->getValue();
             continue;
         }
-        if (*it == "state") {
-            cpath.push("state");
-            cpath.push("established");
-            g_cstore->_cfgPathGetValue(cpath, _state[ESTABLISHED], active);
-            cpath.pop();
-            cpath.push("new");
-            g_cstore->_cfgPathGetValue(cpath, _state[NEW], active);
-            cpath.pop();
-            cpath.push("related");
-            g_cstore->_cfgPathGetValue(cpath, _state[RELATED], active);
-            cpath.pop();
-            cpath.push("invalid");
-            g_cstore->_cfgPathGetValue(cpath, _state[INVALID], active);
-            cpath.pop();
-            cpath.pop();
+        if (name == "state") {
+            _value(c, "established", _state[ESTABLISHED]);
+            _value(c, "new", _state[NEW]);
+            _value(c, "related", _state[RELATED]);
+            _value(c, "invalid", _state[INVALID]);
             continue;
         }
-        if (*it == "log") {
-            cpath.push("log");
-            g_cstore->_cfgPathGetValue(cpath, _log, active);
-            cpath.pop();
+        if (name == "log") {
+            _log = c->getValue();
             continue;
         }
-        if (*it == "tcp") {
-            cpath.push("tcp");
-            cpath.push("flags");
-            g_cstore->_cfgPathGetValue(cpath, _tcp_flags, active);
-            cpath.pop();
-            cpath.pop();
+        if (name == "tcp") {
+            _value(c, "flags", _tcp_flags);
             continue;
         }
-        if (*it == "icmp") {
-            cpath.push("icmp");
-            cpath.push("code");
-            g_cstore->_cfgPathGetValue(cpath, _icmp_code, active);
-            cpath.pop();
-            cpath.push("type");
-            g_cstore->_cfgPathGetValue(cpath, _icmp_type, active);
-            cpath.pop();
-            cpath.push("type-name");
-            g_cstore->_cfgPathGetValue(cpath, _icmp_name, active);
-            cpath.pop();
-            cpath.pop();
+        if (name == "icmp") {
+            _value(c, "code", _icmp_code);
+            _value(c, "type", _icmp_type);
+            _value(c, "type-name", _icmp_name);
             continue;
         }
-        if (*it == "icmpv6") {
-            cpath.push("icmpv6");
-            cpath.push("type");
-            g_cstore->_cfgPathGetValue(cpath, _icmpv6_type, active);
-            cpath.pop();
-            cpath.pop();
+        if (name == "icmpv6") {
+            _value(c, "type", _icmpv6_type);
             continue;
         }
-        if (*it == "ipsec") {
-            cpath.push("ipsec");
-            cpath.push("match-ipsec");
-            _ipsec = g_cstore->_cfgPathExists(cpath, active);
-            cpath.pop();
-            cpath.push("match-none");
-            _non_ipsec = g_cstore->_cfgPathExists(cpath, active);
-            cpath.pop();
-            cpath.pop();
+        if (name == "ipsec") {
+            _ipsec = _exists(c, "match-ipsec");
+            _non_ipsec = _exists(c, "match-none");
             continue;
         }
-        if (*it == "fragment") {
-            cpath.push("fragment");
-            cpath.push("match-frag");
-            _frag = g_cstore->_cfgPathExists(cpath, active);
-            cpath.pop();
-            cpath.push("match-non-frag");
-            _non_frag = g_cstore->_cfgPathExists(cpath, active);
-            cpath.pop();
-            cpath.pop();
+        if (name == "fragment") {
+            _frag = _exists(c, "match-frag");
+            _non_frag = _exists(c, "match-non-frag");
             continue;
         }
-        if (*it == "recent") {
-            cpath.push("recent");
-            cpath.push("time");
-            g_cstore->_cfgPathGetValue(cpath, _recent_time, active);
-            cpath.pop();
-            cpath.push("count");
-            g_cstore->_cfgPathGetValue(cpath, _recent_cnt, active);
-            cpath.pop();
-            cpath.pop();
+        if (name == "recent") {
+            _value(c, "time", _recent_time);
+            _value(c, "count", _recent_cnt);
             continue;
         }
-        if (*it == "p2p") {
+        if (name == "p2p") {
             _p2p_set = true;
-            cpath.push("p2p");
-            cpath.push("all");
-            _p2p[ALL] = g_cstore->_cfgPathExists(cpath, active);
-            cpath.pop();
-            cpath.push("applejuice");
-            _p2p[APPLE] = g_cstore->_cfgPathExists(cpath, active);
-            cpath.pop();
-            cpath.push("bittorrent");
-            _p2p[BIT] = g_cstore->_cfgPathExists(cpath, active);
-            cpath.pop();
-            cpath.push("directconnect");
-            _p2p[DC] = g_cstore->_cfgPathExists(cpath, active);
-            cpath.pop();
-            cpath.push("edonkey");
-            _p2p[EDK] = g_cstore->_cfgPathExists(cpath, active);
-            cpath.pop();
-            cpath.push("gnutella");
-            _p2p[GNU] = g_cstore->_cfgPathExists(cpath, active);
-            cpath.pop();
-            cpath.push("kazaa");
-            _p2p[KAZAA] = g_cstore->_cfgPathExists(cpath, active);
-            cpath.pop();
-            cpath.pop();
+            _p2p[ALL] = _exists(c, "all");
+            _p2p[APPLE] = _exists(c, "applejuice");
+            _p2p[BIT] = _exists(c, "bittorrent");
+            _p2p[DC] = _exists(c, "directconnect");
+            _p2p[EDK] = _exists(c, "edonkey");
+            _p2p[GNU] = _exists(c, "gnutella");
+            _p2p[KAZAA] = _exists(c, "kazaa");
             continue;
         }
-        if (*it == "time") {
-            cpath.push("time");
-            cpath.push("startdate");
-            g_cstore->_cfgPathGetValue(cpath, _time[STARTDATE], active);
-            cpath.pop();
-            cpath.push("stopdate");
-            g_cstore->_cfgPathGetValue(cpath, _time[STOPDATE], active);
-            cpath.pop();
-            cpath.push("starttime");
-            g_cstore->_cfgPathGetValue(cpath, _time[STARTTIME], active);
-            cpath.pop();
-            cpath.push("stoptime");
-            g_cstore->_cfgPathGetValue(cpath, _time[STOPTIME], active);
-            cpath.pop();
-            cpath.push("monthdays");
-            g_cstore->_cfgPathGetValue(cpath, _time[MONTHDAYS], active);
-            cpath.pop();
-            cpath.push("weekdays");
-            g_cstore->_cfgPathGetValue(cpath, _time[WEEKDAYS], active);
-            cpath.pop();
-            cpath.push("utc");
-            _time_utc = g_cstore->_cfgPathExists(cpath, active);
-            cpath.pop();
-            cpath.pop();
+        if (name == "time") {
+            _value(c, "startdate", _time[STARTDATE]);
+            _value(c, "stopdate", _time[STOPDATE]);
+            _value(c, "starttime", _time[STARTTIME]);
+            _value(c, "stoptime", _time[STOPTIME]);
+            _value(c, "monthdays", _time[MONTHDAYS]);
+            _value(c, "weekdays", _time[WEEKDAYS]);
+            _time_utc = _exists(c, "utc");
             continue;
         }
-        if (*it == "limit") {
-            cpath.push("limit");
-            cpath.push("rate");
-            g_cstore->_cfgPathGetValue(cpath, _limit[RATE], active);
-            cpath.pop();
-            cpath.push("burst");
-            g_cstore->_cfgPathGetValue(cpath, _limit[BURST], active);
-            cpath.pop();
-            cpath.pop();
+        if (name == "limit") {
+            _value(c, "rate", _limit[RATE]);
+            _value(c, "burst", _limit[BURST]);
             continue;
         }
-        if (*it == "disable") {
-            cpath.push("disable");
-            _disable = g_cstore->_cfgPathExists(cpath, active);
-            cpath.pop();
+        if (name == "disable") {
+            _disable = true;
             continue;
         }
-        if (*it == "modify") {
-            cpath.push("modify");
-            cpath.push("dscp");
-            g_cstore->_cfgPathGetValue(cpath, _mod_dscp, active);
-            cpath.pop();
-            cpath.push("mark");
-            g_cstore->_cfgPathGetValue(cpath, _mod_mark, active);
-            cpath.pop();
-            cpath.push("tcp-mss");
-            g_cstore->_cfgPathGetValue(cpath, _mod_tcpmss, active);
-            cpath.pop();
-            cpath.push("table");
-            g_cstore->_cfgPathGetValue(cpath, _mod_table, active);
+        if (name == "modify") {
+            _value(c, "dscp", _mod_dscp);
+            _value(c, "mark", _mod_mark);
+            _value(c, "tcp-mss", _mod_tcpmss);
+            _value(c, "table", _mod_table);
             if (_mod_table == "main")
                 _mod_table = "254";
-            cpath.pop();
-
-            cpath.push("connmark");
-            cpath.push("set-mark");
-            g_cstore->_cfgPathGetValue(cpath, _mod_connmark_set, active);
-            cpath.pop();
-            cpath.push("save-mark");
-            if (g_cstore->_cfgPathExists(cpath, active))
-                _mod_connmark_save = "save";
-            cpath.pop();
-            cpath.push("restore-mark");
-            if (g_cstore->_cfgPathExists(cpath, active))
-                _mod_connmark_restore = "restore";
-            cpath.pop();
-            cpath.pop();
-            cpath.push("lb-group");
-            g_cstore->_cfgPathGetValue(cpath, _mod_lb_group, active);
-            cpath.pop();
-            cpath.pop();
+
+            const CfgNode *cm = _child(c, "connmark");
+            if (cm) {
+                _value(cm, "set-mark", _mod_connmark_set);
+                if (_exists(cm, "save-mark"))
+                    _mod_connmark_save = "save";
+                if (_exists(cm, "restore-mark"))
+                    _mod_connmark_restore = "restore";
+            }
+            _value(c, "lb-group", _mod_lb_group);
             continue;
         }
-        if (*it == "description") {
-            string description;
-            cpath.push("description");
-            g_cstore->_cfgPathGetValue(cpath, description, active);
-            cpath.pop();
-            if (description == "XXXSELFDESTRUCTXXX")
+        if (name == "description") {
+            if (c->getValue() == "XXXSELFDESTRUCTXXX")
                 _selfdestruct = true;
             continue;
         }
-        if (*it == "statistic") {
-            cpath.push("statistic");
-            cpath.push("probability");
-            g_cstore->_cfgPathGetValue(cpath, _probability, active);
-            cpath.pop();
-            cpath.pop();
+        if (name == "statistic") {
+            _value(c, "probability", _probability);
             continue;
         }
-        if (*it == "connmark") {
-            cpath.push("connmark");
-            g_cstore->_cfgPathGetValue(cpath, _connmark, active);
-            cpath.pop();
+        if (name == "connmark") {
+            _connmark = c->getValue();
             continue;
         }
-        if (*it == "mark") {
-            cpath.push("mark");
-            g_cstore->_cfgPathGetValue(cpath, _mark, active);
-            cpath.pop();
+        if (name == "mark") {
+            _mark = c->getValue();
             continue;
         }
-        if (*it == "application") {
-            cpath.push("application");
-            cpath.push("category");
-            g_cstore->_cfgPathGetValue(cpath, _dpi_cat, active);
+        if (name == "application") {
+            _value(c, "category", _dpi_cat);
             if (!_dpi_cat.empty()) {
                 /*
                  * fixed categories are stored lower case and '_'
@@ -298,28 +210,18 @@ Rule::setup_base(Cpath& cpath, bool active)
                           ::tolower);
                 replace(_dpi_cat.begin(), _dpi_cat.end(), ' ', '-');
             }
-            cpath.pop();
-            cpath.push("custom-category");
-            g_cstore->_cfgPathGetValue(cpath, _dpi_cust_cat, active);
-            cpath.pop();
-            cpath.pop();
+            _value(c, "custom-category", _dpi_cust_cat);
             continue;
         }
-        if (*it == "dscp") {
-            cpath.push("dscp");
-            g_cstore->_cfgPathGetValue(cpath, _dscp, active);
-            cpath.pop();
+        if (name == "dscp") {
+            _dscp = c->getValue();
             continue;
         }
 
     } // for all rule children
 
-    cpath.push("source");
-    _src.setup(cpath, active);
-    cpath.pop();
-    cpath.push("destination");
-    _dst.setup(cpath, active);
-    cpath.pop();
+    _src.setup(rule.get(), "source");
+    _dst.setup(rule.get(), "destination");
 
     _setup = true;
 }
@@ -16,6 +16,7 @@
 #include "ubnt_interface.hpp"
 #include "../lib/vyatta_interface.hpp"
 #include "../lib/vyatta_config.hpp"
+#include "../lib/vyatta_netlink.hpp"
 
 using namespace std;
 
@@ -385,21 +386,21 @@ static bool update_mac(const string& mac, const string& name)
     exit(1);
   }
 
-  string cmd;
-  if (intf.up()) {
-    cmd = "/sbin/ip link set " + name + " down";
-    msg = "Could not " + cmd;
-    _system(cmd, msg, true);
-    cmd = "/sbin/ip link set " + name + " address " + mac;
-    msg = "Could not " + cmd;
-    _system(cmd, msg, true);
-    cmd = "/sbin/ip link set " + name + " up";
-    msg = "Could not " + cmd;
-    _system(cmd, msg, true);
-  } else {
-    cmd = "/sbin/ip link set " + name + " address " + mac;
-    msg = "Could not " + cmd;
-    _system(cmd, msg, true);
+  vyatta::Netlink nl;
+  bool up = intf.up();
+  if (up) {
+    nl.linkSetUp(name, false);
+  }
+  nl.linkSetMac(name, mac);
+  if (up) {
+    nl.linkSetUp(name, true);
+  }
+  if (nl.commit()) {
+    const vector<string>& errs = nl.errors();
+    for (size_t i = 0; i < errs.size(); i ++) {
+      cerr << "Could not " << errs[i] << endl;
+    }
+    exit(1);
   }
   return true;
 }
@@ -699,6 +700,7 @@ static void restore_ipv6_addr(const string& name,
                               const vector<string>& addrs)
 {
   unsigned char buf[sizeof(struct in6_addr)];
+  vyatta::Netlink nl;
 
   for (size_t i = 0; i < addrs.size(); i ++) {
     if (addrs[i] == "dhcp" || addrs[i] == "dhcpv6") {
@@ -719,13 +721,18 @@ static void restore_ipv6_addr(const string& name,
     if (inet_pton(AF_INET6, addr.c_str(), buf) != 1) {
       continue;
     }
-    /*
-     * If running interactively then 'ip' will print NETLINK answer.
-     * The error is unlikely. We want to continue as restoring other
-     * addresses might succeed.
-     */
-    _system("sudo /sbin/ip -6 addr add " + addrs[i] + " dev " + name,
-            "set ipv6 address failed");
+    nl.addrAdd(name, addrs[i]);
+  }
+
+  /*
+   * The error is unlikely. Each address is acknowledged separately
+   * so restoring the other addresses still succeeds.
+   */
+  if (nl.commit()) {
+    const vector<string>& errs = nl.errors();
+    for (size_t i = 0; i < errs.size(); i ++) {
+      cerr << "set ipv6 address failed: " << errs[i] << endl;
+    }
   }
 }
 
@@ -3,6 +3,8 @@
 
 #include <boost/algorithm/string.hpp>
 
+#include <cnode/cnode-algorithm.hpp>
+
 #include "vyatta_config.hpp"
 
 using namespace std;
@@ -31,25 +33,47 @@ vyatta::Config::_init()
   }
 }
 
-Cpath
-vyatta::Config::get_path_comps(const string& path) const
+void
+vyatta::Config::split_path(const string& path, Cpath& path_comps)
 {
-  string tmp(_level);
-  tmp += " " + path;
-  boost::trim(tmp);
-
-  Cpath path_comps;
   string s;
-  stringstream pstr(tmp);
+  stringstream pstr(path);
   while (getline(pstr, s, ' ')) {
     boost::trim(s);
     if (!s.empty()) {
       path_comps.push(s);
     }
   }
+}
+
+Cpath
+vyatta::Config::get_path_comps(const string& path) const
+{
+  string tmp(_level);
+  tmp += " " + path;
+  boost::trim(tmp);
+
+  Cpath path_comps;
+  split_path(tmp, path_comps);
   return path_comps;
 }
 
+const cnode::CfgNode *
+vyatta::Config::find_node(const cnode::CfgNode *subtree, const string& path,
+                          bool& is_value)
+{
+  is_value = false;
+  if (!subtree) {
+    return NULL;
+  }
+  Cpath path_comps;
+  split_path(path, path_comps);
+  if (path_comps.size() == 0) {
+    return subtree;
+  }
+  return cnode::findCfgNode(subtree, path_comps, is_value);
+}
+
 /**************************************************************************
  * low-level API functions that use the cstore library directly.
  * they are either new functions or old ones that have been
@@ -238,6 +262,72 @@ vyatta::Config::isDeleted(const string& path)
   return _cstore->cfgPathDeleted(get_path_comps(path));
 }
 
+/*
+ * return the whole subtree at "level" in working or active config,
+ * read in one pass. max_depth limits the number of levels read below
+ * "level" (0 means no limit). return NULL if the node doesn't exist.
+ * deactivated nodes are not in the subtree.
+ */
+vyatta::Config::SubtreeT
+vyatta::Config::getSubtree(const string& path, const bool active,
+                           const size_t max_depth)
+{
+  return _cstore->cfgPathGetSubtree(get_path_comps(path), active, max_depth);
+}
+
+/*
+ * the following are the equivalents of the observers above on a subtree
+ * returned by getSubtree(). they do not touch the config store at all.
+ */
+bool
+vyatta::Config::exists(const cnode::CfgNode *subtree, const string& path)
+{
+  bool is_value;
+  return (find_node(subtree, path, is_value) != NULL);
+}
+
+void
+vyatta::Config::listNodes(const cnode::CfgNode *subtree, const string& path,
+                          vector<string>& nodes)
+{
+  bool is_value;
+  const cnode::CfgNode *node = find_node(subtree, path, is_value);
+  if (!node || is_value || node->isLeaf()) {
+    return;
+  }
+  const vector<cnode::CfgNode *>& cnodes = node->getChildNodes();
+  for (size_t i = 0; i < cnodes.size(); i++) {
+    nodes.push_back(cnodes[i]->isValue()
+                    ? cnodes[i]->getValue() : cnodes[i]->getName());
+  }
+}
+
+bool
+vyatta::Config::returnValue(const cnode::CfgNode *subtree, const string& path,
+                            string& value)
+{
+  bool is_value;
+  const cnode::CfgNode *node = find_node(subtree, path, is_value);
+  if (!node || is_value || !node->isLeaf() || node->isMulti()) {
+    return false;
+  }
+  value = node->getValue();
+  return true;
+}
+
+bool
+vyatta::Config::returnValues(const cnode::CfgNode *subtree,
+                             const string& path, vector<string>& values)
+{
+  bool is_value;
+  const cnode::CfgNode *node = find_node(subtree, path, is_value);
+  if (!node || is_value || !node->isLeaf() || !node->isMulti()) {
+    return false;
+  }
+  values = node->getValues();
+  return true;
+}
+
 /**************************************************************************
  * high-level API functions (not using the cstore library directly)
  *************************************************************************/
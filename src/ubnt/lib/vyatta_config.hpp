@@ -5,6 +5,7 @@
 #include <vector>
 
 #include <cstore/cstore.hpp>
+#include <cnode/cnode.hpp>
 
 namespace vyatta { // begin namespace vyatta
 
@@ -63,11 +64,30 @@ public:
 
   const string& setLevel(const string& level);
 
+  typedef tr1::shared_ptr<const cnode::CfgNode> SubtreeT;
+  SubtreeT getSubtree(const string& path, const bool active = false,
+                      const size_t max_depth = 0);
+  SubtreeT getOrigSubtree(const string& path, const size_t max_depth = 0) {
+    return getSubtree(path, true, max_depth);
+  }
+
+  // observers of a subtree returned above (path is relative to subtree)
+  static bool exists(const cnode::CfgNode *subtree, const string& path);
+  static void listNodes(const cnode::CfgNode *subtree, const string& path,
+                        vector<string>& nodes);
+  static bool returnValue(const cnode::CfgNode *subtree, const string& path,
+                          string& value);
+  static bool returnValues(const cnode::CfgNode *subtree, const string& path,
+                           vector<string>& values);
+
 private:
   string _level, _dummy;
   tr1::shared_ptr<cstore::Cstore> _cstore;
 
   void _init();
+  static void split_path(const string& path, cstore::Cpath& path_comps);
+  static const cnode::CfgNode *find_node(const cnode::CfgNode *subtree,
+                                         const string& path, bool& is_value);
   cstore::Cpath get_path_comps(const string& path) const;
   cstore::Cpath get_path_comps() const {
     string dummy;
@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <iostream>
 #include <fstream>
+#include <algorithm>
 
 #include <errno.h>
 #include <limits.h>
@@ -47,55 +48,36 @@ static vyatta_intf_t _intfs[] = {
 };
 
 const string vyatta::Interface::_dummy;
+vyatta::Interface::AddrIndexT vyatta::Interface::_addr_index;
+string vyatta::Interface::_addr_index_sid;
+bool vyatta::Interface::_addr_index_valid = false;
 
-static int
-check_address(vyatta::Config& cfg, const string& path, const string& ip)
+/*
+ * add the addresses of the interface at path (relative to the
+ * "interfaces" subtree) to the index
+ */
+static void
+index_addresses(const cnode::CfgNode *intfs, const string& path,
+                boost::unordered_map<string, vector<string> >& idx)
 {
   vector<string> addrs;
 
   if (path.find("openvpn") != std::string::npos) {
-    cfg.listNodes(path + " local-address", addrs); 
+    vyatta::Config::listNodes(intfs, path + " local-address", addrs);
   } else {
-    cfg.returnValues(path + " address", addrs);
+    vyatta::Config::returnValues(intfs, path + " address", addrs);
   }
 
-  int count = 0;
-  for (size_t i = 0; i < addrs.size(); i ++) {
-    if (addrs[i] == ip) {
-      count ++;
+  BOOST_FOREACH (const string& addr, addrs) {
+    vector<string>& owners = idx[addr];
+    /*
+     * same interface may be reached more than once (e.g., serial), and
+     * not necessarily right after itself
+     */
+    if (std::find(owners.begin(), owners.end(), path) == owners.end()) {
+      owners.push_back(path);
     }
   }
-  return count;
-}
-
-static bool
-check_addresses(vyatta::Config& cfg, const string& path,
-                boost::unordered_map<string, int>& amap,
-                const bool exit = true)
-{
-  bool is_uniq = true;
-  vector<string> addrs;
-
-  if (path.find("openvpn") != std::string::npos) {
-    cfg.listNodes(path + " local-address", addrs); 
-  } else {
-    cfg.returnValues(path + " address", addrs);
-  }
-
-  for (size_t i = 0; i < addrs.size(); i ++) {
-    boost::unordered_map<string, int>::iterator it = amap.find(addrs[i]);
-    if (it == amap.end()) {
-      continue;
-    }
-    it->second += 1;
-    if (it->second > 1) {
-      is_uniq = false;
-      if (exit) {
-        break;
-      }
-    }
-  }
-  return is_uniq;
 }
 
 vyatta::Interface::Interface(const string& name)
@@ -171,11 +153,14 @@ vyatta::Interface::fill_interface(const string& dev, const string& dev_id,
 }
 
 
+/*
+ * path below "interfaces"
+ */
 string
 vyatta::Interface::fill_path(const string& type, const string& name,
                              const string& vifpath, const string& vif)
 {
-  string path = "interfaces " + type;
+  string path = type;
   if (!name.empty()) {
    path += " " + name;
     if (!vifpath.empty()) {
@@ -189,17 +174,29 @@ vyatta::Interface::fill_path(const string& type, const string& name,
 }
 
 /*
- * check to see if an address is unique in the working configuration
+ * build the address index from a single read of the "interfaces" subtree
  */
-bool
-vyatta::Interface::is_uniq_address(const string& ip)
+void
+vyatta::Interface::build_address_index(AddrIndexT& idx)
 {
-  int count = 0;
-  string path;
   vyatta::Config cfg;
+  vyatta::Config::SubtreeT subtree = cfg.getSubtree("interfaces");
+  build_address_index(subtree.get(), idx);
+}
+
+void
+vyatta::Interface::build_address_index(const cnode::CfgNode *intfs,
+                                       AddrIndexT& idx)
+{
+  string path;
   vector<string> eths;
 
-  cfg.listNodes("interfaces ethernet", eths);
+  idx.clear();
+  if (!intfs) {
+    return;
+  }
+
+  vyatta::Config::listNodes(intfs, "ethernet", eths);
 
   vyatta_intf_t* intf = _intfs;
   while (intf->dev) {
@@ -208,27 +205,21 @@ vyatta::Interface::is_uniq_address(const string& ip)
       tifs = eths;
     } else {
       path = fill_path(intf->type);
-      cfg.listNodes(path, tifs);
+      vyatta::Config::listNodes(intfs, path, tifs);
     }
     BOOST_FOREACH (const string& tif, tifs) {
       //'path' => "interfaces $type $tif"
       path = fill_path(intf->type, tif);
-      count += check_address(cfg, path, ip);
-      if (count > 1) {
-        return false;
-      }
+      index_addresses(intfs, path, idx);
 
       if (intf->vifpath) {
         vector<string> vnums;
         path = fill_path(intf->type, tif, intf->vifpath);
-        cfg.listNodes(path, vnums);
+        vyatta::Config::listNodes(intfs, path, vnums);
         BOOST_FOREACH (const string& vnum, vnums) {
           // 'path' => "interfaces $type $tif $vpath $vnum"
           path = fill_path(intf->type, tif, intf->vifpath, vnum);
-          count += check_address(cfg, path, ip);
-          if (count > 1) {
-            return false;
-          }
+          index_addresses(intfs, path, idx);
         }
       }
     }
@@ -238,149 +229,82 @@ vyatta::Interface::is_uniq_address(const string& ip)
   // now special case for pppo*
   BOOST_FOREACH (const string& eth, eths) {
     vector<string> eps;
-    path = "interfaces ethernet " + eth + " pppoe";
-    cfg.listNodes(path, eps);
+    path = "ethernet " + eth + " pppoe";
+    vyatta::Config::listNodes(intfs, path, eps);
     BOOST_FOREACH (const string& ep, eps) {
       // 'path' => "interfaces ethernet $eth pppoe $ep"
-      string p = path + " " + ep;
-      count += check_address(cfg, p, ip);
-      if (count > 1) {
-        return false;
-      }
+      index_addresses(intfs, path + " " + ep, idx);
     }
   }
 
   // now special case for adsl
   vector<string> as;
-  cfg.listNodes("interfaces adsl", as);
+  vyatta::Config::listNodes(intfs, "adsl", as);
   BOOST_FOREACH (const string& a, as) {
     vector<string> ps;
-    cfg.listNodes("interfaces adsl " + a + " pvc", ps);
+    vyatta::Config::listNodes(intfs, "adsl " + a + " pvc", ps);
     BOOST_FOREACH (const string& p, ps) {
       vector<string> ts;
-      cfg.listNodes("interfaces adsl " + a + " pvc " + p, ts);
+      string ppath = "adsl " + a + " pvc " + p;
+      vyatta::Config::listNodes(intfs, ppath, ts);
       BOOST_FOREACH (const string& t, ts) {
         if (t == "classical-ipoa" or t == "bridged-ethernet") {
           // classical-ipoa or bridged-ethernet
           // 'path' => "interfaces adsl $a pvc $p $t"
-          count += check_address(cfg,
-                                 "interfaces adsl " + a + " pvc " + p + " " + t,
-                                 ip);
-          if (count > 1) {
-            return false;
-          }
+          index_addresses(intfs, ppath + " " + t, idx);
           continue;
         }
         // pppo[ea]
         // 'path' => "interfaces adsl $a pvc $p $t $i"
         vector<string> iss;
-        cfg.listNodes("interfaces adsl " + a + " pvc " + p + " " + t, iss);
+        vyatta::Config::listNodes(intfs, ppath + " " + t, iss);
         BOOST_FOREACH (const string& i, iss) {
-          count += check_address(cfg,
-                                 "interfaces adsl " + a + " pvc " + p + " " + t + " " + i,
-                                 ip);
-          if (count > 1) {
-            return false;
-          }
+          index_addresses(intfs, ppath + " " + t + " " + i, idx);
         }
       }
     }
   }
-  return true;
 }
 
-bool
-vyatta::Interface::is_uniq_address(const vector<string>& ips)
+/*
+ * the index is kept for the duration of a commit (the working config
+ * doesn't change during commit). outside a commit it is rebuilt on
+ * every lookup. it is read-only: nothing in this library changes the
+ * "interfaces" config (the netlink helpers only change the kernel
+ * state), so it never needs to be invalidated within a commit.
+ */
+const vyatta::Interface::AddrIndexT&
+vyatta::Interface::address_index()
 {
-  string path;
-  vyatta::Config cfg;
-  vector<string> eths;
-  boost::unordered_map<string, int> amap;
-
-  for (size_t i = 0; i < ips.size(); i ++) {
-    amap[ips[i]] = 0;
-  }
-
-  cfg.listNodes("interfaces ethernet", eths);
-
-  vyatta_intf_t* intf = _intfs;
-  while (intf->dev) {
-    vector<string> tifs;
-    if (!strcmp(intf->type, "ethernet")) {
-      tifs = eths;
-    } else {
-      path = fill_path(intf->type);
-      cfg.listNodes(path, tifs);
-    }
-    BOOST_FOREACH (const string& tif, tifs) {
-      path = fill_path(intf->type, tif);
-      //'path' => "interfaces $type $tif"
-      if (!check_addresses(cfg, path, amap)) {
-        return false;
-      }
-
-      if (intf->vifpath) {
-        vector<string> vnums;
-        path = fill_path(intf->type, tif, intf->vifpath);
-        cfg.listNodes(path, vnums);
-        BOOST_FOREACH (const string& vnum, vnums) {
-          // 'path' => "interfaces $type $tif $vpath $vnum"
-          path = fill_path(intf->type, tif, intf->vifpath, vnum);
-          if (!check_addresses(cfg, path, amap)) {
-            return false;
-          }
-        }
-      }
-    }
-    intf ++;
+  const char *sid = getenv("COMMIT_SESSION_ID");
+  if (_addr_index_valid && sid && _addr_index_sid == sid) {
+    return _addr_index;
   }
+  build_address_index(_addr_index);
+  _addr_index_valid = (sid != NULL);
+  _addr_index_sid = (sid ? sid : "");
+  return _addr_index;
+}
 
-  // now special case for pppo*
-  BOOST_FOREACH (const string& eth, eths) {
-    vector<string> eps;
-    path = "interfaces ethernet " + eth + " pppoe";
-    cfg.listNodes(path, eps);
-    BOOST_FOREACH (const string& ep, eps) {
-      // 'path' => "interfaces ethernet $eth pppoe $ep"
-      string p = path + " " + ep;
-      if (!check_addresses(cfg, p, amap)) {
-        return false;
-      }
-    }
-  }
+/*
+ * check to see if an address is unique in the working configuration
+ */
+bool
+vyatta::Interface::is_uniq_address(const string& ip)
+{
+  const AddrIndexT& idx = address_index();
+  AddrIndexT::const_iterator it = idx.find(ip);
+  return (it == idx.end() || it->second.size() <= 1);
+}
 
-  // now special case for adsl
-  vector<string> as;
-  cfg.listNodes("interfaces adsl", as);
-  BOOST_FOREACH (const string& a, as) {
-    vector<string> ps;
-    cfg.listNodes("interfaces adsl " + a + " pvc", ps);
-    BOOST_FOREACH (const string& p, ps) {
-      vector<string> ts;
-      cfg.listNodes("interfaces adsl " + a + " pvc " + p, ts);
-      BOOST_FOREACH (const string& t, ts) {
-        if (t == "classical-ipoa" or t == "bridged-ethernet") {
-          // classical-ipoa or bridged-ethernet
-          // 'path' => "interfaces adsl $a pvc $p $t"
-          if (!check_addresses(cfg,
-                               "interfaces adsl " + a + " pvc " + p + " " + t,
-                               amap)) {
-            return false;
-          }
-          continue;
-        }
-        // pppo[ea]
-        vector<string> iss;
-        cfg.listNodes("interfaces adsl " + a + " pvc " + p + " " + t, iss);
-        // 'path' => "interfaces adsl $a pvc $p $t $i"
-        BOOST_FOREACH (const string& i, iss) {
-          if (!check_addresses(cfg,
-                               "interfaces adsl " + a + " pvc " + p + " " + t + " " + i,
-                               amap)) {
-            return false;
-          }
-        }
-      }
+bool
+vyatta::Interface::is_uniq_address(const vector<string>& ips)
+{
+  const AddrIndexT& idx = address_index();
+  BOOST_FOREACH (const string& ip, ips) {
+    AddrIndexT::const_iterator it = idx.find(ip);
+    if (it != idx.end() && it->second.size() > 1) {
+      return false;
     }
   }
   return true;
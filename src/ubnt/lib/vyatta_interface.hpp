@@ -4,6 +4,13 @@
 #include <string>
 #include <vector>
 
+#include <boost/unordered_map.hpp>
+
+// forward decl
+namespace cnode {
+class CfgNode;
+}
+
 namespace vyatta { // begin namespace vyatta
 
 using namespace std;
@@ -46,6 +53,12 @@ public:
 
   static void listSystemInterfaces(vector<string>& intfs);
 
+  // address -> paths (below "interfaces") of the interfaces that have it
+  typedef boost::unordered_map<string, vector<string> > AddrIndexT;
+  // index of the "interfaces" subtree intfs (may be NULL)
+  static void build_address_index(const cnode::CfgNode *intfs,
+                                  AddrIndexT& idx);
+
 private:
   bool fill_interface(const string& dev, const string& dev_id,
                       const string& vif,
@@ -57,6 +70,9 @@ private:
   string ppp_path() const;
   long flags();
 
+  static const AddrIndexT& address_index();
+  static void build_address_index(AddrIndexT& idx);
+
   static string fill_path(const string& type, const string& name = _dummy,
                           const string& vifpath = _dummy,
                           const string& vif = _dummy);
@@ -69,6 +85,9 @@ private:
   string  _dev_vif;
 
   static const string _dummy;
+  static AddrIndexT _addr_index;
+  static string _addr_index_sid;
+  static bool _addr_index_valid;
 };
 
 } // end namespace vyatta
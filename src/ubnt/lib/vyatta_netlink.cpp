@@ -0,0 +1,496 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <iostream>
+#include <sstream>
+
+#include <errno.h>
+#include <net/if.h>
+#include <netinet/ether.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/if_link.h>
+
+#include "vyatta_netlink.hpp"
+
+using namespace std;
+
+/*
+ * message building helpers. the message is kept in a vector and
+ * addressed by offset since appending may reallocate it.
+ */
+static struct nlmsghdr *
+nl_hdr(vector<char>& msg)
+{
+  return reinterpret_cast<struct nlmsghdr *>(&msg[0]);
+}
+
+static void
+nl_init(vector<char>& msg, unsigned short type, unsigned short flags,
+        const void *body, size_t len)
+{
+  msg.assign(NLMSG_SPACE(len), 0);
+  struct nlmsghdr *nlh = nl_hdr(msg);
+  nlh->nlmsg_len = NLMSG_LENGTH(len);
+  nlh->nlmsg_type = type;
+  nlh->nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK | flags;
+  memcpy(NLMSG_DATA(nlh), body, len);
+}
+
+static size_t
+nl_attr(vector<char>& msg, unsigned short type, const void *data, size_t len)
+{
+  size_t off = NLMSG_ALIGN(nl_hdr(msg)->nlmsg_len);
+  msg.resize(off + RTA_SPACE(len), 0);
+  struct rtattr *rta = reinterpret_cast<struct rtattr *>(&msg[off]);
+  rta->rta_type = type;
+  rta->rta_len = RTA_LENGTH(len);
+  if (len > 0) {
+    memcpy(RTA_DATA(rta), data, len);
+  }
+  nl_hdr(msg)->nlmsg_len = off + RTA_ALIGN(rta->rta_len);
+  return off;
+}
+
+static void
+nl_attr_str(vector<char>& msg, unsigned short type, const string& str)
+{
+  nl_attr(msg, type, str.c_str(), str.size() + 1);
+}
+
+static void
+nl_attr_u32(vector<char>& msg, unsigned short type, uint32_t val)
+{
+  nl_attr(msg, type, &val, sizeof(val));
+}
+
+static size_t
+nl_nest_start(vector<char>& msg, unsigned short type)
+{
+  return nl_attr(msg, type | NLA_F_NESTED, 0, 0);
+}
+
+static void
+nl_nest_end(vector<char>& msg, size_t off)
+{
+  struct rtattr *rta = reinterpret_cast<struct rtattr *>(&msg[off]);
+  rta->rta_len = nl_hdr(msg)->nlmsg_len - off;
+}
+
+static void
+nl_link_init(vector<char>& msg, unsigned short type, unsigned short flags,
+             const string& name, unsigned int change = 0,
+             unsigned int iflags = 0)
+{
+  struct ifinfomsg ifi;
+  memset(&ifi, 0, sizeof(ifi));
+  ifi.ifi_family = AF_UNSPEC;
+  ifi.ifi_change = change;
+  ifi.ifi_flags = iflags;
+  nl_init(msg, type, flags, &ifi, sizeof(ifi));
+  // the kernel looks the link up by name when ifi_index is 0
+  nl_attr_str(msg, IFLA_IFNAME, name);
+}
+
+static bool
+parse_prefix(const string& addr, int& family, unsigned char *buf,
+             size_t& len, unsigned int& plen)
+{
+  size_t pos = addr.find('/');
+  string ip = addr.substr(0, pos);
+
+  family = (ip.find(':') == string::npos ? AF_INET : AF_INET6);
+  len = (family == AF_INET ? 4 : 16);
+  if (inet_pton(family, ip.c_str(), buf) != 1) {
+    return false;
+  }
+  plen = len * 8;
+  if (pos != string::npos) {
+    char *end = 0;
+    const char *s = addr.c_str() + pos + 1;
+    unsigned long l = strtoul(s, &end, 10);
+    if (end == s || *end || l > plen) {
+      return false;
+    }
+    plen = l;
+  }
+  return true;
+}
+
+vyatta::Netlink::Netlink()
+  : _fd(-1), _seq(0)
+{
+}
+
+vyatta::Netlink::~Netlink()
+{
+  if (_fd >= 0) {
+    close(_fd);
+  }
+}
+
+void
+vyatta::Netlink::clear()
+{
+  _reqs.clear();
+  _errors.clear();
+}
+
+bool
+vyatta::Netlink::queue(Request& req, const string& tool, const string& cmd)
+{
+  req.tool = tool;
+  req.cmd = cmd;
+  _reqs.push_back(req);
+  return true;
+}
+
+bool
+vyatta::Netlink::queue_error(const string& cmd, const string& err)
+{
+  _errors.push_back(cmd + ": " + err);
+  return false;
+}
+
+bool
+vyatta::Netlink::linkAdd(const string& name, const string& kind)
+{
+  Request req;
+  nl_link_init(req.msg, RTM_NEWLINK, NLM_F_CREATE | NLM_F_EXCL, name);
+  size_t linkinfo = nl_nest_start(req.msg, IFLA_LINKINFO);
+  nl_attr_str(req.msg, IFLA_INFO_KIND, kind);
+  nl_nest_end(req.msg, linkinfo);
+  return queue(req, "/sbin/ip", "link add name " + name + " type " + kind);
+}
+
+bool
+vyatta::Netlink::linkDel(const string& name)
+{
+  Request req;
+  nl_link_init(req.msg, RTM_DELLINK, 0, name);
+  return queue(req, "/sbin/ip", "link del dev " + name);
+}
+
+bool
+vyatta::Netlink::linkSetUp(const string& name, bool up)
+{
+  Request req;
+  nl_link_init(req.msg, RTM_NEWLINK, 0, name, IFF_UP, (up ? IFF_UP : 0));
+  return queue(req, "/sbin/ip",
+               "link set " + name + (up ? " up" : " down"));
+}
+
+bool
+vyatta::Netlink::linkSetMac(const string& name, const string& mac)
+{
+  string cmd = "link set " + name + " address " + mac;
+  struct ether_addr *ea = ether_aton(mac.c_str());
+  if (!ea) {
+    return queue_error(cmd, "invalid MAC address");
+  }
+
+  Request req;
+  nl_link_init(req.msg, RTM_NEWLINK, 0, name);
+  nl_attr(req.msg, IFLA_ADDRESS, ea->ether_addr_octet, ETH_ALEN);
+  return queue(req, "/sbin/ip", cmd);
+}
+
+bool
+vyatta::Netlink::linkSetMtu(const string& name, unsigned int mtu)
+{
+  ostringstream cmd;
+  cmd << "link set dev " << name << " mtu " << mtu;
+
+  Request req;
+  nl_link_init(req.msg, RTM_NEWLINK, 0, name);
+  nl_attr_u32(req.msg, IFLA_MTU, mtu);
+  return queue(req, "/sbin/ip", cmd.str());
+}
+
+bool
+vyatta::Netlink::linkSetMaster(const string& name, const string& master)
+{
+  string cmd = "link set dev " + name
+               + (master.empty() ? " nomaster" : " master " + master);
+  unsigned int idx = 0;
+  if (!master.empty() && !(idx = if_nametoindex(master.c_str()))) {
+    return queue_error(cmd, "Cannot find device \"" + master + "\"");
+  }
+
+  Request req;
+  nl_link_init(req.msg, RTM_NEWLINK, 0, name);
+  nl_attr_u32(req.msg, IFLA_MASTER, idx);
+  return queue(req, "/sbin/ip", cmd);
+}
+
+bool
+vyatta::Netlink::bridgePortSet(const string& name, long long cost,
+                               long long priority)
+{
+  // one batch line per attribute, as the bridge tool was run before
+  ostringstream cmd;
+  if (cost >= 0) {
+    cmd << "link set dev " << name << " cost " << cost;
+  }
+  if (priority >= 0) {
+    cmd << (cost >= 0 ? "\n" : "")
+        << "link set dev " << name << " priority " << priority;
+  }
+  if (cost < 0 && priority < 0) {
+    return true;
+  }
+
+  // AF_BRIDGE setlink needs the index, the name is not looked up
+  unsigned int idx = if_nametoindex(name.c_str());
+  if (!idx) {
+    return queue_error(cmd.str(), "Cannot find device \"" + name + "\"");
+  }
+
+  Request req;
+  struct ifinfomsg ifi;
+  memset(&ifi, 0, sizeof(ifi));
+  ifi.ifi_family = AF_BRIDGE;
+  ifi.ifi_index = idx;
+  nl_init(req.msg, RTM_SETLINK, 0, &ifi, sizeof(ifi));
+  size_t protinfo = nl_nest_start(req.msg, IFLA_PROTINFO);
+  if (cost >= 0) {
+    nl_attr_u32(req.msg, IFLA_BRPORT_COST, cost);
+  }
+  if (priority >= 0) {
+    uint16_t prio = priority;
+    nl_attr(req.msg, IFLA_BRPORT_PRIORITY, &prio, sizeof(prio));
+  }
+  nl_nest_end(req.msg, protinfo);
+  return queue(req, "/sbin/bridge", cmd.str());
+}
+
+static bool
+addr_req(vector<char>& msg, unsigned short type, unsigned short flags,
+         const string& name, const string& addr, string& err)
+{
+  unsigned char buf[sizeof(struct in6_addr)];
+  int family;
+  size_t len;
+  unsigned int plen;
+
+  if (!parse_prefix(addr, family, buf, len, plen)) {
+    err = "invalid address \"" + addr + "\"";
+    return false;
+  }
+  unsigned int idx = if_nametoindex(name.c_str());
+  if (!idx) {
+    err = "Cannot find device \"" + name + "\"";
+    return false;
+  }
+
+  struct ifaddrmsg ifa;
+  memset(&ifa, 0, sizeof(ifa));
+  ifa.ifa_family = family;
+  ifa.ifa_prefixlen = plen;
+  ifa.ifa_index = idx;
+  nl_init(msg, type, flags, &ifa, sizeof(ifa));
+  nl_attr(msg, IFA_LOCAL, buf, len);
+  nl_attr(msg, IFA_ADDRESS, buf, len);
+  return true;
+}
+
+bool
+vyatta::Netlink::addrAdd(const string& name, const string& addr)
+{
+  string err, cmd = "addr add " + addr + " dev " + name;
+  Request req;
+  if (!addr_req(req.msg, RTM_NEWADDR, NLM_F_CREATE | NLM_F_EXCL,
+                name, addr, err)) {
+    return queue_error(cmd, err);
+  }
+  return queue(req, "/sbin/ip", cmd);
+}
+
+bool
+vyatta::Netlink::addrDel(const string& name, const string& addr)
+{
+  string err, cmd = "addr del " + addr + " dev " + name;
+  Request req;
+  if (!addr_req(req.msg, RTM_DELADDR, 0, name, addr, err)) {
+    return queue_error(cmd, err);
+  }
+  return queue(req, "/sbin/ip", cmd);
+}
+
+bool
+vyatta::Netlink::open()
+{
+  if (_fd >= 0) {
+    return true;
+  }
+  _fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+  if (_fd < 0) {
+    return false;
+  }
+  struct sockaddr_nl sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.nl_family = AF_NETLINK;
+  if (bind(_fd, reinterpret_cast<struct sockaddr *>(&sa), sizeof(sa)) < 0) {
+    close(_fd);
+    _fd = -1;
+    return false;
+  }
+  _seq = time(0);
+  return true;
+}
+
+/*
+ * send the queued requests in one message and wait for all ACKs.
+ * status[i] is 0 or the negative errno of request i. returns the
+ * number of failed requests.
+ */
+size_t
+vyatta::Netlink::send_batch(vector<int>& status)
+{
+  size_t n = _reqs.size();
+  unsigned int base = _seq;
+  vector<char> buf;
+
+  for (size_t i = 0; i < n; i++) {
+    struct nlmsghdr *nlh = nl_hdr(_reqs[i].msg);
+    nlh->nlmsg_seq = base + i;
+    buf.insert(buf.end(), _reqs[i].msg.begin(),
+               _reqs[i].msg.begin() + NLMSG_ALIGN(nlh->nlmsg_len));
+  }
+  _seq += n;
+
+  // requests that are never acknowledged count as failed
+  status.assign(n, -ETIMEDOUT);
+
+  struct sockaddr_nl sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.nl_family = AF_NETLINK;
+  if (sendto(_fd, &buf[0], buf.size(), 0,
+             reinterpret_cast<struct sockaddr *>(&sa), sizeof(sa)) < 0) {
+    status.assign(n, -errno);
+    return n;
+  }
+
+  size_t acked = 0;
+  char rbuf[32768];
+  while (acked < n) {
+    ssize_t len = recv(_fd, rbuf, sizeof(rbuf), 0);
+    if (len < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    if (len == 0) {
+      break;
+    }
+    for (struct nlmsghdr *nlh = reinterpret_cast<struct nlmsghdr *>(rbuf);
+         NLMSG_OK(nlh, static_cast<unsigned int>(len));
+         nlh = NLMSG_NEXT(nlh, len)) {
+      if (nlh->nlmsg_type != NLMSG_ERROR) {
+        continue;
+      }
+      unsigned int i = nlh->nlmsg_seq - base;
+      if (i >= n) {
+        continue;
+      }
+      struct nlmsgerr *e = reinterpret_cast<struct nlmsgerr *>(NLMSG_DATA(nlh));
+      status[i] = e->error;
+      acked++;
+    }
+  }
+
+  size_t failed = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (status[i]) {
+      failed++;
+    }
+  }
+  return failed;
+}
+
+/*
+ * replay the queued requests through the command line tools, one
+ * batch per run of consecutive requests for the same tool.
+ */
+size_t
+vyatta::Netlink::replay()
+{
+  size_t failed = 0;
+  size_t i = 0;
+  while (i < _reqs.size()) {
+    const string& tool = _reqs[i].tool;
+    string cmd;
+    size_t cnt = 0;
+    for (; i < _reqs.size() && _reqs[i].tool == tool; i++, cnt++) {
+      cmd += _reqs[i].cmd + "\n";
+    }
+
+    string pipe_cmd = "sudo " + tool + " -batch - ";
+    FILE *pipe = popen(pipe_cmd.c_str(), "w");
+    if (!pipe) {
+      _errors.push_back(pipe_cmd + ": cannot open pipe");
+      failed += cnt;
+      continue;
+    }
+    if (fwrite(cmd.c_str(), cmd.size(), 1, pipe) != 1) {
+      _errors.push_back(pipe_cmd + ": pipe is broken");
+    }
+    int rc = pclose(pipe);
+    if (rc) {
+      ostringstream err;
+      err << cmd << " failed:";
+      if (rc == -1) {
+        err << errno << "(" << strerror(errno) << ")";
+      } else {
+        err << WEXITSTATUS(rc);
+      }
+      _errors.push_back(err.str());
+      failed += cnt;
+    }
+  }
+  return failed;
+}
+
+size_t
+vyatta::Netlink::commit()
+{
+  size_t failed = _errors.size();
+  if (_reqs.empty()) {
+    return failed;
+  }
+
+  vector<int> status;
+  if (!open()) {
+    // no usable rtnetlink socket, leave it to the tools
+    failed += replay();
+  } else {
+    size_t nfail = send_batch(status);
+    size_t eperm = 0;
+    for (size_t i = 0; i < status.size(); i++) {
+      if (status[i] == -EPERM) {
+        eperm++;
+      }
+    }
+    if (nfail > 0 && eperm == nfail && nfail == _reqs.size()) {
+      // not privileged, nothing was applied. go through sudo.
+      failed += replay();
+    } else {
+      for (size_t i = 0; i < status.size(); i++) {
+        if (status[i]) {
+          _errors.push_back(_reqs[i].cmd + ": RTNETLINK answers: "
+                            + strerror(-status[i]));
+        }
+      }
+      failed += nfail;
+    }
+  }
+
+  _reqs.clear();
+  return failed;
+}
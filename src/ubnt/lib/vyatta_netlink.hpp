@@ -0,0 +1,76 @@
+#ifndef _VYATTA_NETLINK_HPP_
+#define _VYATTA_NETLINK_HPP_
+
+#include <string>
+#include <vector>
+
+namespace vyatta { // begin namespace vyatta
+
+using namespace std;
+
+/*
+ * rtnetlink request batch. requests are queued and then sent to the
+ * kernel in a single sendmsg() by commit(), which collects one ACK per
+ * request. every request also records the equivalent "ip -batch" or
+ * "bridge -batch" line so that the whole batch can be replayed through
+ * "sudo /sbin/ip" when the caller lacks CAP_NET_ADMIN.
+ */
+class Netlink
+{
+public:
+  Netlink();
+  ~Netlink();
+
+  // link requests
+  bool linkAdd(const string& name, const string& kind);
+  bool linkDel(const string& name);
+  bool linkSetUp(const string& name, bool up);
+  bool linkSetMac(const string& name, const string& mac);
+  bool linkSetMtu(const string& name, unsigned int mtu);
+  // empty master releases the link from its master
+  bool linkSetMaster(const string& name, const string& master);
+  // bridge port attributes, negative value leaves the attribute alone
+  bool bridgePortSet(const string& name, long long cost, long long priority);
+
+  // address requests, addr is "address/prefixlen"
+  bool addrAdd(const string& name, const string& addr);
+  bool addrDel(const string& name, const string& addr);
+
+  size_t size() const { return _reqs.size(); }
+  bool empty() const { return _reqs.empty(); }
+  void clear();
+
+  // tool and batch line(s) of queued request i, as replayed by commit()
+  const string& tool(size_t i) const { return _reqs[i].tool; }
+  const string& batchLine(size_t i) const { return _reqs[i].cmd; }
+
+  /*
+   * send all queued requests. returns the number of requests that
+   * failed (0 on success); a message for each failure is available from
+   * errors(). the queue is cleared afterwards.
+   */
+  size_t commit();
+  const vector<string>& errors() const { return _errors; }
+
+private:
+  struct Request {
+    vector<char> msg;
+    string tool; // "/sbin/ip" or "/sbin/bridge"
+    string cmd;  // batch line for the tool
+  };
+
+  bool queue(Request& req, const string& tool, const string& cmd);
+  bool queue_error(const string& cmd, const string& err);
+  bool open();
+  size_t send_batch(vector<int>& status);
+  size_t replay();
+
+  int _fd;
+  unsigned int _seq;
+  vector<Request> _reqs;
+  vector<string> _errors;
+};
+
+} // end namespace vyatta
+
+#endif /* _VYATTA_NETLINK_HPP_ */
@@ -1757,11 +1757,11 @@ update_interface(const string& device, const string& direction,
 }
 
 static bool
-interface_using(vyatta::Config& config, const string& criteria,
+interface_using(const cnode::CfgNode *intfs, const string& criteria,
                 const string& path)
 {
   string val;
-  if (config.returnValue(path, val) && criteria == val) {
+  if (vyatta::Config::returnValue(intfs, path, val) && criteria == val) {
     return true;
   }
   return false;
@@ -1776,15 +1776,20 @@ interfaces_using(const string& policy, vector<string>& intfs,
                  const bool firstOccur)
 {
   vyatta::Config config;
-  vector<string> types, names, vifs;
+  vector<string> types;
 
-  config.listNodes("interfaces", types);
+  // "interfaces <type> <name> vif <vif> traffic-policy <dir>"
+  vyatta::Config::SubtreeT subtree = config.getSubtree("interfaces", false, 6);
+  const cnode::CfgNode *itree = subtree.get();
+
+  vyatta::Config::listNodes(itree, "", types);
   BOOST_FOREACH(const string& type, types) {
-    config.listNodes("interfaces " + type, names);
+    vector<string> names;
+    vyatta::Config::listNodes(itree, type, names);
     BOOST_FOREACH(const string& name, names) {
-      string val;
-      string path("interfaces " + type + " " + name);
-      if (interface_using(config, policy, path + " traffic-policy in")) {
+      vector<string> vifs;
+      string path(type + " " + name);
+      if (interface_using(itree, policy, path + " traffic-policy in")) {
         intfs.push_back(name);
         dirs.push_back("in");
         policies.push_back(policy);
@@ -1792,7 +1797,7 @@ interfaces_using(const string& policy, vector<string>& intfs,
           return true;
         }
       }
-      if (interface_using(config, policy, path + " traffic-policy out")) {
+      if (interface_using(itree, policy, path + " traffic-policy out")) {
         intfs.push_back(name);
         dirs.push_back("out");
         policies.push_back(policy);
@@ -1800,10 +1805,10 @@ interfaces_using(const string& policy, vector<string>& intfs,
           return true;
         }
       }
-      config.listNodes(path + " vif", vifs);
+      vyatta::Config::listNodes(itree, path + " vif", vifs);
       BOOST_FOREACH(const string& vif, vifs) {
         string vif_path = path + " vif " + vif;
-        if (interface_using(config, policy, vif_path + " traffic-policy in")) {
+        if (interface_using(itree, policy, vif_path + " traffic-policy in")) {
           intfs.push_back(name + "." + vif);
           dirs.push_back("in");
           policies.push_back(policy);
@@ -1811,7 +1816,7 @@ interfaces_using(const string& policy, vector<string>& intfs,
             return true;
           }
         }
-        if (interface_using(config, policy, vif_path + " traffic-policy out")) {
+        if (interface_using(itree, policy, vif_path + " traffic-policy out")) {
           intfs.push_back(name + "." + vif);
           dirs.push_back("out");
           policies.push_back(policy);
@@ -1883,18 +1888,24 @@ apply_policy(const string& name)
 static bool
 find_dev_path(vyatta::Config& config, const string& dev, string& dev_path)
 {
-  vector<string> types, names, vifs;
+  vector<string> types;
+
+  // "interfaces <type> <name> vif <vif>"
+  vyatta::Config::SubtreeT subtree = config.getSubtree("interfaces", false, 4);
+  const cnode::CfgNode *itree = subtree.get();
 
-  config.listNodes("interfaces", types);
+  vyatta::Config::listNodes(itree, "", types);
   BOOST_FOREACH(const string& type, types) {
-    config.listNodes("interfaces " + type, names);
+    vector<string> names;
+    vyatta::Config::listNodes(itree, type, names);
     BOOST_FOREACH(const string& name, names) {
+      vector<string> vifs;
       string path = "interfaces " + type + " " + name;
       if (dev == name) {
         dev_path = path;
         return true;
       }
-      config.listNodes(path + " vif", vifs);
+      vyatta::Config::listNodes(itree, type + " " + name + " vif", vifs);
       BOOST_FOREACH(const string& vif, vifs) {
         if (dev == name + "." + vif) {
           dev_path = path + " vif " + vif;
@@ -1972,30 +1983,35 @@ static bool
 interfaces_refer(const string& dev, string& intf)
 {
   vyatta::Config config;
-  vector<string> types, names, vifs;
+  vector<string> types;
+
+  // "interfaces <type> <name> vif <vif> {redirect|mirror}"
+  vyatta::Config::SubtreeT subtree = config.getSubtree("interfaces", false, 5);
+  const cnode::CfgNode *itree = subtree.get();
 
-  config.listNodes("interfaces", types);
+  vyatta::Config::listNodes(itree, "", types);
   BOOST_FOREACH(const string& type, types) {
-    config.listNodes("interfaces " + type, names);
+    vector<string> names;
+    vyatta::Config::listNodes(itree, type, names);
     BOOST_FOREACH(const string& name, names) {
-      string val;
-      string path("interfaces " + type + " " + name);
-      if (interface_using(config, dev, path + " redirect")) {
+      vector<string> vifs;
+      string path(type + " " + name);
+      if (interface_using(itree, dev, path + " redirect")) {
         intf = name;
         return true;
       }
-      if (interface_using(config, dev, path + " mirror")) {
+      if (interface_using(itree, dev, path + " mirror")) {
         intf = name;
         return true;
       }
-      config.listNodes(path + " vif", vifs);
+      vyatta::Config::listNodes(itree, path + " vif", vifs);
       BOOST_FOREACH(const string& vif, vifs) {
         string vif_path = path + " vif " + vif;
-        if (interface_using(config, dev, vif_path + " redirect")) {
+        if (interface_using(itree, dev, vif_path + " redirect")) {
           intf = name + "." + vif;
           return true;
         }
-        if (interface_using(config, dev, vif_path + " mirror")) {
+        if (interface_using(itree, dev, vif_path + " mirror")) {
           intf = name + "." + vif;
           return true;
         }
@@ -5,57 +5,27 @@
 
 #include "lib/vyatta_interface.hpp"
 #include "lib/vyatta_config.hpp"
+#include "lib/vyatta_netlink.hpp"
 
 #include <boost/filesystem.hpp>
 
 using namespace std;
 typedef vyatta::Interface InterfaceT;
 
+/*
+ * send the queued requests and report any failures
+ */
 static int
-system_pipe(const string& cmd,
-            const string& tool,
-            const string& msg)
+commit_netlink(vyatta::Netlink& nl)
 {
-  int ret = EXIT_SUCCESS;
-
-  string pipe_cmd = "sudo " + tool + " -batch - ";
-  errno = 0;
-  FILE* pipe = popen(pipe_cmd.c_str(), "w");
-  if (!pipe) {
-    cerr << msg << ": cannot open pipe" << endl;
-    return EXIT_FAILURE;
-  }
-  size_t size = fwrite(cmd.c_str(), cmd.size(), 1, pipe);
-  if (size != 1) {
-    cerr << msg << ": pipe is broken" << endl;
-    ret = EXIT_FAILURE;
+  if (!nl.commit()) {
+    return EXIT_SUCCESS;
   }
-  int rc = pclose(pipe);
-  if (rc) {
-    cerr << cmd << " failed:";
-    if (rc == -1) {
-      rc = EXIT_FAILURE;
-      cerr << errno << "(" << strerror(errno) << ")";
-    } else {
-      rc = WEXITSTATUS(rc);
-      cerr << WEXITSTATUS(rc);
-    }
-    cerr << endl;
-    ret = rc;
+  const vector<string>& errs = nl.errors();
+  for (size_t i = 0; i < errs.size(); i ++) {
+    cerr << errs[i] << endl;
   }
-  return ret;
-}
-
-static int
-system_ip(const string& cmd)
-{
-  return system_pipe(cmd, "/sbin/ip", "IP");
-}
-
-static int
-system_bridge(const string& cmd)
-{
-  return system_pipe(cmd, "/sbin/bridge", "Bridge");
+  return EXIT_FAILURE;
 }
 
 static int
@@ -74,10 +44,11 @@ delete_bridge(const string& ifname)
     }
   }
 
-  string cmd = "link set " + ifname + " down\n";
-  cmd += "link del dev " + ifname;
+  vyatta::Netlink nl;
+  nl.linkSetUp(ifname, false);
+  nl.linkDel(ifname);
 
-  return system_ip(cmd);
+  return commit_netlink(nl);
 }
 
 static int
@@ -109,28 +80,19 @@ add_bridge_port(const string& bridge,
   cout << "Adding interface " << ifname <<
           " to bridge " << bridge << endl;
 
-  string cmd = "link set dev " + ifname + " master " + bridge;
-  int ret = system_ip(cmd);
-  if (ret) {
+  vyatta::Netlink nl;
+  nl.linkSetMaster(ifname, bridge);
+  if (commit_netlink(nl)) {
     return EXIT_FAILURE;
   }
 
-  cmd = "";
   config.returnValue("bridge-group cost", cost);
-  if (cost.length()) {
-    cmd += "link set dev " + ifname + " cost " + cost + "\n";
-  }
-
   config.returnValue("bridge-group priority", priority);
-  if (priority.length()) {
-    cmd += "link set dev " + ifname + " priority " + priority + "\n";
-  }
-
-  if (!cmd.empty()) {
-    return system_bridge(cmd);
-  }
+  nl.bridgePortSet(ifname,
+                   (cost.length() ? strtoll(cost.c_str(), 0, 10) : -1),
+                   (priority.length() ? strtoll(priority.c_str(), 0, 10) : -1));
 
-  return EXIT_SUCCESS;
+  return commit_netlink(nl);
 }
 
 static int
@@ -156,13 +118,10 @@ remove_bridge_port(const string& ifname,
   }
 #endif
 
-  string cmd = "link set dev " + ifname + " nomaster";
-  int ret = system_ip(cmd.c_str());
-  if (ret) {
-    return EXIT_FAILURE;
-  }
+  vyatta::Netlink nl;
+  nl.linkSetMaster(ifname, "");
 
-  return EXIT_SUCCESS;
+  return commit_netlink(nl);
 }
 
 static int
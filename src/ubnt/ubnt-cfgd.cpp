@@ -11,21 +11,26 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <sys/file.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/signalfd.h>
+#include <signal.h>
+#include <poll.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <grp.h>
+#include <dirent.h>
+#include <time.h>
 
-#include <boost/bind.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/asio.hpp>
-#include <boost/unordered_set.hpp>
 #include <boost/foreach.hpp>
-#include <boost/thread.hpp>
-#include <boost/thread/locks.hpp>
 #include <boost/archive/binary_iarchive.hpp>
 #include <boost/archive/binary_oarchive.hpp>
 #include <boost/serialization/string.hpp>
 #include <boost/serialization/vector.hpp>
 #include <boost/serialization/map.hpp>
-#include <boost/thread/mutex.hpp>
 
 #include <cli_cstore.h>
 #include <cstore/cstore.hpp>
@@ -35,6 +40,9 @@
 
 #define CFGD_SOCKET_PATH "/tmp/ubnt.socket.cfgd"
 #define ACTIVE_ONLY_SID "ACTIVE_ONLY"
+#define CFGD_STATS_PATH "/tmp/ubnt.cfgd.stats"
+#define CFGD_RUN_DIR "/var/run/cfgd"
+#define CFGD_JOBS_DIR CFGD_RUN_DIR "/jobs"
 
 enum {
     CFGD_GET_TMPL = 0,
@@ -64,6 +72,14 @@ enum {
     CFGD_GET_VALUE_E,
     CFGD_LOAD_DEFCFG,
     CFGD_GET_TMPL_CHILDREN,
+    CFGD_GET_SUBTREE,
+    CFGD_GET_SUBTREE_W,
+    CFGD_GET_SUBTREE_STATUS_W,
+    CFGD_COMMIT_JOB,
+    CFGD_JOB_SUBSCRIBE,
+    CFGD_JOB_POLL,
+    CFGD_JOB_CANCEL,
+    CFGD_SAVE_IF_CHANGED,
     CFGD_INVALID
 };
 
@@ -78,6 +94,39 @@ static MapT<string, cstore_ptr_t> cs_cache;
 
 static const size_t _max_req_size = 2097152;
 
+// worker -> daemon messages on the worker channel
+enum {
+    CFGD_WMSG_READY = 0,
+    CFGD_WMSG_FIRST_BYTE
+};
+
+typedef struct {
+    unsigned int type;
+    unsigned int usec;
+} cfgd_wmsg_t;
+
+// worker side of the channel and when the daemon accepted our connection
+static int _wchan = -1;
+static struct timeval _waccepted;
+
+static void
+report_first_byte()
+{
+    if (_wchan < 0) {
+        return;
+    }
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    long long us = (now.tv_sec - _waccepted.tv_sec) * 1000000LL
+                   + (now.tv_usec - _waccepted.tv_usec);
+    cfgd_wmsg_t m = { CFGD_WMSG_FIRST_BYTE,
+                      static_cast<unsigned int>(us < 0 ? 0 : us) };
+    send(_wchan, &m, sizeof(m), MSG_NOSIGNAL);
+    // only the first response is of interest
+    close(_wchan);
+    _wchan = -1;
+}
+
 class ProcReqEnv {
 public:
     ProcReqEnv(const string& sid) {
@@ -102,6 +151,549 @@ private:
 
 const string ProcReqEnv::SID_ENV_STR = "UBNT_CFGD_PROC_REQ_SID";
 
+/*
+ * flatten a subtree into "set"-style paths relative to the subtree root,
+ * i.e., one path per leaf value and one per empty typeless/tag node.
+ */
+static void
+get_subtree_paths(const cnode::CfgNode& node, vector<string>& cur,
+                  vector<vector<string> >& paths, bool is_root = true)
+{
+    size_t lvl = cur.size();
+    if (!is_root) {
+        cur.push_back(node.isValue() && !node.isLeaf()
+                      ? node.getValue() : node.getName());
+    }
+    if (node.isLeaf()) {
+        if (node.isMulti()) {
+            const vector<string>& vals = node.getValues();
+            for (size_t i = 0; i < vals.size(); i++) {
+                paths.push_back(cur);
+                paths.back().push_back(vals[i]);
+            }
+        } else {
+            paths.push_back(cur);
+            paths.back().push_back(node.getValue());
+        }
+    } else if (node.numChildNodes() == 0) {
+        if (!is_root) {
+            paths.push_back(cur);
+        }
+    } else {
+        const vector<cnode::CfgNode *>& cnodes = node.getChildNodes();
+        for (size_t i = 0; i < cnodes.size(); i++) {
+            get_subtree_paths(*(cnodes[i]), cur, paths, false);
+        }
+    }
+    cur.resize(lvl);
+}
+
+/*
+ * in-memory capture of the output of cstore operations. the capture
+ * replaces out_stream for its lifetime and is reused for all the paths of
+ * a set/delete batch: mark() starts a new message and take() returns the
+ * output since the last mark(). the buffer is started over once it grows
+ * beyond CAPTURE_MAX so that a large batch does not keep all the output.
+ */
+class OutputCapture {
+public:
+    OutputCapture()
+        : _oout(out_stream), _f(NULL), _buf(NULL), _size(0), _mark(0) {
+        reopen();
+    }
+    ~OutputCapture() {
+        out_stream = _oout;
+        close();
+    }
+
+    void mark() {
+        if (!_f) {
+            return;
+        }
+        fflush(_f);
+        if (_size > CAPTURE_MAX) {
+            reopen();
+        }
+        _mark = _size;
+    }
+    string take() {
+        if (!_f) {
+            return "";
+        }
+        fflush(_f);
+        return string(_buf + _mark, _size - _mark);
+    }
+
+private:
+    static const size_t CAPTURE_MAX = 65536;
+
+    void close() {
+        if (_f) {
+            fclose(_f);
+            _f = NULL;
+        }
+        free(_buf);
+        _buf = NULL;
+        _size = _mark = 0;
+    }
+    void reopen() {
+        close();
+        _f = open_memstream(&_buf, &_size);
+        /* if this fails, output goes to the original stream and the
+         * default messages are used.
+         */
+        out_stream = (_f ? _f : _oout);
+    }
+
+    FILE *_oout;
+    FILE *_f;
+    char *_buf;
+    size_t _size;
+    size_t _mark;
+};
+
+// per-path messages of a set batch validation, using the capture
+class BatchMessages : public Cstore::BatchOutput {
+public:
+    BatchMessages(OutputCapture& cap) : _cap(cap) {}
+
+    void start() { _cap.mark(); }
+    void end(size_t idx) { _msgs[idx] = _cap.take(); }
+    string get(size_t idx) const {
+        map<size_t, string>::const_iterator it = _msgs.find(idx);
+        return (it == _msgs.end() ? "" : it->second);
+    }
+
+private:
+    OutputCapture& _cap;
+    map<size_t, string> _msgs;
+};
+
+static void
+read_tmpfile(FILE *tf, string& data)
+{
+    char buf[4096];
+    size_t n;
+    fseek(tf, 0, SEEK_SET);
+    while ((n = fread(buf, 1, sizeof(buf), tf)) > 0) {
+        data.append(buf, n);
+    }
+}
+
+/*
+ * commit jobs. CFGD_COMMIT_JOB starts the commit in a separate process and
+ * returns a job id right away. since a worker only lives for one session,
+ * the job process is detached and all job state is in the job directory
+ * so that any later session can follow it:
+ *   events  one line per event:
+ *             start <priority> <path>
+ *             finish <priority> <path> <msec>
+ *             fail <priority> <path> <msec>
+ *             cancel
+ *             done <state> <msec>
+ *   output  output of the commit (including scripts)
+ *   state   final state (success, partial, failure, cancelled). only
+ *           exists once the job is done.
+ *   cancel  created to request cancellation. the priority subtrees that
+ *           have not been committed at that point are skipped (failed).
+ *   pid     pid of the job process
+ *   session id of the session being committed
+ *
+ * the job directories are only accessible by the daemon (see
+ * check_jobs_dir()), and job files are never opened through a symlink.
+ */
+static const unsigned int _job_max_wait_ms = 30000;
+static const size_t _job_max_chunk = 65536;
+static const time_t _job_max_age = 3600;
+
+class CommitJobObserver : public commit::CommitObserver {
+public:
+    CommitJobObserver(const string& dir, FILE *events)
+        : _dir(dir), _events(events), _cancelled(false) {}
+
+    void prioStart(commit::PrioNode& pnode) {
+        fprintf(_events, "start %u %s\n", pnode.getPriority(),
+                pnode.getCommitPath().to_string().c_str());
+    }
+    void prioEnd(commit::PrioNode& pnode, bool success, unsigned long msec) {
+        fprintf(_events, "%s %u %s %lu\n", (success ? "finish" : "fail"),
+                pnode.getPriority(),
+                pnode.getCommitPath().to_string().c_str(), msec);
+    }
+    bool cancelRequested() {
+        if (!_cancelled && access((_dir + "/cancel").c_str(), F_OK) == 0) {
+            _cancelled = true;
+            fprintf(_events, "cancel\n");
+        }
+        return _cancelled;
+    }
+    bool cancelled() const { return _cancelled; }
+
+private:
+    string _dir;
+    FILE *_events;
+    bool _cancelled;
+};
+
+static bool
+valid_job_id(const string& id)
+{
+    return (!id.empty() && id[0] != '.' && id.find('/') == string::npos);
+}
+
+// create dir if necessary and make sure it is a private directory
+static bool
+check_private_dir(const char *dir)
+{
+    if (mkdir(dir, 0700) != 0 && errno != EEXIST) {
+        return false;
+    }
+    struct stat st;
+    return (lstat(dir, &st) == 0 && S_ISDIR(st.st_mode)
+            && st.st_uid == geteuid() && (st.st_mode & 022) == 0);
+}
+
+static bool
+check_jobs_dir()
+{
+    return (check_private_dir(CFGD_RUN_DIR)
+            && check_private_dir(CFGD_JOBS_DIR));
+}
+
+static FILE *
+open_job_file(const string& file, int flags, const char *mode)
+{
+    int fd = open(file.c_str(), flags | O_NOFOLLOW | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return NULL;
+    }
+    FILE *f = fdopen(fd, mode);
+    if (!f) {
+        close(fd);
+    }
+    return f;
+}
+
+static bool
+read_job_file(const string& file, string& data, size_t off = 0,
+              size_t max = 0)
+{
+    FILE *f = open_job_file(file, O_RDONLY, "r");
+    if (!f) {
+        return false;
+    }
+    if (off > 0 && fseek(f, off, SEEK_SET) != 0) {
+        fclose(f);
+        return false;
+    }
+    char buf[4096];
+    size_t n;
+    while ((max == 0 || data.size() < max)
+           && (n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        data.append(buf, n);
+    }
+    fclose(f);
+    if (max > 0 && data.size() > max) {
+        data.resize(max);
+    }
+    return true;
+}
+
+static void
+write_job_file(const string& file, const string& data)
+{
+    string tfile = file + ".tmp";
+    unlink(tfile.c_str());
+    FILE *f = open_job_file(tfile, O_WRONLY | O_CREAT | O_EXCL, "w");
+    if (f) {
+        fputs(data.c_str(), f);
+        fclose(f);
+        rename(tfile.c_str(), file.c_str());
+    }
+}
+
+// remove finished jobs that are older than _job_max_age
+static void
+cleanup_jobs()
+{
+    DIR *d = opendir(CFGD_JOBS_DIR);
+    if (!d) {
+        return;
+    }
+    static const char *files[] = { "events", "output", "state", "cancel",
+                                   "pid", "session", NULL };
+    time_t now = time(NULL);
+    struct dirent *de;
+    while ((de = readdir(d))) {
+        if (!valid_job_id(de->d_name)) {
+            continue;
+        }
+        string dir = string(CFGD_JOBS_DIR) + "/" + de->d_name;
+        struct stat st;
+        if (lstat((dir + "/state").c_str(), &st) != 0
+            || now - st.st_mtime < _job_max_age) {
+            continue;
+        }
+        for (size_t i = 0; files[i]; i++) {
+            unlink((dir + "/" + files[i]).c_str());
+        }
+        rmdir(dir.c_str());
+    }
+    closedir(d);
+}
+
+// body of the job process
+static void
+run_commit_job(Cstore& cs, const string& dir, bool load_defcfg)
+{
+    FILE *events = open_job_file(dir + "/events", O_WRONLY | O_APPEND, "a");
+    FILE *output = open_job_file(dir + "/output", O_WRONLY | O_APPEND, "a");
+    if (!events || !output) {
+        write_job_file(dir + "/state", "failure\n");
+        return;
+    }
+    setvbuf(events, NULL, _IOLBF, 0);
+    setvbuf(output, NULL, _IOLBF, 0);
+    // script output goes to the job output as well
+    fflush(stdout);
+    fflush(stderr);
+    dup2(fileno(output), 1);
+    dup2(fileno(output), 2);
+    out_stream = output;
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    const char *state = "failure";
+    CommitJobObserver obs(dir, events);
+    if (load_defcfg
+        && !cs.loadFile("/opt/vyatta/etc/config.boot.default")) {
+        fprintf(output, "Failed to load default config\n");
+    } else {
+        Cpath dummy;
+        cs.preloadTemplatesIfEnabled();
+        cnode::CfgNode aroot(cs, dummy, true, true);
+        cnode::CfgNode wroot(cs, dummy, false, true);
+        if (commit::doCommit(cs, aroot, wroot, &obs)) {
+            state = "success";
+        } else {
+            char *e = getenv("COMMIT_STATUS");
+            if (e && strcmp(e, "PARTIAL") == 0) {
+                state = "partial";
+            }
+        }
+        if (obs.cancelled()) {
+            state = "cancelled";
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    unsigned long msec = ((t1.tv_sec - t0.tv_sec) * 1000
+                          + (t1.tv_nsec - t0.tv_nsec) / 1000000);
+    fprintf(events, "done %s %lu\n", state, msec);
+    fflush(output);
+    write_job_file(dir + "/state", string(state) + "\n");
+}
+
+static string get_job_state(const string& dir);
+
+/*
+ * lock serializing job creation against the checks for running jobs of a
+ * session. released when the returned fd is closed.
+ */
+static int
+lock_jobs()
+{
+    if (!check_jobs_dir()) {
+        return -1;
+    }
+    int fd = open(CFGD_JOBS_DIR "/.lock",
+                  O_RDWR | O_CREAT | O_NOFOLLOW | O_CLOEXEC, 0600);
+    if (fd >= 0 && flock(fd, LOCK_EX) != 0) {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+// whether a job is running for session sid. must hold the jobs lock.
+static bool
+session_has_job(const string& sid)
+{
+    DIR *d = opendir(CFGD_JOBS_DIR);
+    if (!d) {
+        return false;
+    }
+    bool found = false;
+    struct dirent *de;
+    while (!found && (de = readdir(d))) {
+        if (!valid_job_id(de->d_name)) {
+            continue;
+        }
+        string dir = string(CFGD_JOBS_DIR) + "/" + de->d_name;
+        string data;
+        found = (read_job_file(dir + "/session", data) && data == sid
+                 && get_job_state(dir) == "running");
+    }
+    closedir(d);
+    return found;
+}
+
+/*
+ * check that no job is committing session sid before an op that changes
+ * its working config. returns false if one is, and the op must be refused.
+ * otherwise lfd is the jobs lock (or -1 if it cannot be taken, in which
+ * case no job can be started either), which keeps a job from starting for
+ * the session until the op is done and it is released with unlock_jobs().
+ */
+static bool
+lock_session_edit(const string& sid, int& lfd)
+{
+    lfd = lock_jobs();
+    if (lfd >= 0 && session_has_job(sid)) {
+        close(lfd);
+        lfd = -1;
+        return false;
+    }
+    return true;
+}
+
+static void
+unlock_jobs(int& lfd)
+{
+    if (lfd >= 0) {
+        close(lfd);
+        lfd = -1;
+    }
+}
+
+static const char *_job_running_msg
+    = "A commit job is running for this session";
+
+/*
+ * start a commit job for session sid. returns the job id, or an empty
+ * string if the job could not be started. must hold the jobs lock.
+ */
+static string
+start_commit_job(Cstore& cs, const string& sid, bool load_defcfg)
+{
+    cleanup_jobs();
+    char tmpl[] = CFGD_JOBS_DIR "/XXXXXX";
+    if (!mkdtemp(tmpl)) {
+        return "";
+    }
+    string dir(tmpl);
+    string id = dir.substr(dir.rfind('/') + 1);
+    // create the files so that they can be followed right away
+    write_job_file(dir + "/events", "");
+    write_job_file(dir + "/output", "");
+    write_job_file(dir + "/session", sid);
+
+    fflush(NULL);
+    pid_t pid = fork();
+    if (pid < 0) {
+        return "";
+    }
+    if (pid > 0) {
+        /* the intermediate process exits right away, and the job process
+         * is reparented to init, which reaps it. otherwise an exited job
+         * would stay a zombie of the worker and still look "running".
+         */
+        int status;
+        while (waitpid(pid, &status, 0) < 0 && errno == EINTR);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            write_job_file(dir + "/state", "failure\n");
+            return "";
+        }
+        return id;
+    }
+
+    // detach from the session and the worker
+    setsid();
+    for (int fd = getdtablesize() - 1; fd > 2; fd--) {
+        close(fd);
+    }
+    pid = fork();
+    if (pid != 0) {
+        _exit(pid < 0 ? 1 : 0);
+    }
+
+    // job process
+    char pbuf[32];
+    snprintf(pbuf, sizeof(pbuf), "%d\n", getpid());
+    write_job_file(dir + "/pid", pbuf);
+    run_commit_job(cs, dir, load_defcfg);
+    _exit(0);
+}
+
+/*
+ * get the current state of a job:
+ *   "running", one of the final states, "lost" if the job process is gone
+ *   without finishing, or "invalid" if there is no such job.
+ */
+static string
+get_job_state(const string& dir)
+{
+    string data;
+    if (read_job_file(dir + "/state", data)) {
+        return data.substr(0, data.find('\n'));
+    }
+    if (!read_job_file(dir + "/pid", data)) {
+        // not started yet or no such job
+        struct stat st;
+        return (stat(dir.c_str(), &st) == 0 ? "running" : "invalid");
+    }
+    pid_t pid = strtol(data.c_str(), NULL, 10);
+    if (pid <= 0 || (kill(pid, 0) != 0 && errno == ESRCH)) {
+        // check again in case it just finished
+        data.clear();
+        if (read_job_file(dir + "/state", data)) {
+            return data.substr(0, data.find('\n'));
+        }
+        return "lost";
+    }
+    return "running";
+}
+
+/*
+ * get new events and output of a job after the specified offsets. if there
+ * is nothing new and the job is still running, wait up to wait_ms for
+ * something to happen.
+ */
+static void
+subscribe_job(const string& id, size_t eoff, size_t ooff,
+              unsigned int wait_ms, map<string, string>& ret)
+{
+    string dir = string(CFGD_JOBS_DIR) + "/" + id;
+    if (wait_ms > _job_max_wait_ms) {
+        wait_ms = _job_max_wait_ms;
+    }
+    string state, events, output;
+    unsigned int waited = 0;
+    while (true) {
+        state = get_job_state(dir);
+        read_job_file(dir + "/events", events, eoff, _job_max_chunk);
+        read_job_file(dir + "/output", output, ooff, _job_max_chunk);
+        if (state != "running" || !events.empty() || !output.empty()
+            || waited >= wait_ms) {
+            break;
+        }
+        usleep(100000);
+        waited += 100;
+    }
+    // only return complete event lines
+    size_t elen = events.rfind('\n');
+    events.resize(elen == string::npos ? 0 : elen + 1);
+
+    char buf[32];
+    ret["state"] = state;
+    ret["events"] = events;
+    ret["output"] = output;
+    snprintf(buf, sizeof(buf), "%zu", eoff + events.size());
+    ret["events_off"] = buf;
+    snprintf(buf, sizeof(buf), "%zu", ooff + output.size());
+    ret["output_off"] = buf;
+    ret["cancel"] = (access((dir + "/cancel").c_str(), F_OK) == 0 ? "1" : "0");
+}
+
 static void
 process_req(const string& rsid, unsigned int rop,
             iarchive_t& req, iostream& resp_stream)
@@ -112,6 +704,7 @@ process_req(const string& rsid, unsigned int rop,
     vector<vector<string> > vargs;
     Cpath p;
     vector<Cpath> paths;
+    unsigned int depth = 0;
 
     switch (rop) {
     case CFGD_GET_TMPL:
@@ -132,7 +725,18 @@ process_req(const string& rsid, unsigned int rop,
     case CFGD_PATH_CHANGED:
     case CFGD_PATH_EFFECTIVE:
     case CFGD_GET_TMPL_CHILDREN:
+    case CFGD_GET_SUBTREE_STATUS_W:
+    case CFGD_COMMIT_JOB:
+    case CFGD_JOB_SUBSCRIBE:
+    case CFGD_JOB_POLL:
+    case CFGD_JOB_CANCEL:
+        req >> args;
+        p = args;
+        break;
+    case CFGD_GET_SUBTREE:
+    case CFGD_GET_SUBTREE_W:
         req >> args;
+        req >> depth;
         p = args;
         break;
     case CFGD_SET_PATHS:
@@ -147,6 +751,7 @@ process_req(const string& rsid, unsigned int rop,
     case CFGD_COMMIT:
     case CFGD_DISCARD:
     case CFGD_SAVE:
+    case CFGD_SAVE_IF_CHANGED:
     case CFGD_TEARDOWN:
     case CFGD_LOAD_DEFCFG:
         {
@@ -172,6 +777,10 @@ process_req(const string& rsid, unsigned int rop,
         switch (rop) {
         case CFGD_GET_CHILDREN_W:
         case CFGD_GET_CHILDREN_STATUS_W:
+        case CFGD_GET_SUBTREE_W:
+        case CFGD_GET_SUBTREE_STATUS_W:
+        case CFGD_COMMIT_JOB:
+        case CFGD_JOB_CANCEL:
         case CFGD_GET_VALUES_W:
         case CFGD_GET_VALUE_W:
         case CFGD_EXISTS_W:
@@ -186,6 +795,7 @@ process_req(const string& rsid, unsigned int rop,
         case CFGD_COMMIT:
         case CFGD_DISCARD:
         case CFGD_SAVE:
+        case CFGD_SAVE_IF_CHANGED:
         case CFGD_TEARDOWN:
         case CFGD_LOAD_DEFCFG:
             throw boost::system::system_error(
@@ -282,53 +892,69 @@ process_req(const string& rsid, unsigned int rop,
         {
             bool failure = false, success = false;
             map<string, string> ret;
-            for (size_t i = 0; i < paths.size(); i++) {
-                bool fail1 = false;
-                FILE *oout = out_stream;
-                FILE *tf = tmpfile();
-                const char *def_msg;
+            OutputCapture cap;
+            int lfd;
+            if (!lock_session_edit(rsid, lfd)) {
+                for (size_t i = 0; i < paths.size(); i++) {
+                    ret[paths[i].to_string()] = _job_running_msg;
+                }
+                failure = true;
+                paths.clear();
+            }
+            for (size_t i = 0; i < paths.size(); ) {
+                const char *def_msg = "";
+                vector<bool> valid;
+                BatchMessages vmsgs(cap);
+                size_t end = i + 1;
 
-                out_stream = tf;
-                switch (rop) {
-                case CFGD_SET_PATHS:
-                    def_msg = "Set failed";
-                    fail1 = (!cs->validateSetPath(paths[i])
-                             || !cs->setCfgPath(paths[i]));
-                    break;
-                case CFGD_DELETE_PATHS:
-                    def_msg = "Delete failed";
-                    fail1 = (!cs->deleteCfgPath(paths[i]));
-                    break;
-                case CFGD_MOVE_PATHS:
-                    def_msg = "Move failed";
-                    fail1 = (!cs->validateMoveArgs(paths[i])
-                             || !cs->moveCfgPath(paths[i]));
-                    break;
-                case CFGD_CLONE_PATHS:
-                    def_msg = "Clone failed";
-                    fail1 = (!cs->validateCloneArgs(paths[i])
-                             || !cs->cloneCfgPath(paths[i]));
-                    break;
+                if (rop == CFGD_SET_PATHS) {
+                    /* values of the same node are validated as a batch.
+                     * each invalid path gets its own validation messages.
+                     */
+                    end = cs->validateSetPathBatch(paths, i, valid, &vmsgs);
                 }
+                for (size_t start = i; i < end; i++) {
+                    bool fail1 = false;
+                    string msg;
 
-                if (fail1) {
-                    char mbuf[512];
-                    const char *msg = def_msg;
-                    if (ftell(tf) > 0) {
-                        memset(mbuf, 0, 512);
-                        fseek(tf, 0, SEEK_SET);
-                        fread(mbuf, 511, 1, tf);
-                        msg = mbuf;
+                    cap.mark();
+                    switch (rop) {
+                    case CFGD_SET_PATHS:
+                        def_msg = "Set failed";
+                        if (!valid[i - start]) {
+                            fail1 = true;
+                            msg = vmsgs.get(i);
+                        } else {
+                            fail1 = !cs->setCfgPath(paths[i]);
+                        }
+                        break;
+                    case CFGD_DELETE_PATHS:
+                        def_msg = "Delete failed";
+                        fail1 = (!cs->deleteCfgPath(paths[i]));
+                        break;
+                    case CFGD_MOVE_PATHS:
+                        def_msg = "Move failed";
+                        fail1 = (!cs->validateMoveArgs(paths[i])
+                                 || !cs->moveCfgPath(paths[i]));
+                        break;
+                    case CFGD_CLONE_PATHS:
+                        def_msg = "Clone failed";
+                        fail1 = (!cs->validateCloneArgs(paths[i])
+                                 || !cs->cloneCfgPath(paths[i]));
+                        break;
                     }
-                    failure = true;
-                    ret[paths[i].to_string()] = msg;
-                } else {
-                    success = true;
-                }
 
-                out_stream = oout;
-                fclose(tf);
+                    if (fail1) {
+                        msg += cap.take();
+                        failure = true;
+                        ret[paths[i].to_string()] = (msg.empty() ? def_msg
+                                                                 : msg);
+                    } else {
+                        success = true;
+                    }
+                }
             }
+            unlock_jobs(lfd);
             ret["success"] = (success ? "1" : "0");
             ret["failure"] = (failure ? "1" : "0");
             oa << ret;
@@ -338,7 +964,22 @@ process_req(const string& rsid, unsigned int rop,
         {
             bool success = false, failure = false;
             map<string, string> ret;
+            /* a job started after the check cannot commit at the same
+             * time since both take the commit lock, so the jobs lock is
+             * not held for the whole commit.
+             */
+            int lfd;
+            bool busy = !lock_session_edit(rsid, lfd);
+            unlock_jobs(lfd);
+            if (busy) {
+                ret["error"] = _job_running_msg;
+                ret["success"] = "0";
+                ret["failure"] = "1";
+                oa << ret;
+                break;
+            }
             Cpath dummy;
+            cs->preloadTemplatesIfEnabled();
             cnode::CfgNode aroot(*cs, dummy, true, true);
             cnode::CfgNode wroot(*cs, dummy, false, true);
 
@@ -354,10 +995,8 @@ process_req(const string& rsid, unsigned int rop,
                     success = true;
                 }
 
-                char msg[2048];
-                memset(msg, 0, 2048);
-                fseek(tf, 0, SEEK_SET);
-                fread(msg, 2047, 1, tf);
+                string msg;
+                read_tmpfile(tf, msg);
                 ret["error"] = msg;
             }
             out_stream = oout;
@@ -371,33 +1010,30 @@ process_req(const string& rsid, unsigned int rop,
     case CFGD_DISCARD:
         {
             map<string, string> ret;
-            ret["success"]  = (cs->discardChanges() ? "1" : "0");
+            int lfd;
+            if (!lock_session_edit(rsid, lfd)) {
+                ret["error"] = _job_running_msg;
+                ret["success"] = "0";
+            } else {
+                ret["success"]  = (cs->discardChanges() ? "1" : "0");
+                unlock_jobs(lfd);
+            }
             oa << ret;
         }
         break;
     case CFGD_SAVE:
+    case CFGD_SAVE_IF_CHANGED:
         {
-            bool success = false;
-            string tfile("/config/config.boot.");
-            tfile += rsid;
-            FILE *s = fopen(tfile.c_str(), "w");
-            if (s) {
-                Cpath dummy;
-                cnode::showConfig(cnode::ACTIVE_CFG, cnode::ACTIVE_CFG, dummy,
-                                  true, false, false, false, true, s);
-                fclose(s);
-
-                string cmd = "/opt/vyatta/sbin/vyatta_current_conf_ver.pl >>";
-                cmd += tfile;
-                system(cmd.c_str());
-
-                if (rename(tfile.c_str(), "/config/config.boot") == 0) {
-                    success = true;
-                }
-                sync();
-            }
+            /* skipping an unchanged save is opt-in. a plain save always
+             * writes the file.
+             */
             map<string, string> ret;
-            ret["success"] = (success ? "1" : "0");
+            bool skipped = false;
+            ret["success"] = (cs->saveConfig("/config/config.boot", true,
+                                             (rop == CFGD_SAVE_IF_CHANGED),
+                                             &skipped)
+                              ? "1" : "0");
+            ret["skipped"] = (skipped ? "1" : "0");
             oa << ret;
         }
         break;
@@ -434,8 +1070,12 @@ process_req(const string& rsid, unsigned int rop,
         break;
     case CFGD_TEARDOWN:
         {
+            // the session cannot go away while a job is committing it
             map<string, string> ret;
-            bool success = (cs->inSession() && cs->teardownSession());
+            int lfd = lock_jobs();
+            bool success = (lfd >= 0 && !session_has_job(rsid)
+                            && cs->inSession() && cs->teardownSession());
+            unlock_jobs(lfd);
             ret["success"]  = (success ? "1" : "0");
             oa << ret;
         }
@@ -445,10 +1085,17 @@ process_req(const string& rsid, unsigned int rop,
             map<string, string> ret;
             bool success = false, failure = false;
 
-            if (!cs->loadFile("/opt/vyatta/etc/config.boot.default")) {
+            // as above, the lock is only held while loading the file
+            int lfd;
+            if (!lock_session_edit(rsid, lfd)) {
+                ret["error"] = _job_running_msg;
+                failure = true;
+            } else if (!cs->loadFile("/opt/vyatta/etc/config.boot.default")) {
+                unlock_jobs(lfd);
                 ret["error"] = "Failed to load default config";
                 failure = true;
             } else {
+                unlock_jobs(lfd);
                 Cpath dummy;
                 cnode::CfgNode aroot(*cs, dummy, true, true);
                 cnode::CfgNode wroot(*cs, dummy, false, true);
@@ -465,12 +1112,9 @@ process_req(const string& rsid, unsigned int rop,
                         success = true;
                     }
 
-                    string es = "Failed to commit default config: ";
-                    char msg[2048];
-                    memset(msg, 0, 2048);
-                    fseek(tf, 0, SEEK_SET);
-                    fread(msg, 2047, 1, tf);
-                    ret["error"] = es + msg;
+                    string msg = "Failed to commit default config: ";
+                    read_tmpfile(tf, msg);
+                    ret["error"] = msg;
                 }
                 out_stream = oout;
                 fclose(tf);
@@ -488,6 +1132,106 @@ process_req(const string& rsid, unsigned int rop,
             oa << cnodes;
         }
         break;
+    case CFGD_GET_SUBTREE:
+    case CFGD_GET_SUBTREE_W:
+        {
+            vector<vector<string> > spaths;
+            tr1::shared_ptr<const cnode::CfgNode> root
+                = cs->cfgPathGetSubtree(p, (rop == CFGD_GET_SUBTREE), depth);
+            if (root.get()) {
+                vector<string> cur;
+                get_subtree_paths(*root, cur, spaths);
+            }
+            oa << spaths;
+        }
+        break;
+    case CFGD_GET_SUBTREE_STATUS_W:
+        {
+            MapT<string, string> smap;
+            cs->cfgPathGetSubtreeStatus(p, smap);
+            map<string, string> m(smap.begin(), smap.end());
+            oa << m;
+        }
+        break;
+    case CFGD_COMMIT_JOB:
+        {
+            // args: optional "load-default" to load the default config first
+            map<string, string> ret;
+            bool defcfg = (args.size() > 0 && args[0] == "load-default");
+            string id;
+            bool running = false;
+            int lfd = lock_jobs();
+            if (lfd >= 0) {
+                running = session_has_job(rsid);
+                if (!running) {
+                    id = start_commit_job(*cs, rsid, defcfg);
+                }
+                close(lfd);
+            }
+            if (running) {
+                ret["error"] = "A commit job is already running";
+            } else if (id.empty()) {
+                ret["error"] = "Failed to start commit job";
+            } else {
+                ret["job"] = id;
+            }
+            oa << ret;
+        }
+        break;
+    case CFGD_JOB_SUBSCRIBE:
+        {
+            // args: job id, events offset, output offset, max wait (ms)
+            map<string, string> ret;
+            if (args.size() != 4 || !valid_job_id(args[0])) {
+                ret["state"] = "invalid";
+            } else {
+                subscribe_job(args[0], strtoul(args[1].c_str(), NULL, 10),
+                              strtoul(args[2].c_str(), NULL, 10),
+                              strtoul(args[3].c_str(), NULL, 10), ret);
+            }
+            oa << ret;
+        }
+        break;
+    case CFGD_JOB_POLL:
+        {
+            // args: job id
+            map<string, string> ret;
+            if (args.size() != 1 || !valid_job_id(args[0])) {
+                ret["state"] = "invalid";
+            } else {
+                string dir = string(CFGD_JOBS_DIR) + "/" + args[0];
+                ret["state"] = get_job_state(dir);
+                ret["cancel"] = (access((dir + "/cancel").c_str(), F_OK) == 0
+                                 ? "1" : "0");
+                struct stat st;
+                char buf[32];
+                snprintf(buf, sizeof(buf), "%lld", (long long)
+                         (stat((dir + "/events").c_str(), &st) == 0
+                          ? st.st_size : 0));
+                ret["events_size"] = buf;
+                snprintf(buf, sizeof(buf), "%lld", (long long)
+                         (stat((dir + "/output").c_str(), &st) == 0
+                          ? st.st_size : 0));
+                ret["output_size"] = buf;
+            }
+            oa << ret;
+        }
+        break;
+    case CFGD_JOB_CANCEL:
+        {
+            // args: job id
+            map<string, string> ret;
+            bool success = false;
+            if (args.size() == 1 && valid_job_id(args[0])) {
+                string dir = string(CFGD_JOBS_DIR) + "/" + args[0];
+                if (get_job_state(dir) == "running") {
+                    write_job_file(dir + "/cancel", "");
+                    success = true;
+                }
+            }
+            ret["success"] = (success ? "1" : "0");
+            oa << ret;
+        }
         break;
     default:
         break;
@@ -537,6 +1281,7 @@ handle_session(sock_ptr_t sock)
                 iostream head_stream(&head_buf);
                 head_stream << resp_buf.size() << "\n";
                 boost::asio::write(*sock, head_buf);
+                report_first_byte();
                 boost::asio::write(*sock, resp_buf);
             }
         } catch (boost::system::system_error& e) {
@@ -554,71 +1299,389 @@ handle_session(sock_ptr_t sock)
     }
 }
 
-class WaitTimer {
-public:
-    WaitTimer(boost::asio::io_service& io) : _timer(io) {
-        rearm();
+
+/*
+ * worker pool. the daemon keeps _pool_size pre-forked workers that have
+ * already set up an active-config Cstore and parsed the templates of the
+ * active config. an accepted connection is passed to an idle worker over
+ * its channel (SCM_RIGHTS); the worker serves that one session and exits
+ * so that no state leaks between sessions. children are reaped from a
+ * signalfd instead of polling. workers that die before they are ready
+ * (e.g., when warming up fails) are respawned with exponential backoff.
+ */
+static void
+worker_main(int chan, bool warm)
+{
+    if (warm) {
+        try {
+            string dummy;
+            cstore_ptr_t cs(Cstore::createCstore(ACTIVE_ONLY_SID, dummy));
+            cs_cache[ACTIVE_ONLY_SID] = cs;
+            Cpath root;
+            cnode::CfgNode aroot(*cs, root, true, true);
+        } catch (...) {
+            // warming is only an optimization
+        }
+        cfgd_wmsg_t m = { CFGD_WMSG_READY, 0 };
+        if (send(chan, &m, sizeof(m), 0) != sizeof(m)) {
+            exit(1);
+        }
     }
 
-    ~WaitTimer() {
-        _timer.cancel();
+    struct timeval accepted;
+    char cbuf[CMSG_SPACE(sizeof(int))];
+    struct iovec iov = { &accepted, sizeof(accepted) };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf;
+    msg.msg_controllen = sizeof(cbuf);
+
+    ssize_t len;
+    do {
+        len = recvmsg(chan, &msg, 0);
+    } while (len < 0 && errno == EINTR);
+    struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+    if (len != sizeof(accepted) || !cm || cm->cmsg_level != SOL_SOCKET
+        || cm->cmsg_type != SCM_RIGHTS) {
+        // parent went away or sent garbage
+        exit(0);
     }
+    int fd;
+    memcpy(&fd, CMSG_DATA(cm), sizeof(fd));
 
-    void addPid(pid_t pid) {
-        {
-            lock_t lock(_plock);
-            _pids.insert(pid);
+    _wchan = chan;
+    _waccepted = accepted;
+
+    boost::asio::io_service io;
+    sock_ptr_t sock(new stream_protocol::socket(io));
+    sock->assign(stream_protocol(), fd);
+    handle_session(sock);
+    exit(0);
+}
+
+struct Worker {
+    int chan;
+    bool ready;
+    bool busy;
+    bool was_ready;  // sent CFGD_WMSG_READY. not cleared when it goes away.
+};
+
+typedef map<pid_t, Worker> WorkerMapT;
+
+static const size_t _pool_size = 4;
+static const unsigned long _backoff_min_ms = 100;
+static const unsigned long _backoff_max_ms = 60000;
+static WorkerMapT _workers;
+static sigset_t _orig_sigmask;
+static int _listen_fd = -1;
+static int _sig_fd = -1;
+// consecutive workers that died before they were ready
+static unsigned int _spawn_failures = 0;
+static unsigned long long _spawn_after_ms = 0;
+
+static struct {
+    unsigned long accepted;
+    unsigned long pool_hits;
+    unsigned long pool_misses;
+    unsigned long spawned;
+    unsigned long reaped;
+    unsigned long spawn_failures;
+    unsigned long lat_count;
+    unsigned long long lat_sum_us;
+    unsigned long lat_max_us;
+} _stats;
+
+static void
+write_stats()
+{
+    size_t idle = 0, busy = 0;
+    BOOST_FOREACH(const WorkerMapT::value_type& w, _workers) {
+        if (w.second.busy) {
+            busy++;
+        } else if (w.second.ready) {
+            idle++;
         }
-        boost::posix_time::time_duration td = _timer.expires_from_now();
-        if (td > _intvl || (td + _intvl).total_seconds() < 0) {
-            rearm();
+    }
+
+    string tfile = CFGD_STATS_PATH ".tmp";
+    FILE *f = fopen(tfile.c_str(), "w");
+    if (!f) {
+        return;
+    }
+    fprintf(f, "pool_size %zu\n", _pool_size);
+    fprintf(f, "workers_idle %zu\n", idle);
+    fprintf(f, "workers_busy %zu\n", busy);
+    fprintf(f, "pool_utilization %.2f\n",
+            (idle + busy) ? (double) busy / (idle + busy) : 0.0);
+    fprintf(f, "accepted %lu\n", _stats.accepted);
+    fprintf(f, "pool_hits %lu\n", _stats.pool_hits);
+    fprintf(f, "pool_misses %lu\n", _stats.pool_misses);
+    fprintf(f, "spawned %lu\n", _stats.spawned);
+    fprintf(f, "reaped %lu\n", _stats.reaped);
+    fprintf(f, "spawn_failures %lu\n", _stats.spawn_failures);
+    fprintf(f, "first_byte_count %lu\n", _stats.lat_count);
+    fprintf(f, "first_byte_avg_us %llu\n",
+            _stats.lat_count ? _stats.lat_sum_us / _stats.lat_count : 0);
+    fprintf(f, "first_byte_max_us %lu\n", _stats.lat_max_us);
+    fclose(f);
+    rename(tfile.c_str(), CFGD_STATS_PATH);
+}
+
+static unsigned long long
+now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((unsigned long long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+/*
+ * conn_fd is a connection the daemon has open that must not be inherited
+ * by the worker.
+ */
+static pid_t
+spawn_worker(bool warm, int conn_fd = -1)
+{
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) != 0) {
+        return -1;
+    }
+    pid_t pid = fork();
+    if (pid == -1) {
+        close(sv[0]);
+        close(sv[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        // child: drop the parent's descriptors and signal setup
+        close(sv[0]);
+        close(_listen_fd);
+        close(_sig_fd);
+        if (conn_fd >= 0) {
+            close(conn_fd);
         }
+        BOOST_FOREACH(const WorkerMapT::value_type& w, _workers) {
+            close(w.second.chan);
+        }
+        sigprocmask(SIG_SETMASK, &_orig_sigmask, NULL);
+        worker_main(sv[1], warm);
+        exit(0);
     }
+    close(sv[1]);
+    Worker w = { sv[0], false, false, false };
+    _workers[pid] = w;
+    _stats.spawned++;
+    return pid;
+}
 
-    void handler(const boost::system::error_code& e) {
-        vector<pid_t> del_pids;
-        {
-            lock_t lock(_plock);
-            BOOST_FOREACH(const pid_t pid, _pids) {
-                int status;
-                if (waitpid(pid, &status, WNOHANG) == pid) {
-                    del_pids.push_back(pid);
-                }
-            }
-            BOOST_FOREACH(const pid_t pid, del_pids) {
-                _pids.erase(pid);
-            }
+static void
+spawn_workers()
+{
+    size_t n = 0;
+    BOOST_FOREACH(const WorkerMapT::value_type& w, _workers) {
+        if (!w.second.busy) {
+            n++;
         }
-        if (e != boost::asio::error::operation_aborted) {
-            rearm();
+    }
+    size_t max = _pool_size;
+    if (_spawn_failures > 0) {
+        // backing off. only try one at a time until one gets ready.
+        if (now_ms() < _spawn_after_ms) {
+            return;
         }
+        max = (n < _pool_size ? n + 1 : n);
     }
+    for (; n < max; n++) {
+        if (spawn_worker(true) == -1) {
+            break;
+        }
+    }
+}
 
-private:
-    typedef boost::lock_guard<boost::mutex> lock_t;
+static bool
+pass_conn(int chan, int fd, const struct timeval& accepted)
+{
+    char cbuf[CMSG_SPACE(sizeof(int))];
+    struct iovec iov = { const_cast<struct timeval *>(&accepted),
+                         sizeof(accepted) };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    memset(cbuf, 0, sizeof(cbuf));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf;
+    msg.msg_controllen = sizeof(cbuf);
+    struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_RIGHTS;
+    cm->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cm), &fd, sizeof(fd));
+    return (sendmsg(chan, &msg, MSG_NOSIGNAL) == sizeof(accepted));
+}
 
-    static boost::posix_time::seconds _intvl;
+static void
+dispatch_conn(stream_protocol::acceptor& a, boost::asio::io_service& io)
+{
+    stream_protocol::socket sock(io);
+    a.accept(sock);
+    struct timeval accepted;
+    gettimeofday(&accepted, NULL);
+    _stats.accepted++;
 
-    boost::asio::deadline_timer _timer;
-    boost::unordered_set<pid_t> _pids;
-    boost::mutex _plock;
+    for (WorkerMapT::iterator it = _workers.begin(); it != _workers.end();
+         ++it) {
+        Worker& w = it->second;
+        if (!w.ready || w.busy) {
+            continue;
+        }
+        if (pass_conn(w.chan, sock.native_handle(), accepted)) {
+            w.busy = true;
+            _stats.pool_hits++;
+            return;
+        }
+        w.ready = false;
+    }
 
-    void rearm() {
-        _timer.cancel();
-        _timer.expires_from_now(_intvl);
-        _timer.async_wait(boost::bind(&WaitTimer::handler, this, _1));
+    // no warm worker available, hand it to a fresh one directly
+    pid_t pid = spawn_worker(false, sock.native_handle());
+    if (pid == -1) {
+        throw boost::system::system_error(
+                boost::asio::error::operation_aborted);
     }
-};
+    Worker& w = _workers[pid];
+    w.busy = true;
+    _stats.pool_misses++;
+    pass_conn(w.chan, sock.native_handle(), accepted);
+}
 
-boost::posix_time::seconds WaitTimer::_intvl(3);
+static void
+read_worker(WorkerMapT::iterator it)
+{
+    Worker& w = it->second;
+    cfgd_wmsg_t m;
+    ssize_t len = recv(w.chan, &m, sizeof(m), MSG_DONTWAIT);
+    if (len == 0 || (len < 0 && errno != EAGAIN && errno != EINTR)) {
+        // worker is gone; it is reaped via SIGCHLD
+        close(w.chan);
+        w.chan = -1;
+        w.ready = false;
+        return;
+    }
+    if (len != sizeof(m)) {
+        return;
+    }
+    switch (m.type) {
+    case CFGD_WMSG_READY:
+        w.ready = true;
+        w.was_ready = true;
+        _spawn_failures = 0;
+        break;
+    case CFGD_WMSG_FIRST_BYTE:
+        _stats.lat_count++;
+        _stats.lat_sum_us += m.usec;
+        if (m.usec > _stats.lat_max_us) {
+            _stats.lat_max_us = m.usec;
+        }
+        write_stats();
+        break;
+    default:
+        break;
+    }
+}
 
-static boost::asio::io_service wio;
-static WaitTimer wtimer(wio);
+static void
+reap_workers()
+{
+    struct signalfd_siginfo si;
+    while (read(_sig_fd, &si, sizeof(si)) == sizeof(si)) {
+        // drain; SIGCHLD may be coalesced so reap below
+    }
+
+    pid_t pid;
+    int status;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        WorkerMapT::iterator it = _workers.find(pid);
+        if (it == _workers.end()) {
+            continue;
+        }
+        if (it->second.chan >= 0) {
+            close(it->second.chan);
+        }
+        if (!it->second.was_ready && !it->second.busy) {
+            /* died before it was ready. back off before the next one.
+             * idle workers that were ready (and lost "ready" when their
+             * channel closed) are just replaced.
+             */
+            unsigned int shift = (_spawn_failures < 10 ? _spawn_failures : 10);
+            unsigned long delay = _backoff_min_ms << shift;
+            if (delay > _backoff_max_ms) {
+                delay = _backoff_max_ms;
+            }
+            _spawn_failures++;
+            _spawn_after_ms = now_ms() + delay;
+            _stats.spawn_failures++;
+        }
+        _workers.erase(it);
+        _stats.reaped++;
+    }
+    write_stats();
+}
 
 static void
-startWaitTimer()
+serve(stream_protocol::acceptor& a, boost::asio::io_service& io)
 {
-    wio.run();
+    _listen_fd = a.native_handle();
+    spawn_workers();
+
+    vector<struct pollfd> fds;
+    vector<pid_t> fd_pids;
+    while (true) {
+        fds.clear();
+        fd_pids.clear();
+        struct pollfd pfd = { _listen_fd, POLLIN, 0 };
+        fds.push_back(pfd);
+        pfd.fd = _sig_fd;
+        fds.push_back(pfd);
+        BOOST_FOREACH(const WorkerMapT::value_type& w, _workers) {
+            if (w.second.chan >= 0) {
+                pfd.fd = w.second.chan;
+                fds.push_back(pfd);
+                fd_pids.push_back(w.first);
+            }
+        }
+
+        // wake up when the spawn backoff is over
+        int timeout = -1;
+        if (_spawn_failures > 0) {
+            unsigned long long now = now_ms();
+            timeout = (now < _spawn_after_ms ? _spawn_after_ms - now : 0);
+        }
+        if (poll(&fds[0], fds.size(), timeout) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw boost::system::system_error(
+                    boost::asio::error::operation_aborted);
+        }
+
+        for (size_t i = 2; i < fds.size(); i++) {
+            if (fds[i].revents) {
+                WorkerMapT::iterator it = _workers.find(fd_pids[i - 2]);
+                if (it != _workers.end() && it->second.chan == fds[i].fd) {
+                    read_worker(it);
+                }
+            }
+        }
+        if (fds[1].revents & POLLIN) {
+            reap_workers();
+        }
+        if (fds[0].revents & POLLIN) {
+            dispatch_conn(a, io);
+        }
+        spawn_workers();
+    }
 }
 
 int
@@ -635,7 +1698,19 @@ main(int argc, char* argv[])
     initialize_output_streams();
 
     {
-        boost::thread t(startWaitTimer);
+        // children are reaped through the signalfd
+        sigset_t mask;
+        sigemptyset(&mask);
+        sigaddset(&mask, SIGCHLD);
+        if (sigprocmask(SIG_BLOCK, &mask, &_orig_sigmask) != 0) {
+            perror("sigprocmask");
+            exit(1);
+        }
+        _sig_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+        if (_sig_fd < 0) {
+            perror("signalfd");
+            exit(1);
+        }
     }
 
     while (true) {
@@ -650,23 +1725,7 @@ main(int argc, char* argv[])
                 exit(1);
             }
 
-            while (true) {
-                sock_ptr_t sock(new stream_protocol::socket(io_serv));
-                a.accept(*sock);
-
-                pid_t pid = fork();
-                if (pid == -1) {
-                    throw boost::system::system_error(
-                            boost::asio::error::operation_aborted);
-                }
-                if (pid == 0) {
-                    // child
-                    handle_session(sock);
-                    exit(0);
-                }
-                // parent
-                wtimer.addPid(pid);
-            }
+            serve(a, io_serv);
         } catch (exception& e) {
             cerr << "Exception: " << e.what() << "\n";
         } catch (...) {
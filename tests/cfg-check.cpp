@@ -0,0 +1,867 @@
+/*
+ * Copyright (C) 2011 Vyatta, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <getopt.h>
+
+#include <cli_cstore.h>
+#include <cli_val.h>
+#include <cstore/cstore.hpp>
+#include <cnode/cnode.hpp>
+#include <cnode/cnode-algorithm.hpp>
+#include <cparse/cparse.hpp>
+#include <ubnt/lib/vyatta_interface.hpp>
+#include <ubnt/lib/vyatta_netlink.hpp>
+
+using namespace cstore;
+using namespace cnode;
+using namespace std;
+
+/* test and benchmark driver for the config tree code. each operation
+ * writes its result to stdout so that tests/run-checks.sh can compare it
+ * with the expected output, and with "-n <count>" the operation is run
+ * that many times (only the first run produces output) and the average
+ * time per run is printed to stderr (used by tests/run-bench.sh).
+ *
+ * "-H" turns off the hash skip in the diff functions.
+ *
+ * the templates and the active config come from the usual environment
+ * variables (VYATTA_CONFIG_TEMPLATE and VYATTA_ACTIVE_CONFIGURATION_DIR).
+ */
+
+typedef void (*OpFuncT)(Cstore& cs, const vector<string>& args, FILE *out);
+
+// "-" is read from stdin (i.e., through the stream parser)
+static CfgNode *
+parse_or_die(Cstore& cs, const string& file)
+{
+  CfgNode *root = (file == "-" ? cparse::parse_file(stdin, cs)
+                               : cparse::parse_file(file.c_str(), cs));
+  if (!root) {
+    fflush(stdout);
+    fprintf(stderr, "failed to parse config file\n");
+    exit(1);
+  }
+  return root;
+}
+
+static Cpath
+args_to_path(const vector<string>& args, size_t start)
+{
+  Cpath path;
+  for (size_t i = start; i < args.size(); i++) {
+    path.push(args[i]);
+  }
+  return path;
+}
+
+static void
+print_paths(const vector<Cpath>& paths, FILE *out)
+{
+  for (size_t i = 0; i < paths.size(); i++) {
+    fprintf(out, "%s\n", paths[i].to_string().c_str());
+  }
+}
+
+static string
+escape_comp(const string& comp)
+{
+  // same as the unionfs cstore
+  if (comp.empty()) {
+    return "%%%";
+  }
+  string ret;
+  for (size_t i = 0; i < comp.size(); i++) {
+    if (comp[i] == '%') {
+      ret += "%25";
+    } else if (comp[i] == '/') {
+      ret += "%2F";
+    } else {
+      ret += comp[i];
+    }
+  }
+  return ret;
+}
+
+static void
+write_str_file(const string& file, const string& data)
+{
+  FILE *f = fopen(file.c_str(), "w");
+  if (!f || fwrite(data.data(), 1, data.size(), f) != data.size()) {
+    fprintf(stderr, "failed to write [%s]\n", file.c_str());
+    exit(1);
+  }
+  fclose(f);
+}
+
+// write the subtree below node in the unionfs layout under dir
+static void
+write_active_dir(const CfgNode& node, const string& dir)
+{
+  const vector<CfgNode *>& cnodes = node.getChildNodes();
+  for (size_t i = 0; i < cnodes.size(); i++) {
+    const CfgNode& c = *(cnodes[i]);
+    string cdir = dir + "/" + escape_comp(c.isValue() ? c.getValue()
+                                                      : c.getName());
+    mkdir(cdir.c_str(), 0755);
+    if (c.isLeaf()) {
+      string val = c.getValue();
+      if (c.isMulti()) {
+        val.clear();
+        for (size_t j = 0; j < c.getValues().size(); j++) {
+          val += (j > 0 ? "\n" : "") + c.getValues()[j];
+        }
+      }
+      write_str_file(cdir + "/node.val", val);
+    }
+    if (!c.getComment().empty()) {
+      write_str_file(cdir + "/.comment", c.getComment());
+    }
+    // the parser also marks a tag node whose first tag value is deactivated
+    if (c.isDeactivated() && !c.isTagNode()) {
+      write_str_file(cdir + "/.disable", "");
+    }
+    write_active_dir(c, cdir);
+  }
+}
+
+// read the subtree at path node by node
+static void
+walk_active(Cstore& cs, const Cpath& path, Cpath& rpath,
+            vector<Cpath>& paths)
+{
+  string val;
+  vector<string> vals;
+  if (cs._cfgPathGetValues(path, vals, true)) {
+    for (size_t i = 0; i < vals.size(); i++) {
+      paths.push_back(rpath);
+      paths.back().push(vals[i]);
+    }
+    return;
+  }
+  if (cs._cfgPathGetValue(path, val, true)) {
+    paths.push_back(rpath);
+    paths.back().push(val);
+    return;
+  }
+  vector<string> cnodes;
+  cs._cfgPathGetChildNodes(path, cnodes, true);
+  if (cnodes.empty() && rpath.size() > 0) {
+    paths.push_back(rpath);
+    return;
+  }
+  for (size_t i = 0; i < cnodes.size(); i++) {
+    Cpath cpath(path);
+    cpath.push(cnodes[i]);
+    rpath.push(cnodes[i]);
+    walk_active(cs, cpath, rpath, paths);
+    rpath.pop();
+  }
+}
+
+// status of the subtree at path node by node, with the per-path observers
+static void
+walk_status(Cstore& cs, Cpath& path, Cpath& rpath, vector<Cpath>& paths,
+            vector<unsigned int>& status)
+{
+  if (path.size() > 0) {
+    unsigned int st = 0;
+    if (cs._cfgPathDeleted(path)) {
+      st |= (Cstore::C_PATH_STATUS_DELETED | Cstore::C_PATH_STATUS_CHANGED);
+    } else if (cs._cfgPathAdded(path)) {
+      st |= (Cstore::C_PATH_STATUS_ADDED | Cstore::C_PATH_STATUS_CHANGED);
+    } else if (cs._cfgPathChanged(path)) {
+      st |= Cstore::C_PATH_STATUS_CHANGED;
+    }
+    if (cs._cfgPathEffective(path)) {
+      st |= Cstore::C_PATH_STATUS_EFFECTIVE;
+    }
+    if (cs._cfgPathExistsDA(path) && cs._cfgPathDeactivated(path)) {
+      st |= Cstore::C_PATH_STATUS_DEACTIVATED;
+    }
+    paths.push_back(rpath);
+    status.push_back(st);
+  }
+  // child nodes in either config, including deactivated ones
+  vector<string> acnodes, wcnodes;
+  cs._cfgPathGetChildNodesDA(path, acnodes, true);
+  cs._cfgPathGetChildNodesDA(path, wcnodes, false);
+  MapT<string, bool> seen;
+  for (size_t i = 0; i < wcnodes.size(); i++) {
+    seen[wcnodes[i]] = true;
+  }
+  for (size_t i = 0; i < acnodes.size(); i++) {
+    if (seen.find(acnodes[i]) == seen.end()) {
+      wcnodes.push_back(acnodes[i]);
+    }
+  }
+  for (size_t i = 0; i < wcnodes.size(); i++) {
+    path.push(wcnodes[i]);
+    rpath.push(wcnodes[i]);
+    walk_status(cs, path, rpath, paths, status);
+    path.pop();
+    rpath.pop();
+  }
+}
+
+static size_t
+count_nodes(const CfgNode *node)
+{
+  if (!node) {
+    return 0;
+  }
+  size_t n = 1;
+  for (size_t i = 0; i < node->numChildNodes(); i++) {
+    n += count_nodes(node->getChildNodes()[i]);
+  }
+  return n;
+}
+
+////// operations
+// show <file>|-: "show" output of the config file
+static void
+op_show(Cstore& cs, const vector<string>& args, FILE *out)
+{
+  auto_ptr<CfgNode> root(parse_or_die(cs, args[0]));
+  show_cfg(*root, false, false, out);
+}
+
+// cmds <file>|-: "set" commands of the config file
+static void
+op_cmds(Cstore& cs, const vector<string>& args, FILE *out)
+{
+  auto_ptr<CfgNode> root(parse_or_die(cs, args[0]));
+  show_cmds(*root, out);
+}
+
+// json <file>|-: json output of the config file
+static void
+op_json(Cstore& cs, const vector<string>& args, FILE *out)
+{
+  auto_ptr<CfgNode> root(parse_or_die(cs, args[0]));
+  show_cfg_json(*root, false, false, out);
+}
+
+/* validate <cmds> [single]: replay the "set" commands in the cmds file
+ * (the output of "cmds", values quoted with single quotes) through the
+ * same batched validation as loading a config file, or one path at a time
+ * with "single", and list the invalid paths. the paths are not looked up
+ * in the template cache before (as parsing a config file does), so every
+ * value is checked against its template.
+ */
+static void
+op_validate(Cstore& cs, const vector<string>& args, FILE *out)
+{
+  FILE *fin = fopen(args[0].c_str(), "r");
+  if (!fin) {
+    fprintf(stderr, "failed to open [%s]\n", args[0].c_str());
+    exit(1);
+  }
+  vector<Cpath> set_list;
+  char line[1024];
+  while (fgets(line, sizeof(line), fin)) {
+    line[strcspn(line, "\n")] = 0;
+    if (strncmp(line, "set ", 4) != 0) {
+      continue;
+    }
+    Cpath path;
+    for (char *c = line + 4; *c; ) {
+      if (*c == ' ') {
+        ++c;
+        continue;
+      }
+      char *e = (*c == '\'' ? strchr(c + 1, '\'') : NULL);
+      if (e) {
+        path.push(string(c + 1, e - c - 1));
+        c = e + 1;
+      } else {
+        size_t n = strcspn(c, " ");
+        path.push(string(c, n));
+        c += n;
+      }
+    }
+    set_list.push_back(path);
+  }
+  fclose(fin);
+  bool single = (args.size() > 1 && args[1] == "single");
+  unsigned int invalid = 0;
+  for (size_t i = 0; i < set_list.size(); ) {
+    vector<bool> valid;
+    size_t start = i;
+    size_t end = start + 1;
+    if (single) {
+      valid.push_back(cs._validateSetPath(set_list[start]));
+    } else {
+      end = cs._validateSetPathBatch(set_list, start, valid);
+    }
+    fflush(out_stream);
+    for (; i < end; i++) {
+      if (!valid[i - start]) {
+        fprintf(out, "invalid: %s\n", set_list[i].to_string().c_str());
+        invalid++;
+      }
+    }
+    fflush(out);
+  }
+  fprintf(out, "%u paths, %u invalid\n", (unsigned) set_list.size(),
+          invalid);
+}
+
+/* values <count> <path>: set <count> values of the multi-value node at
+ * path in the working config one by one, then delete them one by one in
+ * the same order. VYATTA_TEMP_CONFIG_DIR and VYATTA_CHANGES_ONLY_DIR must
+ * point to scratch directories.
+ */
+static void
+op_values(Cstore& cs, const vector<string>& args, FILE *out)
+{
+  unsigned long count = strtoul(args[0].c_str(), NULL, 10);
+  Cpath path(args_to_path(args, 1));
+  vector<Cpath> vpaths;
+  for (unsigned long i = 0; i < count; i++) {
+    char buf[32];
+    sprintf(buf, "value-%lu", i);
+    vpaths.push_back(path);
+    vpaths.back().push(buf);
+  }
+  vector<string> vals;
+  for (size_t i = 0; i < vpaths.size(); i++) {
+    if (!cs._setCfgPath(vpaths[i])) {
+      fprintf(out, "set failed: %s\n", vpaths[i].to_string().c_str());
+    }
+  }
+  cs._cfgPathGetValues(path, vals);
+  fprintf(out, "%u values set\n", (unsigned) vals.size());
+  fflush(out);
+  // a value that is there again, and one that is not there (only messages)
+  if (count > 0) {
+    cs._setCfgPath(vpaths[count - 1]);
+  }
+  Cpath missing(path);
+  missing.push("value-missing");
+  cs._deleteCfgPath(missing);
+  fflush(out_stream);
+  for (size_t i = 0; i < vpaths.size(); i++) {
+    if (!cs._deleteCfgPath(vpaths[i])) {
+      fprintf(out, "delete failed: %s\n", vpaths[i].to_string().c_str());
+    }
+  }
+  fflush(out_stream);
+  fprintf(out, "node %s\n", (cs._cfgPathExists(path) ? "left" : "deleted"));
+}
+
+/* cpath [<count>]: check copying, push/pop and the hashes of Cpath, then
+ * build a tree of <count> paths (8 children per node) by copying the
+ * parent and pushing a component, index them by path, and look each one
+ * up again with a path built from scratch.
+ */
+static void
+cpath_check(const char *name, bool ok, FILE *out)
+{
+  fprintf(out, "%s: %s\n", (ok ? "ok" : "FAIL"), name);
+}
+
+static void
+op_cpath(Cstore& cs, const vector<string>& args, FILE *out)
+{
+  Cpath a;
+  a.push("interfaces");
+  a.push("ethernet");
+  size_t ahash = a.hash();
+  const char *acomp = a[1];
+
+  Cpath b(a);
+  cpath_check("copy is equal", (b == a && b.hash() == ahash), out);
+  b.push("eth0");
+  cpath_check("push on copy leaves original",
+              (a.size() == 2 && a.to_string() == "interfaces ethernet"
+               && a.hash() == ahash && a[1] == acomp
+               && b.to_string() == "interfaces ethernet eth0"), out);
+  cpath_check("push changes hash", (b.hash() != ahash && !(b == a)), out);
+  string last;
+  b.pop(last);
+  cpath_check("pop restores hash",
+              (last == "eth0" && b == a && b.hash() == ahash), out);
+
+  Cpath c;
+  c.push("interfaces");
+  c.push("ethernet");
+  cpath_check("same components, same hash", (c == a && c.hash() == ahash),
+              out);
+  Cpath d, e, f;
+  d.push("ab");
+  e.push("a");
+  e.push("b");
+  f.push("");
+  cpath_check("split components differ",
+              (!(d == e) && d.hash() != e.hash()), out);
+  cpath_check("empty component differs from empty path",
+              (f.size() == 1 && !(f == Cpath()) && f.hash() != Cpath().hash()),
+              out);
+
+  vector<string> v;
+  v.push_back("interfaces");
+  v.push_back("ethernet");
+  cpath_check("from vector", (Cpath(v) == a), out);
+  Cpath g(a);
+  g /= g;
+  cpath_check("append to itself",
+              (g.size() == 4
+               && g.to_string() == "interfaces ethernet interfaces ethernet"),
+              out);
+  Cpath h(a);
+  h.pop();
+  h.pop();
+  h.pop();
+  cpath_check("pop past the root",
+              (h.size() == 0 && h == Cpath() && h.hash() == Cpath().hash()
+               && a.size() == 2), out);
+  Cpath l;
+  string lstr;
+  for (int i = 0; i < 100; i++) {
+    char buf[32];
+    sprintf(buf, "comp-%d", i);
+    l.push(buf);
+    lstr += (i > 0 ? " " : "");
+    lstr += buf;
+  }
+  cpath_check("growth", (l.size() == 100 && l.to_string() == lstr
+                         && strcmp(l.back(), "comp-99") == 0), out);
+
+  size_t count = (args.size() > 0 ? strtoul(args[0].c_str(), NULL, 10) : 0);
+  if (count == 0) {
+    return;
+  }
+  const char *names[] = { "node-0", "node-1", "node-2", "node-3", "node-4",
+                          "node-5", "node-6", "node-7" };
+  vector<Cpath> paths(1);
+  for (size_t i = 0; paths.size() < count; i++) {
+    for (size_t j = 0; j < 8 && paths.size() < count; j++) {
+      paths.push_back(paths[i]);
+      paths.back().push(names[j]);
+    }
+  }
+  MapT<Cpath, size_t, CpathHash> idx;
+  for (size_t i = 0; i < paths.size(); i++) {
+    idx[paths[i]] = i;
+  }
+  size_t found = 0;
+  for (size_t i = 0; i < paths.size(); i++) {
+    Cpath p;
+    for (size_t j = 0; j < paths[i].size(); j++) {
+      p.push(paths[i][j]);
+    }
+    MapT<Cpath, size_t, CpathHash>::iterator it = idx.find(p);
+    if (it != idx.end() && it->second == i) {
+      ++found;
+    }
+  }
+  fprintf(out, "%u paths, %u distinct, %u found\n", (unsigned) paths.size(),
+          (unsigned) idx.size(), (unsigned) found);
+}
+
+/* find <file> [<paths>]: look up each path listed in the paths file (one
+ * per line, components separated by spaces) in the config file. without a
+ * paths file, look up every "set" path of the config file and report the
+ * ones not found.
+ */
+static void
+op_find(Cstore& cs, const vector<string>& args, FILE *out)
+{
+  auto_ptr<CfgNode> root(parse_or_die(cs, args[0]));
+  bool is_value;
+  if (args.size() > 1) {
+    FILE *fin = fopen(args[1].c_str(), "r");
+    if (!fin) {
+      fprintf(stderr, "failed to open [%s]\n", args[1].c_str());
+      exit(1);
+    }
+    char line[1024];
+    while (fgets(line, sizeof(line), fin)) {
+      line[strcspn(line, "\n")] = 0;
+      Cpath path;
+      for (char *c = strtok(line, " "); c; c = strtok(NULL, " ")) {
+        path.push(c);
+      }
+      const CfgNode *node = findCfgNode(root.get(), path, is_value);
+      fprintf(out, "%s: %s\n", path.to_string().c_str(),
+              (!node ? "none" : (is_value ? "value" : "node")));
+    }
+    fclose(fin);
+    return;
+  }
+  vector<Cpath> set_list, com_list;
+  get_cmds(*root, set_list, com_list);
+  vector<Cpath> missing;
+  for (size_t i = 0; i < set_list.size(); i++) {
+    if (!findCfgNode(root.get(), set_list[i], is_value)) {
+      missing.push_back(set_list[i]);
+    }
+  }
+  fprintf(out, "%u paths, %u not found\n", (unsigned) set_list.size(),
+          (unsigned) missing.size());
+  print_paths(missing, out);
+}
+
+// active-show|active-json [<path>...]: show the active config
+static void
+op_active_show(Cstore& cs, const vector<string>& args, FILE *out)
+{
+  showConfig(ACTIVE_CFG, ACTIVE_CFG, args_to_path(args, 0), false, false,
+             false, false, false, out);
+}
+
+static void
+op_active_json(Cstore& cs, const vector<string>& args, FILE *out)
+{
+  showConfig(ACTIVE_CFG, ACTIVE_CFG, args_to_path(args, 0), false, false,
+             false, false, false, out, true);
+}
+
+// diff <file1> <file2>: context diff and commands diff of the two files
+static void
+op_diff(Cstore& cs, const vector<string>& args, FILE *out)
+{
+  auto_ptr<CfgNode> root1(parse_or_die(cs, args[0]));
+  auto_ptr<CfgNode> root2(parse_or_die(cs, args[1]));
+  Cpath cur_path;
+  show_cfg_diff(*root1, *root2, cur_path, false, false, true, out);
+  show_cmds_diff(*root1, *root2, out);
+}
+
+/* change-diff <file> <value> <path>...: diff the file with itself, then
+ * set (or add for a multi node) the value at path in the second tree and
+ * diff again. checks that the change drops the cached hashes.
+ */
+static void
+op_change_diff(Cstore& cs, const vector<string>& args, FILE *out)
+{
+  auto_ptr<CfgNode> root1(parse_or_die(cs, args[0]));
+  auto_ptr<CfgNode> root2(parse_or_die(cs, args[0]));
+  show_cmds_diff(*root1, *root2, out);
+  CfgNode *node = findCfgNode(root2.get(), args_to_path(args, 2));
+  if (!node) {
+    fprintf(stderr, "path not found\n");
+    exit(1);
+  }
+  char *val = const_cast<char *>(args[1].c_str());
+  if (node->isMulti()) {
+    node->addMultiValue(val);
+  } else {
+    node->setValue(val);
+  }
+  show_cmds_diff(*root1, *root2, out);
+}
+
+// write-active <file> <dir>: write the config file as an active config
+static void
+op_write_active(Cstore& cs, const vector<string>& args, FILE *out)
+{
+  auto_ptr<CfgNode> root(parse_or_die(cs, args[0]));
+  mkdir(args[1].c_str(), 0755);
+  write_active_dir(*root, args[1]);
+}
+
+// subtree [<path>...]: paths in the active subtree, read in one pass
+static void
+op_subtree(Cstore& cs, const vector<string>& args, FILE *out)
+{
+  tr1::shared_ptr<const CfgNode> root
+    = cs._cfgPathGetSubtree(args_to_path(args, 0), true);
+  if (!root.get()) {
+    return;
+  }
+  vector<Cpath> set_list, com_list;
+  get_cmds(*root, set_list, com_list);
+  print_paths(set_list, out);
+}
+
+// walk [<path>...]: same as above, read node by node
+static void
+op_walk(Cstore& cs, const vector<string>& args, FILE *out)
+{
+  Cpath rpath;
+  vector<Cpath> paths;
+  walk_active(cs, args_to_path(args, 0), rpath, paths);
+  print_paths(paths, out);
+}
+
+/* status [single] [<path>...]: the active and working subtrees (number of
+ * nodes) and the status of every node, read in one pass, or with "single"
+ * read as two subtrees and then path by path. the status lines are sorted
+ * by path.
+ */
+static void
+op_status(Cstore& cs, const vector<string>& args, FILE *out)
+{
+  bool single = (args.size() > 0 && args[0] == "single");
+  Cpath path(args_to_path(args, (single ? 1 : 0)));
+  tr1::shared_ptr<const CfgNode> aroot, wroot;
+  vector<Cpath> paths;
+  vector<unsigned int> status;
+  if (single) {
+    aroot = cs._cfgPathGetSubtree(path, true);
+    wroot = cs._cfgPathGetSubtree(path, false);
+    Cpath rpath;
+    walk_status(cs, path, rpath, paths, status);
+  } else {
+    cs._cfgPathGetSubtreesWithStatus(path, aroot, wroot, paths, status);
+  }
+  fprintf(out, "active: %u nodes, working: %u nodes\n",
+          (unsigned) count_nodes(aroot.get()),
+          (unsigned) count_nodes(wroot.get()));
+  vector<string> lines;
+  for (size_t i = 0; i < paths.size(); i++) {
+    lines.push_back(paths[i].to_string() + ": "
+                    + Cstore::pathStatusToString(status[i]));
+  }
+  sort(lines.begin(), lines.end());
+  for (size_t i = 0; i < lines.size(); i++) {
+    fprintf(out, "%s\n", lines[i].c_str());
+  }
+}
+
+// addr-index <file>: interfaces of each address in the config file
+static void
+op_addr_index(Cstore& cs, const vector<string>& args, FILE *out)
+{
+  auto_ptr<CfgNode> root(parse_or_die(cs, args[0]));
+  Cpath path;
+  path.push("interfaces");
+  bool is_value;
+  vyatta::Interface::AddrIndexT idx;
+  vyatta::Interface::build_address_index(findCfgNode(root.get(), path,
+                                                     is_value), idx);
+  vector<string> lines;
+  for (vyatta::Interface::AddrIndexT::const_iterator it = idx.begin();
+       it != idx.end(); ++it) {
+    string line = it->first + ":";
+    for (size_t i = 0; i < it->second.size(); i++) {
+      line += (i > 0 ? ", " : " ") + it->second[i];
+    }
+    lines.push_back(line);
+  }
+  sort(lines.begin(), lines.end());
+  for (size_t i = 0; i < lines.size(); i++) {
+    fprintf(out, "%s\n", lines[i].c_str());
+  }
+}
+
+/*
+ * netlink <ifname>: replay batch lines of the queued link, bridge port and
+ * address requests on an existing interface, and the queueing errors.
+ * nothing is sent.
+ */
+static void
+op_netlink(Cstore& cs, const vector<string>& args, FILE *out)
+{
+  const string& name = args[0];
+  vyatta::Netlink nl;
+  nl.linkSetUp(name, false);
+  nl.linkSetMac(name, "00:11:22:33:44:55");
+  nl.linkSetUp(name, true);
+  nl.linkSetMaster(name, name);
+  nl.linkSetMaster(name, "");
+  nl.bridgePortSet(name, 100, 32);
+  nl.bridgePortSet(name, 100, -1);
+  nl.bridgePortSet(name, -1, 32);
+  nl.bridgePortSet(name, -1, -1);
+  nl.linkDel(name);
+  nl.addrAdd(name, "2001:db8::1/64");
+  nl.addrDel(name, "2001:db8::1/64");
+  nl.addrAdd(name, "192.0.2.1/24");
+  nl.addrDel(name, "192.0.2.1/24");
+  nl.linkSetMac(name, "00:11:22:33:44");
+  nl.linkSetMaster(name, "nosuchbr0");
+  nl.addrAdd(name, "192.0.2.1/33");
+  for (size_t i = 0; i < nl.size(); i++) {
+    fprintf(out, "%s %s\n", nl.tool(i).c_str(), nl.batchLine(i).c_str());
+  }
+  const vector<string>& errs = nl.errors();
+  for (size_t i = 0; i < errs.size(); i++) {
+    fprintf(out, "error: %s\n", errs[i].c_str());
+  }
+}
+
+// list [<path>...]: sorted child nodes of the active path
+static void
+op_list(Cstore& cs, const vector<string>& args, FILE *out)
+{
+  vector<string> cnodes;
+  cs._cfgPathGetChildNodes(args_to_path(args, 0), cnodes, true);
+  for (size_t i = 0; i < cnodes.size(); i++) {
+    fprintf(out, "%s\n", cnodes[i].c_str());
+  }
+}
+
+static vtw_type_e
+name_to_type(const string& name)
+{
+  for (int t = INT_TYPE; t <= BOOL_TYPE; t++) {
+    if (name == type_to_name((vtw_type_e) t)) {
+      return (vtw_type_e) t;
+    }
+  }
+  fprintf(stderr, "invalid type [%s]\n", name.c_str());
+  exit(1);
+}
+
+// val <type>[,<type2>] <value>...: validate values of the type(s)
+static void
+op_val(Cstore& cs, const vector<string>& args, FILE *out)
+{
+  static bool path_init = false;
+  if (!path_init) {
+    // for the messages
+    init_path(&m_path, "value");
+    path_init = true;
+  }
+  vtw_def def;
+  memset(&def, 0, sizeof(def));
+  size_t c = args[0].find(',');
+  def.def_type = name_to_type(args[0].substr(0, c));
+  def.def_type2 = (c == string::npos ? ERROR_TYPE
+                                     : name_to_type(args[0].substr(c + 1)));
+  for (size_t i = 1; i < args.size(); i++) {
+    vector<char> v(args[i].begin(), args[i].end());
+    v.push_back(0);
+    boolean ok = validate_value(&def, &(v[0]));
+    fflush(stdout);
+    fflush(out_stream);
+    fprintf(out, "[%s]", args[i].c_str());
+    valstruct val;
+    if (ok && char2val(&def, &(v[0]), &val) == 0) {
+      fprintf(out, " %s", type_to_name(val.val_type));
+      for (int j = 0; j < val.bin_len; j++) {
+        fprintf(out, " %u", val.bin[j]);
+      }
+      free_val(&val);
+    } else {
+      fprintf(out, " invalid");
+    }
+    fprintf(out, "\n");
+  }
+}
+
+static struct {
+  const char *name;
+  size_t min_args;
+  OpFuncT func;
+} ops[] = {
+  { "show", 1, &op_show },
+  { "cmds", 1, &op_cmds },
+  { "json", 1, &op_json },
+  { "find", 1, &op_find },
+  { "validate", 1, &op_validate },
+  { "diff", 2, &op_diff },
+  { "change-diff", 3, &op_change_diff },
+  { "write-active", 2, &op_write_active },
+  { "active-show", 0, &op_active_show },
+  { "active-json", 0, &op_active_json },
+  { "subtree", 0, &op_subtree },
+  { "walk", 0, &op_walk },
+  { "list", 0, &op_list },
+  { "status", 0, &op_status },
+  { "addr-index", 1, &op_addr_index },
+  { "netlink", 1, &op_netlink },
+  { "val", 2, &op_val },
+  { "values", 2, &op_values },
+  { "cpath", 0, &op_cpath },
+  { NULL, 0, NULL }
+};
+
+static void
+usage(const char *prog)
+{
+  fprintf(stderr, "Usage: %s [-n <count>] [-H] <op> [<args>...]\nops:",
+          prog);
+  for (size_t i = 0; ops[i].name; i++) {
+    fprintf(stderr, " %s", ops[i].name);
+  }
+  fprintf(stderr, "\n");
+  exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+  unsigned long count = 0;
+  bool hash_skip = true;
+  int c;
+  while ((c = getopt(argc, argv, "+n:H")) != -1) {
+    switch (c) {
+    case 'n':
+      count = strtoul(optarg, NULL, 10);
+      break;
+    case 'H':
+      // compare every node in the diffs
+      hash_skip = false;
+      set_diff_hash_skip(false);
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+  if (optind >= argc) {
+    usage(argv[0]);
+  }
+  size_t i = 0;
+  for (; ops[i].name && strcmp(ops[i].name, argv[optind]) != 0; i++);
+  vector<string> args;
+  for (int j = optind + 1; j < argc; j++) {
+    args.push_back(argv[j]);
+  }
+  if (!ops[i].name || args.size() < ops[i].min_args) {
+    usage(argv[0]);
+  }
+
+  initialize_output_streams();
+  auto_ptr<Cstore> cs(Cstore::createCstore(false));
+  ops[i].func(*cs, args, stdout);
+  if (count == 0) {
+    return 0;
+  }
+
+  FILE *null = fopen("/dev/null", "w");
+  struct timeval t0, t1;
+  gettimeofday(&t0, NULL);
+  for (unsigned long n = 0; n < count; n++) {
+    ops[i].func(*cs, args, null);
+  }
+  gettimeofday(&t1, NULL);
+  fclose(null);
+  double usec = ((t1.tv_sec - t0.tv_sec) * 1000000.0
+                 + (t1.tv_usec - t0.tv_usec));
+  string label = argv[optind];
+  if (ops[i].func == &op_val
+      || (ops[i].func == &op_status && !args.empty()
+          && args[0] == "single")) {
+    label += " " + args[0];
+  }
+  if (!hash_skip) {
+    label += " -H";
+  }
+  fprintf(stderr, "%-12s %10.1f us/run (%lu runs)\n", label.c_str(),
+          usec / count, count);
+  return 0;
+}
@@ -0,0 +1,143 @@
+#!/bin/sh
+# time the cfg-check operations on a generated config. run by "make bench".
+# usage: run-bench.sh [<interfaces> [<runs>]]
+
+srcdir=$(cd "${srcdir:-.}" && pwd)
+CFG_CHECK=${CFG_CHECK:-./tests/cfg-check}
+NINTF=${1:-64}
+RUNS=${2:-20}
+
+TMPD=$(mktemp -d) || exit 1
+trap 'rm -rf "$TMPD"' EXIT
+
+VYATTA_CONFIG_TEMPLATE=$srcdir/tests/templates
+VYATTA_ACTIVE_CONFIGURATION_DIR=$TMPD/active
+export VYATTA_CONFIG_TEMPLATE VYATTA_ACTIVE_CONFIGURATION_DIR
+
+# <NINTF> interfaces with 8 vifs each, and a firewall with 16 rules per
+# interface
+gen_config ()
+{
+  echo "firewall {"
+  echo "    name BENCH {"
+  echo "        default-action drop"
+  i=1
+  while [ $i -le $((NINTF * 16)) ]; do
+    echo "        rule $i {"
+    echo "            action accept"
+    echo "            protocol tcp"
+    echo "        }"
+    i=$((i + 1))
+  done
+  echo "    }"
+  echo "}"
+  echo "interfaces {"
+  i=0
+  while [ $i -lt $NINTF ]; do
+    echo "    ethernet eth$i {"
+    echo "        address 10.$((i / 256)).$((i % 256)).1/24"
+    echo "        description \"port $i\""
+    v=1
+    while [ $v -le 8 ]; do
+      echo "        vif $v {"
+      echo "            address 172.$((v + 15)).$((i % 256)).1/24"
+      echo "        }"
+      v=$((v + 1))
+    done
+    echo "    }"
+    i=$((i + 1))
+  done
+  echo "}"
+  echo "system {"
+  echo "    host-name bench"
+  echo "}"
+}
+
+gen_config >"$TMPD/bench.boot"
+"$CFG_CHECK" write-active "$TMPD/bench.boot" "$TMPD/active" || exit 1
+
+echo "config: $NINTF interfaces, $(wc -l <"$TMPD/bench.boot") lines"
+for op in show cmds json find; do
+  "$CFG_CHECK" -n $RUNS $op "$TMPD/bench.boot" >/dev/null || exit 1
+done
+# diff with one changed rule, with and without the hash skip
+awk '!done && /protocol tcp/ { sub("tcp", "udp"); done = 1 } { print }' \
+  "$TMPD/bench.boot" >"$TMPD/bench-changed.boot"
+for skip in "" -H; do
+  "$CFG_CHECK" -n $RUNS $skip diff "$TMPD/bench.boot" \
+    "$TMPD/bench-changed.boot" >/dev/null || exit 1
+done
+# replay of the config commands with value validation. the templates are
+# cached after the first replay, so each replay is a new process (as when
+# loading the boot config).
+# time_procs <label> <cfg-check args>...
+time_procs ()
+{
+  label=$1
+  shift
+  t0=$(date +%s%N)
+  n=0
+  while [ $n -lt $RUNS ]; do
+    "$CFG_CHECK" "$@" >/dev/null || exit 1
+    n=$((n + 1))
+  done
+  t1=$(date +%s%N)
+  printf "%-12s %8d.0 us/run (%d runs)\n" "$label" \
+    $(((t1 - t0) / RUNS / 1000)) $RUNS >&2
+}
+"$CFG_CHECK" cmds "$TMPD/bench.boot" >"$TMPD/bench.cmds" || exit 1
+time_procs validate validate "$TMPD/bench.cmds"
+# values of two multi-value nodes (2048 paths), validated a node at a time
+# (as by loadFile and cfgd) and one path at a time
+i=0
+while [ $i -lt 1024 ]; do
+  echo "set system name-server 10.0.$((i / 256)).$((i % 256))"
+  echo "set system domain-search search$(echo $i | tr 0-9 a-j)"
+  i=$((i + 1))
+done | sort >"$TMPD/multi.cmds"
+time_procs multi validate "$TMPD/multi.cmds"
+time_procs "multi -1" validate "$TMPD/multi.cmds" single
+for op in active-show active-json subtree walk; do
+  "$CFG_CHECK" -n $RUNS $op >/dev/null || exit 1
+done
+# subtrees and status of the active config and a working config with one
+# changed rule, in one pass and node by node
+"$CFG_CHECK" write-active "$TMPD/bench-changed.boot" "$TMPD/bench-work" \
+  || exit 1
+VYATTA_TEMP_CONFIG_DIR=$TMPD/bench-work
+export VYATTA_TEMP_CONFIG_DIR
+"$CFG_CHECK" -n $RUNS status >/dev/null || exit 1
+"$CFG_CHECK" -n $RUNS status single >/dev/null || exit 1
+# sorted child listing of the widest node
+"$CFG_CHECK" -n $RUNS list firewall name BENCH rule >/dev/null || exit 1
+# address index of an interface with 500 vlans
+{
+  echo "interfaces {"
+  echo "    ethernet eth0 {"
+  v=1
+  while [ $v -le 500 ]; do
+    echo "        vif $v {"
+    echo "            address 10.$((v / 256)).$((v % 256)).1/24"
+    echo "            address 2001:db8:$v::1/64"
+    echo "        }"
+    v=$((v + 1))
+  done
+  echo "    }"
+  echo "}"
+} >"$TMPD/vlan.boot"
+"$CFG_CHECK" -n $RUNS addr-index "$TMPD/vlan.boot" >/dev/null || exit 1
+# path copies and hashes of a 50k node tree
+"$CFG_CHECK" -n $RUNS cpath 50000 >/dev/null || exit 1
+# typed value validation
+for tv in u32:4294967295 ipv4:192.168.100.200 ipv4net:192.168.100.0/24 \
+  ipv6:2001:db8:1234::abcd ipv6net:2001:db8:1234::/48 \
+  macaddr:00:1a:2b:3c:4d:5e bool:false; do
+  "$CFG_CHECK" -n $((RUNS * 1000)) val ${tv%%:*} ${tv#*:} >/dev/null || exit 1
+done
+# set and delete of the values of a large multi-value node, one by one
+VYATTA_TEMP_CONFIG_DIR=$TMPD/work
+VYATTA_CHANGES_ONLY_DIR=$TMPD/changes
+export VYATTA_TEMP_CONFIG_DIR VYATTA_CHANGES_ONLY_DIR
+mkdir -p "$TMPD/work" "$TMPD/changes"
+"$CFG_CHECK" -n $RUNS values $((NINTF * 32)) system name-server >/dev/null \
+  || exit 1
@@ -0,0 +1,160 @@
+#!/bin/sh
+# compare the output of tests/cfg-check for the configs in tests/configs
+# with the expected output in tests/expected. run by "make check".
+
+srcdir=$(cd "${srcdir:-.}" && pwd)
+CFG_CHECK=${CFG_CHECK:-./tests/cfg-check}
+EXPECTED=$srcdir/tests/expected
+CONFIGS=$srcdir/tests/configs
+
+TMPD=$(mktemp -d) || exit 1
+trap 'rm -rf "$TMPD"' EXIT
+
+VYATTA_CONFIG_TEMPLATE=$srcdir/tests/templates
+VYATTA_ACTIVE_CONFIGURATION_DIR=$TMPD/active
+export VYATTA_CONFIG_TEMPLATE VYATTA_ACTIVE_CONFIGURATION_DIR
+
+failed=0
+
+# check <expected> <cfg-check args>...
+# (stdin is $CHECK_IN if set)
+check ()
+{
+  exp=$1
+  shift
+  "$CFG_CHECK" "$@" <"${CHECK_IN:-/dev/null}" >"$TMPD/out" 2>&1
+  ret=$?
+  if [ $ret -ne 0 ]; then
+    echo "[exit $ret]" >>"$TMPD/out"
+  fi
+  if cmp -s "$EXPECTED/$exp" "$TMPD/out"; then
+    echo "PASS: $exp ($*)"
+  else
+    echo "FAIL: $exp ($*)"
+    diff -u "$EXPECTED/$exp" "$TMPD/out"
+    failed=1
+  fi
+}
+
+check basic.show show "$CONFIGS/basic.boot"
+check basic.cmds cmds "$CONFIGS/basic.boot"
+check basic.json json "$CONFIGS/basic.boot"
+
+# parser: same results from a mapped file and from a stream, and the
+# same syntax errors as the flex/bison parser
+check syntax.show show "$CONFIGS/syntax.boot"
+check syntax.cmds cmds "$CONFIGS/syntax.boot"
+CHECK_IN=$CONFIGS/syntax.boot
+check syntax.cmds cmds -
+CHECK_IN=
+for err in brace colon comment escape extra; do
+  check error-$err.out show "$CONFIGS/error-$err.boot"
+  CHECK_IN=$CONFIGS/error-$err.boot
+  check error-$err.out show -
+  CHECK_IN=
+done
+
+# typed values: boundaries, and garbage after a value (badly formed) or
+# instead of one (wrong type), with the same messages as the flex scanner
+check val.bool val bool true false TRUE tru truex xtrue truefalse 1
+check val.u32 val u32 0 00 4294967295 4294967296 99999999999 12x x12 -1 \
+  +1 1.5 1.2.3.4 ::
+check val.ipv4 val ipv4 0.0.0.0 255.255.255.255 256.1.1.1 1.2.3 1.2.3.4.5 \
+  01.02.003.004 1.2.3.4x 1..2.3.4 1.2.3.4/24 300
+check val.ipv4net val ipv4net 1.2.3.0/0 1.2.3.0/32 1.2.3.0/33 1.2.3.0/ \
+  1.2.3.0/08 10.0.0.0/8x 1.2.3.4
+check val.ipv6 val ipv6 :: ::1 1:: fe80::1 1:2:3:4:5:6:7:8 \
+  1:2:3:4:5:6:7:8:9 1:2:3:4:5:6:7 ::ffff:1.2.3.4 1::2::3 12345:: \
+  ffff:ffff:ffff:ffff:ffff:ffff:ffff:ffff fe80::1%eth0 ::g 1:2:3:4:5:6 12 :::
+check val.ipv6net val ipv6net ::/0 2001:db8::/32 2001:db8::/128 \
+  2001:db8::/129 ::/ 2001:db8::/64x ::ffff:1.2.3.4/96 2001:db8::
+check val.macaddr val macaddr 00:11:22:33:44:55 0:1:2:3:4:5 \
+  AA:bb:CC:dd:EE:ff 00:11:22:33:44 00:11:22:33:44:55:66 00:11:22:33:44:5g \
+  001:11:22:33:44:55 00-11-22-33-44-55
+check val.ipv4-ipv6 val ipv4,ipv6 1.2.3.4 ::1 1.2.3.4/24 00:11:22:33:44:55 \
+  1.2.3.4x
+
+# interfaces of each address, the same interface listed once
+check addr.index addr-index "$CONFIGS/addr.boot"
+
+# netlink requests replayed through ip and bridge with the same lines as
+# the commands they replaced (addresses without "-6", ip takes the family
+# from the address)
+check netlink.lines netlink lo
+
+# path copies, push/pop and hashes
+check cpath.out cpath 1000
+
+# set paths checked against the template syntax patterns, both the simple
+# ones matched directly and the ones left to regcomp
+"$CFG_CHECK" cmds "$CONFIGS/validate.boot" >"$TMPD/validate.cmds" || exit 1
+check validate.out validate "$TMPD/validate.cmds"
+check validate-single.out validate "$TMPD/validate.cmds" single
+
+# path lookups (the "wide" config has enough child nodes to be indexed)
+for cfg in basic wide; do
+  check $cfg.find find "$CONFIGS/$cfg.boot" "$CONFIGS/$cfg.find"
+  check $cfg.find-all find "$CONFIGS/$cfg.boot"
+done
+
+# diffs with and without skipping subtrees with the same hash
+for skip in "" -H; do
+  check basic.diff $skip diff "$CONFIGS/basic.boot" \
+    "$CONFIGS/basic-changed.boot"
+  check basic.change-multi $skip change-diff "$CONFIGS/basic.boot" \
+    10.9.9.9/24 interfaces ethernet eth1 vif 20 address
+  check basic.change-value $skip change-diff "$CONFIGS/basic.boot" \
+    reject firewall name WAN_IN rule 10 action
+done
+
+# active config read in one pass and node by node
+"$CFG_CHECK" write-active "$CONFIGS/basic.boot" "$TMPD/active" || exit 1
+check basic.paths subtree
+check basic.paths walk
+check basic.paths-eth1 subtree interfaces ethernet eth1
+
+# deactivated nodes (and a tag node with all of its tag values
+# deactivated) are not read into the subtree
+"$CFG_CHECK" write-active "$CONFIGS/deact.boot" "$TMPD/deact-active" || exit 1
+VYATTA_ACTIVE_CONFIGURATION_DIR=$TMPD/deact-active
+check deact.paths subtree
+VYATTA_ACTIVE_CONFIGURATION_DIR=$TMPD/active
+
+# active config output is the same as the file output
+check basic.show active-show
+check basic.json active-json
+check basic.json-eth1 active-json interfaces ethernet eth1
+
+# sorted child listings of the active config (deactivated nodes left out,
+# rule numbers and interface names in version order)
+check basic.list-eth list interfaces ethernet
+"$CFG_CHECK" write-active "$CONFIGS/wide.boot" "$TMPD/wide-active" || exit 1
+VYATTA_ACTIVE_CONFIGURATION_DIR=$TMPD/wide-active
+check wide.list-eth list interfaces ethernet
+check wide.list-rule list firewall name WIDE rule
+# names mixing numbers and other characters
+"$CFG_CHECK" write-active "$CONFIGS/sort.boot" "$TMPD/sort-active" || exit 1
+VYATTA_ACTIVE_CONFIGURATION_DIR=$TMPD/sort-active
+check sort.list-name list firewall name
+VYATTA_ACTIVE_CONFIGURATION_DIR=$TMPD/active
+
+# status of the nodes in the active and a working config, read in one pass
+# and node by node
+"$CFG_CHECK" write-active "$CONFIGS/basic-changed.boot" "$TMPD/changed" \
+  || exit 1
+VYATTA_TEMP_CONFIG_DIR=$TMPD/changed
+export VYATTA_TEMP_CONFIG_DIR
+check basic.status status
+check basic.status status single
+check basic.status-eth1 status interfaces ethernet eth1
+
+# multi-value edits in a scratch working config, with few values and with
+# enough values for the value file to be indexed
+VYATTA_TEMP_CONFIG_DIR=$TMPD/work
+VYATTA_CHANGES_ONLY_DIR=$TMPD/changes
+export VYATTA_TEMP_CONFIG_DIR VYATTA_CHANGES_ONLY_DIR
+mkdir -p "$TMPD/work" "$TMPD/changes"
+check values.small values 3 system name-server
+check values.large values 3000 system name-server
+
+exit $failed